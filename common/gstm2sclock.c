@@ -0,0 +1,82 @@
+//==============================================================================
+// Copyright (C) 2023 Macnica Inc. All Rights Reserved.
+//
+// Use in source and binary forms, with or without modification, are permitted
+// provided by agreeing to the following terms and conditions:
+//
+// REDISTRIBUTIONS OR SUBLICENSING IN SOURCE AND BINARY FORM ARE NOT ALLOWED.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//------------------------------------------------------------------------------
+//! @file
+//! @brief GstClock on the m2s TAI time, shared by all m2s elements.
+//==============================================================================
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <m2s_api.h>
+#include "gstm2sclock.h"
+
+#define GST_M2S_CLOCK_TYPE_NAME "GstM2sClock"
+
+static GMutex g_m2s_clock_lock;
+static GstClock *g_p_m2s_clock = NULL;
+
+static GstClockTime gst_m2s_clock_get_internal_time (GstClock *clock)
+{
+	return (GstClockTime)m2s_get_current_tai_ns();
+}
+
+static void gst_m2s_clock_class_init (gpointer klass, gpointer class_data)
+{
+	GstClockClass *clock_class = (GstClockClass *)klass;
+
+	// Waits are still done by GstSystemClock, against the time returned here
+	clock_class->get_internal_time = gst_m2s_clock_get_internal_time;
+}
+
+GType gst_m2s_clock_get_type (void)
+{
+	static gsize m2s_clock_type = 0;
+
+	if (g_once_init_enter(&m2s_clock_type))
+	{
+		// Every m2s plugin links its own copy of this file, register the type once
+		GType type = g_type_from_name(GST_M2S_CLOCK_TYPE_NAME);
+
+		if (type == 0)
+		{
+			type = g_type_register_static_simple(GST_TYPE_SYSTEM_CLOCK, GST_M2S_CLOCK_TYPE_NAME,
+			                                     sizeof(GstM2sClockClass), gst_m2s_clock_class_init,
+			                                     sizeof(GstM2sClock), NULL, (GTypeFlags)0);
+		}
+		g_once_init_leave(&m2s_clock_type, type);
+	}
+
+	return (GType)m2s_clock_type;
+}
+
+GstClock *gst_m2s_clock_obtain (void)
+{
+	GstClock *p_clock;
+
+	g_mutex_lock(&g_m2s_clock_lock);
+	if (g_p_m2s_clock == NULL)
+	{
+		g_p_m2s_clock = (GstClock *)g_object_new(GST_TYPE_M2S_CLOCK, "name", "GstM2sClock", NULL);
+		gst_object_ref_sink(g_p_m2s_clock);
+	}
+	p_clock = (GstClock *)gst_object_ref(g_p_m2s_clock);
+	g_mutex_unlock(&g_m2s_clock_lock);
+
+	return p_clock;
+}
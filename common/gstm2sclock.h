@@ -0,0 +1,55 @@
+//==============================================================================
+// Copyright (C) 2023 Macnica Inc. All Rights Reserved.
+//
+// Use in source and binary forms, with or without modification, are permitted
+// provided by agreeing to the following terms and conditions:
+//
+// REDISTRIBUTIONS OR SUBLICENSING IN SOURCE AND BINARY FORM ARE NOT ALLOWED.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//------------------------------------------------------------------------------
+//! @file
+//! @brief GstClock on the m2s TAI time, shared by all m2s elements.
+//==============================================================================
+#if !defined(__GST_M2S_CLOCK_H__)
+#define __GST_M2S_CLOCK_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_M2S_CLOCK            (gst_m2s_clock_get_type())
+#define GST_M2S_CLOCK(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_M2S_CLOCK,GstM2sClock))
+#define GST_IS_M2S_CLOCK(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_M2S_CLOCK))
+
+typedef struct _GstM2sClock GstM2sClock;
+typedef struct _GstM2sClockClass GstM2sClockClass;
+
+// GstClock running on the PTP-disciplined TAI time of the m2s library
+struct _GstM2sClock
+{
+	GstSystemClock clock;
+};
+
+struct _GstM2sClockClass
+{
+	GstSystemClockClass parent_class;
+};
+
+GType gst_m2s_clock_get_type (void);
+
+// Process-wide instance, the caller owns the returned reference
+GstClock *gst_m2s_clock_obtain (void);
+
+G_END_DECLS
+
+#endif //__GST_M2S_CLOCK_H__
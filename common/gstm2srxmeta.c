@@ -0,0 +1,115 @@
+//==============================================================================
+// Copyright (C) 2023 Macnica Inc. All Rights Reserved.
+//
+// Use in source and binary forms, with or without modification, are permitted
+// provided by agreeing to the following terms and conditions:
+//
+// REDISTRIBUTIONS OR SUBLICENSING IN SOURCE AND BINARY FORM ARE NOT ALLOWED.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//------------------------------------------------------------------------------
+//! @file
+//! @brief GstM2sRxMeta, the reception state of a received frame.
+//==============================================================================
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "gstm2srxmeta.h"
+
+#define GST_M2S_RX_META_API_NAME  "GstM2sRxMetaAPI"
+#define GST_M2S_RX_META_IMPL_NAME "GstM2sRxMeta"
+
+static gboolean gst_m2s_rx_meta_init (GstMeta *meta, gpointer params, GstBuffer *buffer)
+{
+	GstM2sRxMeta *p_meta = (GstM2sRxMeta *)meta;
+
+	p_meta->rtp_timestamp = 0;
+	p_meta->capture_tai = 0;
+	p_meta->packet_rcv = 0;
+	p_meta->packet_lost = 0;
+
+	return TRUE;
+}
+
+static gboolean gst_m2s_rx_meta_transform (GstBuffer *dest, GstMeta *meta, GstBuffer *buffer,
+                                           GQuark type, gpointer data)
+{
+	GstM2sRxMeta *p_meta = (GstM2sRxMeta *)meta;
+
+	// the values describe the whole buffer, so only copies keep them
+	if (!GST_META_TRANSFORM_IS_COPY (type))
+	{
+		return FALSE;
+	}
+
+	return gst_buffer_add_m2s_rx_meta(dest, p_meta->rtp_timestamp, p_meta->capture_tai,
+	                                  p_meta->packet_rcv, p_meta->packet_lost) != NULL;
+}
+
+GType gst_m2s_rx_meta_api_get_type (void)
+{
+	static gsize m2s_rx_meta_api_type = 0;
+	static const gchar *tags[] = { NULL };
+
+	if (g_once_init_enter(&m2s_rx_meta_api_type))
+	{
+		// Every m2s plugin links its own copy of this file, register the API once
+		GType type = g_type_from_name(GST_M2S_RX_META_API_NAME);
+
+		if (type == 0)
+		{
+			type = gst_meta_api_type_register(GST_M2S_RX_META_API_NAME, tags);
+		}
+		g_once_init_leave(&m2s_rx_meta_api_type, type);
+	}
+
+	return (GType)m2s_rx_meta_api_type;
+}
+
+const GstMetaInfo *gst_m2s_rx_meta_get_info (void)
+{
+	static const GstMetaInfo *p_m2s_rx_meta_info = NULL;
+
+	if (g_once_init_enter(&p_m2s_rx_meta_info))
+	{
+		const GstMetaInfo *p_info = gst_meta_get_info(GST_M2S_RX_META_IMPL_NAME);
+
+		if (p_info == NULL)
+		{
+			p_info = gst_meta_register(GST_M2S_RX_META_API_TYPE, GST_M2S_RX_META_IMPL_NAME,
+			                           sizeof(GstM2sRxMeta), gst_m2s_rx_meta_init, NULL,
+			                           gst_m2s_rx_meta_transform);
+		}
+		g_once_init_leave(&p_m2s_rx_meta_info, p_info);
+	}
+
+	return p_m2s_rx_meta_info;
+}
+
+GstM2sRxMeta *gst_buffer_add_m2s_rx_meta (GstBuffer *buffer, uint32_t rtp_timestamp, guint64 capture_tai,
+                                          uint32_t packet_rcv, uint32_t packet_lost)
+{
+	GstM2sRxMeta *p_meta;
+
+	p_meta = (GstM2sRxMeta *)gst_buffer_add_meta(buffer, GST_M2S_RX_META_INFO, NULL);
+	if (p_meta == NULL)
+	{
+		return NULL;
+	}
+
+	p_meta->rtp_timestamp = rtp_timestamp;
+	p_meta->capture_tai = capture_tai;
+	p_meta->packet_rcv = packet_rcv;
+	p_meta->packet_lost = packet_lost;
+
+	return p_meta;
+}
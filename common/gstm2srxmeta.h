@@ -0,0 +1,57 @@
+//==============================================================================
+// Copyright (C) 2023 Macnica Inc. All Rights Reserved.
+//
+// Use in source and binary forms, with or without modification, are permitted
+// provided by agreeing to the following terms and conditions:
+//
+// REDISTRIBUTIONS OR SUBLICENSING IN SOURCE AND BINARY FORM ARE NOT ALLOWED.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//------------------------------------------------------------------------------
+//! @file
+//! @brief GstM2sRxMeta, the reception state of a received frame.
+//==============================================================================
+#if !defined(__GST_M2S_RX_META_H__)
+#define __GST_M2S_RX_META_H__
+
+#include <stdint.h>
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_M2S_RX_META_API_TYPE      (gst_m2s_rx_meta_api_get_type())
+#define GST_M2S_RX_META_INFO          (gst_m2s_rx_meta_get_info())
+
+typedef struct _GstM2sRxMeta GstM2sRxMeta;
+
+// Reception state of the m2s frame or audio packets a buffer was read from
+struct _GstM2sRxMeta
+{
+	GstMeta meta;
+
+	uint32_t rtp_timestamp;               // of the first sample in the buffer
+	guint64 capture_tai;                  // rtp_timestamp in TAI ns, 0 when not locked to PTP
+	uint32_t packet_rcv;                  // from m2s_read_status_t
+	uint32_t packet_lost;
+};
+
+GType gst_m2s_rx_meta_api_get_type (void);
+const GstMetaInfo *gst_m2s_rx_meta_get_info (void);
+
+#define gst_buffer_get_m2s_rx_meta(b) ((GstM2sRxMeta *)gst_buffer_get_meta((b), GST_M2S_RX_META_API_TYPE))
+
+GstM2sRxMeta *gst_buffer_add_m2s_rx_meta (GstBuffer *buffer, uint32_t rtp_timestamp, guint64 capture_tai,
+                                          uint32_t packet_rcv, uint32_t packet_lost);
+
+G_END_DECLS
+
+#endif //__GST_M2S_RX_META_H__
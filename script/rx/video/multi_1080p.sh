@@ -0,0 +1,4 @@
+############
+#  xhost +
+############
+GST_PLUGIN_PATH=gstreamer LD_LIBRARY_PATH=library gst-launch-1.0 -v m2smultivideosrc name=m num-streams=2 l1-cpu-num=-1 l2-cpu-num=-1 gpu-num=0 sync-timeout-ms=20 src_0::p-if-address="192.168.1.23" src_0::p-dst-address="239.7.20.100" src_0::p-src-address="192.168.10.100" src_0::p-dst-port=50020 src_1::p-if-address="192.168.1.23" src_1::p-dst-address="239.7.20.101" src_1::p-src-address="192.168.10.101" src_1::p-dst-port=50020 m.src_0 ! video/x-raw,format=UYVP,width=1920,height=1080,framerate=60000/1001 ! queue ! videoscale ! video/x-raw,width=480,height=270 ! videoconvert ! ximagesink display=:0 m.src_1 ! queue ! videoscale ! video/x-raw,width=480,height=270 ! videoconvert ! ximagesink display=:0
@@ -0,0 +1,70 @@
+############
+#  Stress test for many TX streams in one process.
+#  Each run starts NUM_VIDEO video sinks, alternating 1080i and 2160p, and two
+#  audio sinks with 1ms and 125us packet time in a single gst-launch, sends
+#  NUM_BUFFERS frames and must reach EOS. Every frame a video sink wrote must
+#  also have used the TR offset of its own format, so that no instance took
+#  another one's timing. Audio has the same TR offset at both packet times, so
+#  the audio sinks only add load. The run is repeated RUNS times.
+#
+#  usage: multi_instance.sh [NUM_VIDEO] [RUNS] [NUM_BUFFERS]
+############
+NUM_VIDEO=${1:-8}
+RUNS=${2:-10}
+NUM_BUFFERS=${3:-600}
+LOG=$(mktemp)
+trap 'rm -f ${LOG}' EXIT
+
+# calc_tr_offset(): specs - margin of common/tr_offset.h
+TR_OFFSET_1080i_59=632503
+TR_OFFSET_2160p_59=617674
+
+PIPELINE=""
+for i in $(seq 0 $((NUM_VIDEO - 1)))
+do
+	if [ $((i % 2)) -eq 0 ]; then
+		CAPS="video/x-raw,format=UYVP,width=1920,height=1080,framerate=30000/1001"
+		SCAN=1
+	else
+		CAPS="video/x-raw,format=UYVP,width=3840,height=2160,framerate=60000/1001"
+		SCAN=0
+	fi
+	PIPELINE="${PIPELINE} videotestsrc num-buffers=${NUM_BUFFERS} ! ${CAPS} ! queue ! m2svideosink name=vsink${i} cpu-num=-1 gpu-num=0 scan=${SCAN} p-dst-address=239.8.20.$((100 + i)) s-dst-address=239.8.21.$((100 + i)) p-src-address=192.168.1.23 s-src-address=192.168.2.23 p-dst-port=50020 s-dst-port=50020 p-src-port=$((30020 + i)) s-src-port=$((30020 + i)) payload-type=96"
+done
+
+for t in 0 1
+do
+	PIPELINE="${PIPELINE} audiotestsrc volume=0.1 num-buffers=${NUM_BUFFERS} ! audio/x-raw,format=S24BE,rate=48000,channels=16,layout=interleaved ! queue ! m2saudiosink name=asink${t} cpu-num=-1 gpu-num=0 packet-time=${t} p-dst-address=239.8.30.$((100 + t)) s-dst-address=239.8.31.$((100 + t)) p-src-address=192.168.1.23 s-src-address=192.168.2.23 p-dst-port=50030 s-dst-port=50030"
+done
+
+# every frame the sink wrote in this run has to have used the TR offset of its format
+check_offset()
+{
+	OFFSETS=$(grep "<$1> write at" ${LOG} | sed 's/.*TR offset \(-\?[0-9]*\) ns.*/\1/' | sort -u)
+	if [ "${OFFSETS}" != "$2" ]; then
+		echo "run ${run} failed: $1 TR offset '${OFFSETS}', expected $2"
+		return 1
+	fi
+	return 0
+}
+
+for run in $(seq 1 ${RUNS})
+do
+	echo "run ${run}/${RUNS}: ${NUM_VIDEO} video + 2 audio sinks"
+	if ! GST_PLUGIN_PATH=gstreamer LD_LIBRARY_PATH=library GST_DEBUG=m2svideosink:6 \
+		GST_DEBUG_NO_COLOR=1 GST_DEBUG_FILE=${LOG} gst-launch-1.0 -q ${PIPELINE}; then
+		echo "run ${run} failed"
+		exit 1
+	fi
+
+	for i in $(seq 0 $((NUM_VIDEO - 1)))
+	do
+		if [ $((i % 2)) -eq 0 ]; then
+			EXPECTED=${TR_OFFSET_1080i_59}
+		else
+			EXPECTED=${TR_OFFSET_2160p_59}
+		fi
+		check_offset vsink${i} ${EXPECTED} || exit 1
+	done
+done
+echo "all ${RUNS} runs passed"
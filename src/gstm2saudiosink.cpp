@@ -39,6 +39,7 @@
 #include <gst/audio/gstaudiosink.h>
 #include <m2s_api.h>
 #include <tr_offset.h>
+#include <gstm2sclock.h>
 #include "gstm2saudiosink.h"
 
 #define DBG_MSG(format, args...) printf("[m2saudiosink] " format, ## args)
@@ -60,6 +61,7 @@ GST_DEBUG_CATEGORY_STATIC (gst_m2saudiosink_debug_category);
 #define DEFAULT_DEBUG_MESSAGE_INTERVAL   (10)
 #define DEFAULT_PACKET_TIME              (1)
 #define DEFAULT_TX_DELAY_MS              (200)
+#define DEFAULT_PREROLL_BLOCKS           (0)
 
 /* prototypes */
 
@@ -77,6 +79,7 @@ static void gst_m2saudiosink_set_payload_type (GstM2saudiosink *m2saudiosink, ui
 static void gst_m2saudiosink_set_debug_message_interval (GstM2saudiosink *m2saudiosink, uint16_t interval);
 static void gst_m2saudiosink_set_packet_time (GstM2saudiosink *m2saudiosink, uint8_t packet_time);
 static void gst_m2saudiosink_set_tx_delay_ms (GstM2saudiosink *m2saudiosink, int32_t tx_delay_ms);
+static void gst_m2saudiosink_set_preroll_blocks (GstM2saudiosink *m2saudiosink, uint32_t preroll_blocks);
 static void gst_m2saudiosink_set_property (GObject * object,
                                            guint property_id, const GValue * value, GParamSpec * pspec);
 static void gst_m2saudiosink_get_property (GObject * object,
@@ -85,11 +88,13 @@ static void gst_m2saudiosink_dispose (GObject * object);
 static void gst_m2saudiosink_finalize (GObject * object);
 
 static GstStateChangeReturn gst_m2saudiosink_change_state (GstElement * element, GstStateChange transition);
+static GstClock *gst_m2saudiosink_provide_clock (GstElement * element);
 
 static gboolean gst_m2saudiosink_set_caps (GstBaseSink * sink, GstCaps * caps);
 static GstCaps *gst_m2saudiosink_fixate (GstBaseSink * sink, GstCaps * caps);
 static GstFlowReturn gst_m2saudiosink_render (GstBaseSink * sink,
                                               GstBuffer * buffer);
+static gboolean gst_m2saudiosink_event (GstBaseSink * sink, GstEvent * event);
 
 enum
 {
@@ -108,9 +113,9 @@ enum
 	PROP_DEBUG_MESSAGE_INTERVAL,
 	PROP_PACKET_TIME,
 	PROP_TX_DELAY_MS,
+	PROP_PREROLL_BLOCKS,
 };
 
-static int32_t g_start_time_offset_ns = 0;
 /* pad templates */
 
 static GstStaticPadTemplate gst_m2saudiosink_sink_template =
@@ -256,6 +261,11 @@ static void gst_m2saudiosink_set_tx_delay_ms (GstM2saudiosink *m2saudiosink, int
 	m2saudiosink->tx_delay_ms = tx_delay_ms;
 }
 
+static void gst_m2saudiosink_set_preroll_blocks (GstM2saudiosink *m2saudiosink, uint32_t preroll_blocks)
+{
+	m2saudiosink->preroll_blocks = preroll_blocks;
+}
+
 static void
 gst_m2saudiosink_class_init (GstM2saudiosinkClass * klass)
 {
@@ -347,19 +357,28 @@ gst_m2saudiosink_class_init (GstM2saudiosinkClass * klass)
 	                                                    "Tx delay ms", 0x80000000, 0x7fffffff, DEFAULT_TX_DELAY_MS,
 	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
+	g_object_class_install_property (gobject_class, PROP_PREROLL_BLOCKS,
+	                                 g_param_spec_uint ("preroll-blocks", "Pre-roll Blocks",
+	                                                    "Audio blocks collected before the first write, 0 to start with the first block",
+	                                                    0, 1000, DEFAULT_PREROLL_BLOCKS,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
 	gobject_class->dispose = gst_m2saudiosink_dispose;
 	gobject_class->finalize = gst_m2saudiosink_finalize;
 
 	element_class->change_state = gst_m2saudiosink_change_state;
+	element_class->provide_clock = gst_m2saudiosink_provide_clock;
 
 	base_sink_class->set_caps = GST_DEBUG_FUNCPTR (gst_m2saudiosink_set_caps);
 	base_sink_class->fixate = GST_DEBUG_FUNCPTR (gst_m2saudiosink_fixate);
 	base_sink_class->render = GST_DEBUG_FUNCPTR (gst_m2saudiosink_render);
+	base_sink_class->event = GST_DEBUG_FUNCPTR (gst_m2saudiosink_event);
 }
 
 static void
 gst_m2saudiosink_init (GstM2saudiosink * p_m2saudiosink)
 {
+	GST_OBJECT_FLAG_SET (p_m2saudiosink, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
 	gst_base_sink_set_sync (GST_BASE_SINK (p_m2saudiosink), FALSE);
 	gst_m2saudiosink_set_gpu_num(p_m2saudiosink, DEFAULT_GPU_NUM);
 	gst_m2saudiosink_set_cpu_num(p_m2saudiosink, DEFAULT_CPU_NUM);
@@ -375,6 +394,7 @@ gst_m2saudiosink_init (GstM2saudiosink * p_m2saudiosink)
 	gst_m2saudiosink_set_debug_message_interval(p_m2saudiosink, DEFAULT_DEBUG_MESSAGE_INTERVAL);
 	gst_m2saudiosink_set_packet_time(p_m2saudiosink, DEFAULT_PACKET_TIME);
 	gst_m2saudiosink_set_tx_delay_ms(p_m2saudiosink, DEFAULT_TX_DELAY_MS);
+	gst_m2saudiosink_set_preroll_blocks(p_m2saudiosink, DEFAULT_PREROLL_BLOCKS);
 }
 
 void
@@ -427,6 +447,9 @@ gst_m2saudiosink_set_property (GObject * object, guint property_id,
 	case PROP_TX_DELAY_MS:
 		gst_m2saudiosink_set_tx_delay_ms (p_m2saudiosink, g_value_get_int (value));
 		break;
+	case PROP_PREROLL_BLOCKS:
+		gst_m2saudiosink_set_preroll_blocks (p_m2saudiosink, g_value_get_uint (value));
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
 		break;
@@ -483,6 +506,9 @@ gst_m2saudiosink_get_property (GObject * object, guint property_id,
 	case PROP_TX_DELAY_MS:
 		g_value_set_int (value, p_m2saudiosink->tx_delay_ms);
 		break;
+	case PROP_PREROLL_BLOCKS:
+		g_value_set_uint (value, p_m2saudiosink->preroll_blocks);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
 		break;
@@ -501,6 +527,12 @@ gst_m2saudiosink_dispose (GObject * object)
 	G_OBJECT_CLASS (gst_m2saudiosink_parent_class)->dispose (object);
 }
 
+static GstClock *
+gst_m2saudiosink_provide_clock (GstElement * element)
+{
+	return gst_m2s_clock_obtain();
+}
+
 static GstStateChangeReturn
 gst_m2saudiosink_change_state (GstElement * element, GstStateChange transition)
 {
@@ -534,6 +566,12 @@ gst_m2saudiosink_change_state (GstElement * element, GstStateChange transition)
 		stop_monitoring_timer(p_m2saudiosink);
 		m2s_enable_select(p_m2saudiosink->strm_id, false);
 		m2s_stop(p_m2saudiosink->strm_id);
+		if (p_m2saudiosink->preroll_blocks > 0)
+		{
+			// the m2s FIFO is empty again, pre-roll once more on resume
+			p_m2saudiosink->done_first_set_contents = false;
+			p_m2saudiosink->raw_offset = 0;
+		}
 		break;
 
 	case GST_STATE_CHANGE_PAUSED_TO_READY:
@@ -607,7 +645,8 @@ gst_m2saudiosink_set_caps (GstBaseSink * p_sink, GstCaps * p_caps)
 	m2s_set_media_conf(p_m2saudiosink->strm_id, &media_conf);
 	m2s_set_ip_conf(p_m2saudiosink->strm_id, &ip_conf);
 
-	g_start_time_offset_ns = calc_tr_offset(M2S_MEDIA_TYPE_AUDIO, &media_conf);
+	p_m2saudiosink->start_time_offset_ns = calc_tr_offset(M2S_MEDIA_TYPE_AUDIO, &media_conf);
+	GST_INFO_OBJECT (p_m2saudiosink, "TR offset %d ns", p_m2saudiosink->start_time_offset_ns);
 
 	p_m2saudiosink->done_first_set_contents = false;
 	p_m2saudiosink->raw_offset = 0;
@@ -627,84 +666,100 @@ gst_m2saudiosink_fixate (GstBaseSink * sink, GstCaps * caps)
 	return NULL;
 }
 
-static GstFlowReturn
-gst_m2saudiosink_render (GstBaseSink * sink, GstBuffer * buffer)
+// Write every complete element of vec_raw. Until the first write, data is
+// held back until preroll_blocks elements are there, so that TX starts with
+// that many queued in m2s; at EOS what there is goes out anyway.
+static GstFlowReturn write_raw_m2s (GstM2saudiosink *p_m2saudiosink, bool eos)
 {
-	GstFlowReturn ret;
 	int32_t ret_m2s;
-	GstM2saudiosink *p_m2saudiosink = GST_M2SAUDIOSINK (sink);
-	GstMapInfo info;
 	m2s_media_t media;
 	m2s_media_size_t size;
 	m2s_time_info_t time_info;
 	uint64_t align_time;
 	auto &vec_raw = p_m2saudiosink->vec_raw;
 
-	GST_DEBUG_OBJECT (p_m2saudiosink, "render");
-
-	if (gst_buffer_map(buffer, &info, GST_MAP_READ))
+	if (!p_m2saudiosink->done_first_set_contents && !eos &&
+		(vec_raw.size() < (size_t)p_m2saudiosink->preroll_blocks * p_m2saudiosink->raw_element_length))
 	{
-		// Workaround: m2s does not yet support variable length writing.
-		vec_raw.resize(vec_raw.size() + info.size);
-		memcpy(&vec_raw[vec_raw.size() - info.size], info.data, info.size);
+		return GST_FLOW_OK;
+	}
 
-		while (vec_raw.size() >= p_m2saudiosink->raw_element_length)
+	while (vec_raw.size() >= p_m2saudiosink->raw_element_length)
+	{
+		size.audio.raw_size = p_m2saudiosink->raw_element_length;
+		if ((ret_m2s = m2s_write_select(p_m2saudiosink->strm_id, &size, nullptr)) != 0)
 		{
-			size.audio.raw_size = p_m2saudiosink->raw_element_length;
-			if ((ret_m2s = m2s_write_select(p_m2saudiosink->strm_id, &size, nullptr)) != 0)
+			if ((ret_m2s == M2S_RET_NOT_START) || (ret_m2s == M2S_RET_DISABLED))
 			{
-				if ((ret_m2s == M2S_RET_NOT_START) || (ret_m2s == M2S_RET_DISABLED))
-				{
-					ret = GST_FLOW_OK;
-				}
-				else
-				{
-					//DBG_MSG("!!! gst_m2saudiosink_render : m2s_write_select error: ret=%#010x size=%u\n", ret_m2s, size.audio.raw_size);
-					ret = GST_FLOW_ERROR;
-				}
-				goto UNMAP;
+				return GST_FLOW_OK;
 			}
+			//DBG_MSG("!!! gst_m2saudiosink_render : m2s_write_select error: ret=%#010x size=%u\n", ret_m2s, size.audio.raw_size);
+			return GST_FLOW_ERROR;
+		}
 
-			if (!p_m2saudiosink->done_first_set_contents)
-			{
-				// The first frame will be sent 200 msec after the current time.
-				p_m2saudiosink->start_time = m2s_get_current_tai_ns() + ((int64_t)p_m2saudiosink->tx_delay_ms * 1000000);
-				p_m2saudiosink->done_first_set_contents = true;
-			}
-			align_time = m2s_calc_next_audio_alignment_point(p_m2saudiosink->start_time, p_m2saudiosink->raw_offset++);
-			time_info.start_time_ns = align_time + g_start_time_offset_ns;
-			time_info.rtp_timestamp = m2s_conv_tai_to_rtptime(align_time, M2S_RTP_COUNTER_FREQ_48KHZ);
+		if (!p_m2saudiosink->done_first_set_contents)
+		{
+			// The first frame will be sent 200 msec after the current time.
+			p_m2saudiosink->start_time = m2s_get_current_tai_ns() + ((int64_t)p_m2saudiosink->tx_delay_ms * 1000000);
+			p_m2saudiosink->raw_offset = 0;
+			p_m2saudiosink->done_first_set_contents = true;
+		}
+		align_time = m2s_calc_next_audio_alignment_point(p_m2saudiosink->start_time, p_m2saudiosink->raw_offset++);
+		time_info.start_time_ns = align_time + p_m2saudiosink->start_time_offset_ns;
+		time_info.rtp_timestamp = m2s_conv_tai_to_rtptime(align_time, M2S_RTP_COUNTER_FREQ_48KHZ);
 
-			media.audio.p_raw = &vec_raw[0];
+		media.audio.p_raw = &vec_raw[0];
 
-			if ((ret_m2s = m2s_write(p_m2saudiosink->strm_id, &time_info, &media, &size)) != 0)
+		if ((ret_m2s = m2s_write(p_m2saudiosink->strm_id, &time_info, &media, &size)) != 0)
+		{
+			if (ret_m2s == M2S_RET_NOT_START)
 			{
-				if (ret_m2s == M2S_RET_NOT_START)
-				{
-					ret = GST_FLOW_OK;
-				}
-				else
-				{
-					//DBG_MSG("!!! gst_m2saudiosink_render : m2s_write error: ret=%#010x\n", ret_m2s);
-					ret = GST_FLOW_ERROR;
-				}
-				goto UNMAP;
+				return GST_FLOW_OK;
 			}
-
-			vec_raw.erase(vec_raw.begin(), vec_raw.begin() + p_m2saudiosink->raw_element_length);
+			//DBG_MSG("!!! gst_m2saudiosink_render : m2s_write error: ret=%#010x\n", ret_m2s);
+			return GST_FLOW_ERROR;
 		}
 
-		ret = GST_FLOW_OK;
+		vec_raw.erase(vec_raw.begin(), vec_raw.begin() + p_m2saudiosink->raw_element_length);
+	}
+
+	return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_m2saudiosink_render (GstBaseSink * sink, GstBuffer * buffer)
+{
+	GstM2saudiosink *p_m2saudiosink = GST_M2SAUDIOSINK (sink);
+	GstMapInfo info;
+	auto &vec_raw = p_m2saudiosink->vec_raw;
+
+	GST_DEBUG_OBJECT (p_m2saudiosink, "render");
 
-	  UNMAP:
-		gst_buffer_unmap(buffer, &info);
+	if (!gst_buffer_map(buffer, &info, GST_MAP_READ))
+	{
+		return GST_FLOW_ERROR;
 	}
-	else
+
+	// Workaround: m2s does not yet support variable length writing.
+	vec_raw.resize(vec_raw.size() + info.size);
+	memcpy(&vec_raw[vec_raw.size() - info.size], info.data, info.size);
+	gst_buffer_unmap(buffer, &info);
+
+	return write_raw_m2s(p_m2saudiosink, false);
+}
+
+static gboolean
+gst_m2saudiosink_event (GstBaseSink * sink, GstEvent * event)
+{
+	GstM2saudiosink *p_m2saudiosink = GST_M2SAUDIOSINK (sink);
+
+	if (GST_EVENT_TYPE (event) == GST_EVENT_EOS)
 	{
-		ret = GST_FLOW_ERROR;
+		// the stream ended before the pre-roll was complete
+		write_raw_m2s(p_m2saudiosink, true);
 	}
 
-	return ret;
+	return GST_BASE_SINK_CLASS (gst_m2saudiosink_parent_class)->event (sink, event);
 }
 
 static gboolean
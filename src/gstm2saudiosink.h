@@ -57,9 +57,11 @@ struct _GstM2saudiosink
 	uint16_t debug_message_interval;
 	uint8_t packet_time;
 	int32_t tx_delay_ms;
+	uint32_t preroll_blocks;
 
 	bool done_first_set_contents;
 	uint64_t start_time;
+	int32_t start_time_offset_ns;          /* TR offset of the current caps */
 	uint64_t raw_offset;
 
 	std::vector<uint8_t> vec_raw;
@@ -38,6 +38,8 @@
 #include <mutex>
 #include <condition_variable>
 #include <m2s_api.h>
+#include <gstm2sclock.h>
+#include <gstm2srxmeta.h>
 #include "gstm2saudiosrc.h"
 
 #define DBG_MSG(format, args...) printf("[m2saudiosrc] " format, ## args)
@@ -71,6 +73,10 @@ GST_DEBUG_CATEGORY_STATIC (m2saudiosrc_debug);
 #define DEFAULT_DEBUG_MESSAGE_INTERVAL   (10)
 #define DEFAULT_PACKET_TIME              (1)
 
+// application FIFO depth (in m2s elements) at which reading stops and resumes
+#define FIFO_UNDER_THRESHOLD             (2)
+#define FIFO_RESUME_THRESHOLD            (5)
+
 enum
 {
 	PROP_0,
@@ -155,6 +161,7 @@ static GstFlowReturn gst_m2saudiosrc_fill (GstBaseSrc * basesrc,
                                            guint64 offset, guint length, GstBuffer * buffer);
 
 static GstStateChangeReturn gst_m2saudiosrc_change_state (GstElement * element, GstStateChange transition);
+static GstClock *gst_m2saudiosrc_provide_clock (GstElement * element);
 
 static void monitoring_thread_main(GstM2saudiosrc *p_m2saudiosrc)
 {
@@ -478,11 +485,13 @@ gst_m2saudiosrc_class_init (GstM2saudiosrcClass * klass)
 	gstbasesrc_class->fill = GST_DEBUG_FUNCPTR (gst_m2saudiosrc_fill);
 
 	gstelement_class->change_state = gst_m2saudiosrc_change_state;
+	gstelement_class->provide_clock = gst_m2saudiosrc_provide_clock;
 }
 
 static void
 gst_m2saudiosrc_init (GstM2saudiosrc * p_m2saudiosrc)
 {
+	GST_OBJECT_FLAG_SET (p_m2saudiosrc, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
 	p_m2saudiosrc->freq = DEFAULT_FREQ;
 
 	/* we operate in time */
@@ -658,17 +667,30 @@ gst_m2saudiosrc_query (GstBaseSrc * basesrc, GstQuery * query)
 	}
 	case GST_QUERY_LATENCY:
 	{
-		if (src->info.rate > 0) {
-			GstClockTime latency;
+		if ((src->info.rate > 0) && (GST_AUDIO_INFO_BPF (&src->info) > 0)) {
+			GstClockTime buffer_time, element_time, packet_time, playout_delay;
+			GstClockTime min_latency, max_latency;
 
-			latency =
+			// one output buffer, plus the m2s FIFO between its under and resume
+			// thresholds, plus one packet on the wire and the playout delay
+			buffer_time =
 				gst_util_uint64_scale (src->generate_samples_per_buffer, GST_SECOND,
 				                       src->info.rate);
+			element_time =
+				gst_util_uint64_scale (src->raw_element_length / GST_AUDIO_INFO_BPF (&src->info),
+				                       GST_SECOND, src->info.rate);
+			packet_time = (src->packet_time == M2S_PACKET_TIME_125us) ? 125 * GST_USECOND : GST_MSECOND;
+			playout_delay = (GstClockTime)MAX (src->playout_delay_ms, 0) * GST_MSECOND;
+
+			min_latency = playout_delay + packet_time + buffer_time + FIFO_UNDER_THRESHOLD * element_time;
+			max_latency = playout_delay + packet_time + buffer_time + (FIFO_RESUME_THRESHOLD + 1) * element_time;
+
 			gst_query_set_latency (query,
-			                       gst_base_src_is_live (GST_BASE_SRC_CAST (src)), latency,
-			                       GST_CLOCK_TIME_NONE);
-			GST_DEBUG_OBJECT (src, "Reporting latency of %" GST_TIME_FORMAT,
-			                  GST_TIME_ARGS (latency));
+			                       gst_base_src_is_live (GST_BASE_SRC_CAST (src)), min_latency,
+			                       max_latency);
+			GST_DEBUG_OBJECT (src, "Reporting latency of min %" GST_TIME_FORMAT
+			                  " max %" GST_TIME_FORMAT,
+			                  GST_TIME_ARGS (min_latency), GST_TIME_ARGS (max_latency));
 			res = TRUE;
 		}
 		break;
@@ -717,6 +739,8 @@ gst_m2saudiosrc_start (GstBaseSrc * basesrc)
 
 	src->next_sample = 0;
 	src->next_byte = 0;
+	src->raw_status.packet_rcv = 0;
+	src->raw_status.packet_lost = 0;
 	src->next_time = 0;
 	src->check_seek_stop = FALSE;
 	src->eos_reached = FALSE;
@@ -805,6 +829,7 @@ gst_m2saudiosrc_fill (GstBaseSrc * basesrc, guint64 offset,
 	m2s_media_t media;
 	m2s_media_size_t size;
 	m2s_media_size_t size_max;
+	m2s_read_status_t read_status;
 	uint32_t rtp_timestamp;
 
 	src = GST_M2SAUDIOSRC (basesrc);
@@ -934,14 +959,14 @@ gst_m2saudiosrc_fill (GstBaseSrc * basesrc, guint64 offset,
 		{
 			if (src->fifo_is_almost_empty)
 			{
-				if (status.rx.app_fifo_stored >= 5)
+				if (status.rx.app_fifo_stored >= FIFO_RESUME_THRESHOLD)
 				{
 					src->fifo_is_almost_empty = false;
 				}
 			}
 			else
 			{
-				if (status.rx.app_fifo_stored < 2)
+				if (status.rx.app_fifo_stored < FIFO_UNDER_THRESHOLD)
 				{
 					src->fifo_is_almost_empty = true;
 				}
@@ -961,7 +986,15 @@ gst_m2saudiosrc_fill (GstBaseSrc * basesrc, guint64 offset,
 			size_max.audio.raw_size = src->raw_element_length;
 			vec_raw.resize(vec_raw.size() + src->raw_element_length);
 			media.audio.p_raw = &vec_raw[vec_raw.size() - src->raw_element_length];
-			m2s_read(src->strm_id, &rtp_timestamp, &media, &size, &size_max);
+			if (m2s_read_with_status(src->strm_id, &rtp_timestamp, &media, &size, &size_max, &read_status) == M2S_RET_SUCCESS)
+			{
+				if (vec_raw.size() == src->raw_element_length)
+				{
+					src->raw_rtp_timestamp = rtp_timestamp;
+				}
+				src->raw_status.packet_rcv += read_status.packet_rcv;
+				src->raw_status.packet_lost += read_status.packet_lost;
+			}
 		}
 	}
 
@@ -969,6 +1002,14 @@ gst_m2saudiosrc_fill (GstBaseSrc * basesrc, guint64 offset,
 	{
 		memcpy(map.data, &vec_raw[0], map.size);
 		vec_raw.erase(vec_raw.begin(), vec_raw.begin() + map.size);
+
+		// the packets read for this buffer, the RTP clock counts 48kHz samples
+		gst_buffer_add_m2s_rx_meta(buffer, src->raw_rtp_timestamp,
+		                           m2s_conv_rtptime_to_tai(src->raw_rtp_timestamp, M2S_RTP_COUNTER_FREQ_48KHZ),
+		                           src->raw_status.packet_rcv, src->raw_status.packet_lost);
+		src->raw_rtp_timestamp += map.size / bpf;
+		src->raw_status.packet_rcv = 0;
+		src->raw_status.packet_lost = 0;
 	}
 	else
 	{
@@ -1143,6 +1184,12 @@ gst_m2saudiosrc_get_property (GObject * object, guint prop_id,
 	}
 }
 
+static GstClock *
+gst_m2saudiosrc_provide_clock (GstElement * element)
+{
+	return gst_m2s_clock_obtain();
+}
+
 static GstStateChangeReturn
 gst_m2saudiosrc_change_state (GstElement * element, GstStateChange transition)
 {
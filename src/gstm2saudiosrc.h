@@ -92,6 +92,8 @@ struct _GstM2saudiosrc {
 
 	std::vector<uint8_t> vec_raw;
 	uint32_t raw_element_length;
+	uint32_t raw_rtp_timestamp;           /* RTP timestamp of vec_raw[0] */
+	m2s_read_status_t raw_status;         /* packets read since the last buffer */
 };
 
 G_END_DECLS
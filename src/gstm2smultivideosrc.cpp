@@ -0,0 +1,1628 @@
+//==============================================================================
+// Copyright (C) 2023 Macnica Inc. All Rights Reserved.
+//
+// Use in source and binary forms, with or without modification, are permitted
+// provided by agreeing to the following terms and conditions:
+//
+// REDISTRIBUTIONS OR SUBLICENSING IN SOURCE AND BINARY FORM ARE NOT ALLOWED.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//------------------------------------------------------------------------------
+//! @file
+//! @brief Receives N video streams and pushes the frames with matching RTP
+//!        timestamps together, one src pad per stream.
+//==============================================================================
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <m2s_api.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <gst/gst.h>
+#include <gst/base/gstflowcombiner.h>
+#include <gst/video/video.h>
+#include <gstm2sclock.h>
+#include "gstm2smultivideosrc.h"
+
+#define DBG_MSG(format, args...) printf("[m2smultivideosrc] " format, ## args)
+
+GST_DEBUG_CATEGORY_STATIC (m2smultivideosrc_debug);
+#define GST_CAT_DEFAULT m2smultivideosrc_debug
+
+#define DEFAULT_NUM_STREAMS              (0)
+#define DEFAULT_HW_HITLESS               (TRUE)
+#define DEFAULT_GPU_NUM                  (0)
+#define DEFAULT_L2_CPU_NUM               (-1)
+#define DEFAULT_L1_CPU_NUM               (-1)
+#define DEFAULT_PLAYOUT_DELAY_MS         (0)
+#define DEFAULT_SCAN                     (0)
+#define DEFAULT_RTP_FORMAT               M2S_VIDEO_RTP_FORMAT_RAW_YUV422_10bit
+#define DEFAULT_IPX_LICENSE              ""
+#define DEFAULT_SYNC_TIMEOUT_MS          (20)
+
+#define DEFAULT_P_IF_ADDRESS             "239.1.1.1"
+#define DEFAULT_S_IF_ADDRESS             "0.0.0.0"
+#define DEFAULT_P_DST_ADDRESS            "192.168.0.1"
+#define DEFAULT_S_DST_ADDRESS            "0.0.0.0"
+#define DEFAULT_P_SRC_ADDRESS            "192.168.1.1"
+#define DEFAULT_S_SRC_ADDRESS            "0.0.0.0"
+#define DEFAULT_P_DST_PORT               (50000)
+#define DEFAULT_S_DST_PORT               (50001)
+#define DEFAULT_P_SRC_PORT               (0)
+#define DEFAULT_S_SRC_PORT               (0)
+#define DEFAULT_PAYLOAD_TYPE             (96)
+
+// frames of one stream downstream may hold before the streaming thread waits
+// for one to be returned
+#define MAX_LEASES                       (4)
+// how often a wait for a returned frame looks for a flush
+#define LEASE_WAIT_INTERVAL_MS           (10)
+
+enum
+{
+	PROP_0,
+	PROP_NUM_STREAMS,
+	PROP_HW_HITLESS,
+	PROP_GPU_NUM,
+	PROP_L2_CPU_NUM,
+	PROP_L1_CPU_NUM,
+	PROP_PLAYOUT_DELAY_MS,
+	PROP_SCAN,
+	PROP_RTP_FORMAT,
+	PROP_IPX_LICENSE,
+	PROP_SYNC_TIMEOUT_MS,
+	PROP_SETS,
+	PROP_INCOMPLETE_SETS,
+	PROP_LAST
+};
+
+enum
+{
+	PROP_PAD_0,
+	PROP_PAD_P_IF_ADDRESS,
+	PROP_PAD_S_IF_ADDRESS,
+	PROP_PAD_P_DST_ADDRESS,
+	PROP_PAD_S_DST_ADDRESS,
+	PROP_PAD_P_SRC_ADDRESS,
+	PROP_PAD_S_SRC_ADDRESS,
+	PROP_PAD_P_DST_PORT,
+	PROP_PAD_S_DST_PORT,
+	PROP_PAD_P_SRC_PORT,
+	PROP_PAD_S_SRC_PORT,
+	PROP_PAD_PAYLOAD_TYPE,
+	PROP_PAD_DROPPED,
+	PROP_PAD_LAST
+};
+
+/* m2s only delivers these resolutions and frame rates */
+#define MULTI_VIDEO_FORMATS "{ UYVP, UYVY, I420, v210, BGRx }"
+#define MULTI_VIDEO_RATES "{ (fraction) 60000/1001, (fraction) 30000/1001, (fraction) 50/1, (fraction) 25/1 }"
+
+#define MULTI_VIDEO_CAPS \
+  GST_VIDEO_CAPS_MAKE (MULTI_VIDEO_FORMATS) ", width = (int) 1920, height = (int) 1080, framerate = " MULTI_VIDEO_RATES "; " \
+  GST_VIDEO_CAPS_MAKE (MULTI_VIDEO_FORMATS) ", width = (int) 3840, height = (int) 2160, framerate = " MULTI_VIDEO_RATES
+
+static GstStaticPadTemplate gst_m2smultivideosrc_template =
+GST_STATIC_PAD_TEMPLATE ("src_%u",
+	GST_PAD_SRC,
+	GST_PAD_SOMETIMES,
+	GST_STATIC_CAPS (MULTI_VIDEO_CAPS)
+	);
+
+#define GST_TYPE_M2S_MULTI_VIDEO_SRC_RTP_FORMAT (gst_m2s_multi_video_src_rtp_format_get_type ())
+static GType gst_m2s_multi_video_src_rtp_format_get_type (void)
+{
+	static GType m2s_multi_video_src_rtp_format = 0;
+	if (!m2s_multi_video_src_rtp_format) {
+		static const GEnumValue rtp_formats[] = {
+			{M2S_VIDEO_RTP_FORMAT_RAW_YUV422_10bit, "Raw YUV422 10bit", "raw-yuv422-10bit"},
+			{M2S_VIDEO_RTP_FORMAT_JXSV_YUV422_8bit, "JPEG-XS YUV422 8bit", "jxsv-yuv422-8bit"},
+			{M2S_VIDEO_RTP_FORMAT_JXSV_YUV422_10bit, "JPEG-XS YUV422 10bit", "jxsv-yuv422-10bit"},
+			{M2S_VIDEO_RTP_FORMAT_JXSV_BGRA_8bit, "JPEG-XS BGRA 8bit", "jxsv-bgra-8bit"},
+			{0, NULL, NULL},
+		};
+		m2s_multi_video_src_rtp_format = g_enum_register_static ("GstM2sMultiVideoSrcRtpFormat", rtp_formats);
+	}
+	return m2s_multi_video_src_rtp_format;
+}
+
+static void gst_m2smultivideosrc_child_proxy_init (gpointer g_iface, gpointer iface_data);
+
+G_DEFINE_TYPE (GstM2smultivideosrcPad, gst_m2smultivideosrc_pad, GST_TYPE_PAD);
+
+#define gst_m2smultivideosrc_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE (GstM2smultivideosrc, gst_m2smultivideosrc, GST_TYPE_ELEMENT,
+                         G_IMPLEMENT_INTERFACE (GST_TYPE_CHILD_PROXY, gst_m2smultivideosrc_child_proxy_init));
+
+static void gst_m2smultivideosrc_pad_set_p_if_address (GstM2smultivideosrcPad *pad, const char *p_address);
+static void gst_m2smultivideosrc_pad_set_s_if_address (GstM2smultivideosrcPad *pad, const char *p_address);
+static void gst_m2smultivideosrc_pad_set_p_dst_address (GstM2smultivideosrcPad *pad, const char *p_address);
+static void gst_m2smultivideosrc_pad_set_s_dst_address (GstM2smultivideosrcPad *pad, const char *p_address);
+static void gst_m2smultivideosrc_pad_set_p_src_address (GstM2smultivideosrcPad *pad, const char *p_address);
+static void gst_m2smultivideosrc_pad_set_s_src_address (GstM2smultivideosrcPad *pad, const char *p_address);
+static void gst_m2smultivideosrc_pad_set_p_dst_port (GstM2smultivideosrcPad *pad, uint16_t port);
+static void gst_m2smultivideosrc_pad_set_s_dst_port (GstM2smultivideosrcPad *pad, uint16_t port);
+static void gst_m2smultivideosrc_pad_set_p_src_port (GstM2smultivideosrcPad *pad, uint16_t port);
+static void gst_m2smultivideosrc_pad_set_s_src_port (GstM2smultivideosrcPad *pad, uint16_t port);
+static void gst_m2smultivideosrc_pad_set_payload_type (GstM2smultivideosrcPad *pad, uint8_t payload_type);
+
+static void gst_m2smultivideosrc_set_num_streams (GstM2smultivideosrc *m2smultivideosrc, guint num_streams);
+static void gst_m2smultivideosrc_set_hw_hitless (GstM2smultivideosrc *m2smultivideosrc, bool hw_hitless);
+static void gst_m2smultivideosrc_set_gpu_num (GstM2smultivideosrc *m2smultivideosrc, uint8_t gpu_num);
+static void gst_m2smultivideosrc_set_l2_cpu_num (GstM2smultivideosrc *m2smultivideosrc, int32_t cpu_num);
+static void gst_m2smultivideosrc_set_l1_cpu_num (GstM2smultivideosrc *m2smultivideosrc, int32_t cpu_num);
+static void gst_m2smultivideosrc_set_playout_delay_ms (GstM2smultivideosrc *m2smultivideosrc, int32_t playout_delay_ms);
+static void gst_m2smultivideosrc_set_scan (GstM2smultivideosrc *m2smultivideosrc, uint8_t scan);
+static void gst_m2smultivideosrc_set_rtp_format (GstM2smultivideosrc *m2smultivideosrc, m2s_video_rtp_format_t rtp_format);
+static void gst_m2smultivideosrc_set_ipx_license (GstM2smultivideosrc *m2smultivideosrc, const char *p_file);
+static void gst_m2smultivideosrc_set_sync_timeout_ms (GstM2smultivideosrc *m2smultivideosrc, uint32_t timeout_ms);
+
+static void gst_m2smultivideosrc_set_property (GObject * object, guint prop_id,
+                                               const GValue * value, GParamSpec * pspec);
+static void gst_m2smultivideosrc_get_property (GObject * object, guint prop_id,
+                                               GValue * value, GParamSpec * pspec);
+static void gst_m2smultivideosrc_finalize (GObject * object);
+static void gst_m2smultivideosrc_pad_finalize (GObject * object);
+
+static GstStateChangeReturn gst_m2smultivideosrc_change_state (GstElement * element,
+                                                               GstStateChange transition);
+static GstClock *gst_m2smultivideosrc_provide_clock (GstElement * element);
+
+static gboolean gst_m2smultivideosrc_pad_query (GstPad * pad, GstObject * parent, GstQuery * query);
+static void gst_m2smultivideosrc_loop (GstM2smultivideosrc * p_m2smultivideosrc);
+
+/* pad */
+
+static void gst_m2smultivideosrc_pad_set_p_if_address (GstM2smultivideosrcPad *pad, const char *p_address)
+{
+	strncpy(pad->if_ip[0], p_address, sizeof(pad->if_ip[0]) - 1);
+}
+
+static void gst_m2smultivideosrc_pad_set_s_if_address (GstM2smultivideosrcPad *pad, const char *p_address)
+{
+	strncpy(pad->if_ip[1], p_address, sizeof(pad->if_ip[1]) - 1);
+}
+
+static void gst_m2smultivideosrc_pad_set_p_dst_address (GstM2smultivideosrcPad *pad, const char *p_address)
+{
+	strncpy(pad->dst_ip[0], p_address, sizeof(pad->dst_ip[0]) - 1);
+}
+
+static void gst_m2smultivideosrc_pad_set_s_dst_address (GstM2smultivideosrcPad *pad, const char *p_address)
+{
+	strncpy(pad->dst_ip[1], p_address, sizeof(pad->dst_ip[1]) - 1);
+}
+
+static void gst_m2smultivideosrc_pad_set_p_src_address (GstM2smultivideosrcPad *pad, const char *p_address)
+{
+	strncpy(pad->src_ip[0], p_address, sizeof(pad->src_ip[0]) - 1);
+}
+
+static void gst_m2smultivideosrc_pad_set_s_src_address (GstM2smultivideosrcPad *pad, const char *p_address)
+{
+	strncpy(pad->src_ip[1], p_address, sizeof(pad->src_ip[1]) - 1);
+}
+
+static void gst_m2smultivideosrc_pad_set_p_dst_port (GstM2smultivideosrcPad *pad, uint16_t port)
+{
+	pad->dst_port[0] = port;
+}
+
+static void gst_m2smultivideosrc_pad_set_s_dst_port (GstM2smultivideosrcPad *pad, uint16_t port)
+{
+	pad->dst_port[1] = port;
+}
+
+static void gst_m2smultivideosrc_pad_set_p_src_port (GstM2smultivideosrcPad *pad, uint16_t port)
+{
+	pad->src_port[0] = port;
+}
+
+static void gst_m2smultivideosrc_pad_set_s_src_port (GstM2smultivideosrcPad *pad, uint16_t port)
+{
+	pad->src_port[1] = port;
+}
+
+static void gst_m2smultivideosrc_pad_set_payload_type (GstM2smultivideosrcPad *pad, uint8_t payload_type)
+{
+	pad->payload_type = payload_type;
+}
+
+static void
+gst_m2smultivideosrc_pad_set_property (GObject * object, guint prop_id,
+                                       const GValue * value, GParamSpec * pspec)
+{
+	GstM2smultivideosrcPad *pad = GST_M2SMULTIVIDEOSRC_PAD (object);
+
+	switch (prop_id)
+	{
+	case PROP_PAD_P_IF_ADDRESS:
+		gst_m2smultivideosrc_pad_set_p_if_address (pad, g_value_get_string (value));
+		break;
+	case PROP_PAD_S_IF_ADDRESS:
+		gst_m2smultivideosrc_pad_set_s_if_address (pad, g_value_get_string (value));
+		break;
+	case PROP_PAD_P_DST_ADDRESS:
+		gst_m2smultivideosrc_pad_set_p_dst_address (pad, g_value_get_string (value));
+		break;
+	case PROP_PAD_S_DST_ADDRESS:
+		gst_m2smultivideosrc_pad_set_s_dst_address (pad, g_value_get_string (value));
+		break;
+	case PROP_PAD_P_SRC_ADDRESS:
+		gst_m2smultivideosrc_pad_set_p_src_address (pad, g_value_get_string (value));
+		break;
+	case PROP_PAD_S_SRC_ADDRESS:
+		gst_m2smultivideosrc_pad_set_s_src_address (pad, g_value_get_string (value));
+		break;
+	case PROP_PAD_P_DST_PORT:
+		gst_m2smultivideosrc_pad_set_p_dst_port (pad, g_value_get_uint (value));
+		break;
+	case PROP_PAD_S_DST_PORT:
+		gst_m2smultivideosrc_pad_set_s_dst_port (pad, g_value_get_uint (value));
+		break;
+	case PROP_PAD_P_SRC_PORT:
+		gst_m2smultivideosrc_pad_set_p_src_port (pad, g_value_get_uint (value));
+		break;
+	case PROP_PAD_S_SRC_PORT:
+		gst_m2smultivideosrc_pad_set_s_src_port (pad, g_value_get_uint (value));
+		break;
+	case PROP_PAD_PAYLOAD_TYPE:
+		gst_m2smultivideosrc_pad_set_payload_type (pad, g_value_get_uint (value));
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+		break;
+	}
+}
+
+static void
+gst_m2smultivideosrc_pad_get_property (GObject * object, guint prop_id,
+                                       GValue * value, GParamSpec * pspec)
+{
+	GstM2smultivideosrcPad *pad = GST_M2SMULTIVIDEOSRC_PAD (object);
+
+	switch (prop_id)
+	{
+	case PROP_PAD_P_IF_ADDRESS:
+		g_value_set_string (value, pad->if_ip[0]);
+		break;
+	case PROP_PAD_S_IF_ADDRESS:
+		g_value_set_string (value, pad->if_ip[1]);
+		break;
+	case PROP_PAD_P_DST_ADDRESS:
+		g_value_set_string (value, pad->dst_ip[0]);
+		break;
+	case PROP_PAD_S_DST_ADDRESS:
+		g_value_set_string (value, pad->dst_ip[1]);
+		break;
+	case PROP_PAD_P_SRC_ADDRESS:
+		g_value_set_string (value, pad->src_ip[0]);
+		break;
+	case PROP_PAD_S_SRC_ADDRESS:
+		g_value_set_string (value, pad->src_ip[1]);
+		break;
+	case PROP_PAD_P_DST_PORT:
+		g_value_set_uint (value, pad->dst_port[0]);
+		break;
+	case PROP_PAD_S_DST_PORT:
+		g_value_set_uint (value, pad->dst_port[1]);
+		break;
+	case PROP_PAD_P_SRC_PORT:
+		g_value_set_uint (value, pad->src_port[0]);
+		break;
+	case PROP_PAD_S_SRC_PORT:
+		g_value_set_uint (value, pad->src_port[1]);
+		break;
+	case PROP_PAD_PAYLOAD_TYPE:
+		g_value_set_uint (value, pad->payload_type);
+		break;
+	case PROP_PAD_DROPPED:
+		g_value_set_uint64 (value, pad->dropped);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+		break;
+	}
+}
+
+static void
+gst_m2smultivideosrc_pad_class_init (GstM2smultivideosrcPadClass * klass)
+{
+	GObjectClass *gobject_class = (GObjectClass *) klass;
+
+	gobject_class->set_property = gst_m2smultivideosrc_pad_set_property;
+	gobject_class->get_property = gst_m2smultivideosrc_pad_get_property;
+	gobject_class->finalize = gst_m2smultivideosrc_pad_finalize;
+
+	g_object_class_install_property (gobject_class, PROP_PAD_P_IF_ADDRESS,
+	                                 g_param_spec_string ("p-if-address", "Primary Interface Address",
+	                                                      "Interface Address", DEFAULT_P_IF_ADDRESS,
+	                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PAD_S_IF_ADDRESS,
+	                                 g_param_spec_string ("s-if-address", "Secondary Interface Address",
+	                                                      "Interface Address", DEFAULT_S_IF_ADDRESS,
+	                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PAD_P_DST_ADDRESS,
+	                                 g_param_spec_string ("p-dst-address", "Primary Destination Address",
+	                                                      "Destination Address", DEFAULT_P_DST_ADDRESS,
+	                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PAD_S_DST_ADDRESS,
+	                                 g_param_spec_string ("s-dst-address", "Secondary Destination Address",
+	                                                      "Destination Address", DEFAULT_S_DST_ADDRESS,
+	                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PAD_P_SRC_ADDRESS,
+	                                 g_param_spec_string ("p-src-address", "Primary Source Address",
+	                                                      "Source Address", DEFAULT_P_SRC_ADDRESS,
+	                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PAD_S_SRC_ADDRESS,
+	                                 g_param_spec_string ("s-src-address", "Secondary Source Address",
+	                                                      "Source Address", DEFAULT_S_SRC_ADDRESS,
+	                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PAD_P_DST_PORT,
+	                                 g_param_spec_uint ("p-dst-port", "Primary Destination Port",
+	                                                    "Destination Port", 0, 65535, DEFAULT_P_DST_PORT,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PAD_S_DST_PORT,
+	                                 g_param_spec_uint ("s-dst-port", "Secondary Destination Port",
+	                                                    "Destination Port", 0, 65535, DEFAULT_S_DST_PORT,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PAD_P_SRC_PORT,
+	                                 g_param_spec_uint ("p-src-port", "Primary Source Port",
+	                                                    "Source Port", 0, 65535, DEFAULT_P_SRC_PORT,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PAD_S_SRC_PORT,
+	                                 g_param_spec_uint ("s-src-port", "Secondary Source Port",
+	                                                    "Source Port", 0, 65535, DEFAULT_S_SRC_PORT,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PAD_PAYLOAD_TYPE,
+	                                 g_param_spec_uint ("payload-type", "Payload Type",
+	                                                    "Payload Type", 0, 127, DEFAULT_PAYLOAD_TYPE,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PAD_DROPPED,
+	                                 g_param_spec_uint64 ("dropped", "Dropped",
+	                                                      "Frames dropped because no other stream had a matching RTP timestamp",
+	                                                      0, G_MAXUINT64, 0,
+	                                                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+}
+
+static void
+gst_m2smultivideosrc_pad_init (GstM2smultivideosrcPad * pad)
+{
+	gst_m2smultivideosrc_pad_set_p_if_address(pad, DEFAULT_P_IF_ADDRESS);
+	gst_m2smultivideosrc_pad_set_s_if_address(pad, DEFAULT_S_IF_ADDRESS);
+	gst_m2smultivideosrc_pad_set_p_dst_address(pad, DEFAULT_P_DST_ADDRESS);
+	gst_m2smultivideosrc_pad_set_s_dst_address(pad, DEFAULT_S_DST_ADDRESS);
+	gst_m2smultivideosrc_pad_set_p_src_address(pad, DEFAULT_P_SRC_ADDRESS);
+	gst_m2smultivideosrc_pad_set_s_src_address(pad, DEFAULT_S_SRC_ADDRESS);
+	gst_m2smultivideosrc_pad_set_p_dst_port(pad, DEFAULT_P_DST_PORT);
+	gst_m2smultivideosrc_pad_set_s_dst_port(pad, DEFAULT_S_DST_PORT);
+	gst_m2smultivideosrc_pad_set_p_src_port(pad, DEFAULT_P_SRC_PORT);
+	gst_m2smultivideosrc_pad_set_s_src_port(pad, DEFAULT_S_SRC_PORT);
+	gst_m2smultivideosrc_pad_set_payload_type(pad, DEFAULT_PAYLOAD_TYPE);
+	g_mutex_init(&pad->lease_lock);
+	g_cond_init(&pad->lease_cond);
+	g_queue_init(&pad->leases);
+}
+
+static void
+gst_m2smultivideosrc_pad_finalize (GObject * object)
+{
+	GstM2smultivideosrcPad *pad = GST_M2SMULTIVIDEOSRC_PAD (object);
+
+	g_mutex_clear (&pad->lease_lock);
+	g_cond_clear (&pad->lease_cond);
+
+	G_OBJECT_CLASS (gst_m2smultivideosrc_pad_parent_class)->finalize (object);
+}
+
+/* child proxy, so that gst-launch can set src_N::property */
+
+static GObject *
+gst_m2smultivideosrc_child_proxy_get_child_by_index (GstChildProxy * child_proxy, guint index)
+{
+	GstM2smultivideosrc *p_m2smultivideosrc = GST_M2SMULTIVIDEOSRC (child_proxy);
+	GObject *p_obj = NULL;
+
+	GST_OBJECT_LOCK (p_m2smultivideosrc);
+	if (index < p_m2smultivideosrc->num_streams)
+	{
+		p_obj = (GObject *)gst_object_ref (p_m2smultivideosrc->p_pads[index]);
+	}
+	GST_OBJECT_UNLOCK (p_m2smultivideosrc);
+
+	return p_obj;
+}
+
+static guint
+gst_m2smultivideosrc_child_proxy_get_children_count (GstChildProxy * child_proxy)
+{
+	GstM2smultivideosrc *p_m2smultivideosrc = GST_M2SMULTIVIDEOSRC (child_proxy);
+	guint count;
+
+	GST_OBJECT_LOCK (p_m2smultivideosrc);
+	count = p_m2smultivideosrc->num_streams;
+	GST_OBJECT_UNLOCK (p_m2smultivideosrc);
+
+	return count;
+}
+
+static void
+gst_m2smultivideosrc_child_proxy_init (gpointer g_iface, gpointer iface_data)
+{
+	GstChildProxyInterface *iface = (GstChildProxyInterface *) g_iface;
+
+	iface->get_child_by_index = gst_m2smultivideosrc_child_proxy_get_child_by_index;
+	iface->get_children_count = gst_m2smultivideosrc_child_proxy_get_children_count;
+}
+
+/* element */
+
+// Streams can only be added or removed in the NULL state, where no m2s stream exists
+static void gst_m2smultivideosrc_set_num_streams (GstM2smultivideosrc *m2smultivideosrc, guint num_streams)
+{
+	GstElement *p_element = GST_ELEMENT (m2smultivideosrc);
+	GstPadTemplate *p_templ;
+	GstM2smultivideosrcPad *pad;
+	gchar *p_name;
+
+	if (GST_STATE (m2smultivideosrc) != GST_STATE_NULL)
+	{
+		GST_WARNING_OBJECT (m2smultivideosrc, "num-streams can only be changed in the NULL state");
+		return;
+	}
+
+	while (m2smultivideosrc->num_streams > num_streams)
+	{
+		pad = m2smultivideosrc->p_pads[--m2smultivideosrc->num_streams];
+		m2smultivideosrc->p_pads[m2smultivideosrc->num_streams] = NULL;
+		gst_child_proxy_child_removed (GST_CHILD_PROXY (m2smultivideosrc), G_OBJECT (pad), GST_OBJECT_NAME (pad));
+		gst_flow_combiner_remove_pad (m2smultivideosrc->p_flow_combiner, GST_PAD (pad));
+		gst_element_remove_pad (p_element, GST_PAD (pad));
+	}
+
+	p_templ = gst_static_pad_template_get (&gst_m2smultivideosrc_template);
+	while (m2smultivideosrc->num_streams < num_streams)
+	{
+		p_name = g_strdup_printf ("src_%u", m2smultivideosrc->num_streams);
+		pad = (GstM2smultivideosrcPad *)g_object_new (GST_TYPE_M2SMULTIVIDEOSRC_PAD,
+		                                              "name", p_name, "direction", GST_PAD_SRC, "template", p_templ, NULL);
+		g_free (p_name);
+
+		gst_pad_set_query_function (GST_PAD (pad), gst_m2smultivideosrc_pad_query);
+		gst_pad_use_fixed_caps (GST_PAD (pad));
+
+		m2smultivideosrc->p_pads[m2smultivideosrc->num_streams++] = pad;
+		gst_element_add_pad (p_element, GST_PAD (pad));
+		gst_flow_combiner_add_pad (m2smultivideosrc->p_flow_combiner, GST_PAD (pad));
+		gst_child_proxy_child_added (GST_CHILD_PROXY (m2smultivideosrc), G_OBJECT (pad), GST_OBJECT_NAME (pad));
+	}
+	gst_object_unref (p_templ);
+}
+
+static void gst_m2smultivideosrc_set_hw_hitless (GstM2smultivideosrc *m2smultivideosrc, bool hw_hitless)
+{
+	m2smultivideosrc->hw_hitless = hw_hitless;
+}
+
+static void gst_m2smultivideosrc_set_gpu_num (GstM2smultivideosrc *m2smultivideosrc, uint8_t gpu_num)
+{
+	m2smultivideosrc->gpu_num = gpu_num;
+}
+
+static void gst_m2smultivideosrc_set_l2_cpu_num (GstM2smultivideosrc *m2smultivideosrc, int32_t cpu_num)
+{
+	m2smultivideosrc->l2_cpu_num = cpu_num;
+}
+
+static void gst_m2smultivideosrc_set_l1_cpu_num (GstM2smultivideosrc *m2smultivideosrc, int32_t cpu_num)
+{
+	m2smultivideosrc->l1_cpu_num = cpu_num;
+}
+
+static void gst_m2smultivideosrc_set_playout_delay_ms (GstM2smultivideosrc *m2smultivideosrc, int32_t playout_delay_ms)
+{
+	m2smultivideosrc->playout_delay_ms = playout_delay_ms;
+}
+
+static void gst_m2smultivideosrc_set_scan (GstM2smultivideosrc *m2smultivideosrc, uint8_t scan)
+{
+	m2smultivideosrc->scan = scan;
+}
+
+static void gst_m2smultivideosrc_set_rtp_format (GstM2smultivideosrc *m2smultivideosrc, m2s_video_rtp_format_t rtp_format)
+{
+	m2smultivideosrc->rtp_format = rtp_format;
+}
+
+static void gst_m2smultivideosrc_set_ipx_license (GstM2smultivideosrc *m2smultivideosrc, const char *p_file)
+{
+	strncpy(m2smultivideosrc->ipx_license, p_file, sizeof(m2smultivideosrc->ipx_license) - 1);
+}
+
+static void gst_m2smultivideosrc_set_sync_timeout_ms (GstM2smultivideosrc *m2smultivideosrc, uint32_t timeout_ms)
+{
+	m2smultivideosrc->sync_timeout_ms = timeout_ms;
+}
+
+static void
+gst_m2smultivideosrc_class_init (GstM2smultivideosrcClass * klass)
+{
+	GObjectClass *gobject_class;
+	GstElementClass *gstelement_class;
+
+	gobject_class = (GObjectClass *) klass;
+	gstelement_class = (GstElementClass *) klass;
+
+	gobject_class->set_property = gst_m2smultivideosrc_set_property;
+	gobject_class->get_property = gst_m2smultivideosrc_get_property;
+	gobject_class->finalize = gst_m2smultivideosrc_finalize;
+
+	g_object_class_install_property (gobject_class, PROP_NUM_STREAMS,
+	                                 g_param_spec_uint ("num-streams", "Number of Streams",
+	                                                    "Number of RX streams, one src_N pad each. Set it before the src_N properties",
+	                                                    0, M2SMULTIVIDEOSRC_MAX_STREAMS, DEFAULT_NUM_STREAMS,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_HW_HITLESS,
+	                                 g_param_spec_boolean ("hw-hitless", "HW hitless",
+	                                                       "Enable HW hitless", DEFAULT_HW_HITLESS,
+	                                                       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_GPU_NUM,
+	                                 g_param_spec_uint ("gpu-num", "GPU Number",
+	                                                    "GPU Number", 0, 255, DEFAULT_GPU_NUM,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_L2_CPU_NUM,
+	                                 g_param_spec_int ("l2-cpu-num", "L2 CPU Number",
+	                                                   "L2 CPU Number", -1, 255, DEFAULT_L2_CPU_NUM,
+	                                                   (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_L1_CPU_NUM,
+	                                 g_param_spec_int ("l1-cpu-num", "L1 CPU Number",
+	                                                   "L1 CPU Number", -1, 255, DEFAULT_L1_CPU_NUM,
+	                                                   (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PLAYOUT_DELAY_MS,
+	                                 g_param_spec_int ("playout-delay-ms", "Playout Delay",
+	                                                   "Playout Delay (ms)", G_MININT32, G_MAXINT32, DEFAULT_PLAYOUT_DELAY_MS,
+	                                                   (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_SCAN,
+	                                 g_param_spec_uint ("scan", "SCAN",
+	                                                    "0:PROGRESSIVE, 1:INTERLACE_TFF, 2:INTERLACE_BFF", 0, 2, DEFAULT_SCAN,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_RTP_FORMAT,
+	                                 g_param_spec_enum ("rtp-format", "RTP Format",
+	                                                    "RTP payload format of all streams",
+	                                                    GST_TYPE_M2S_MULTI_VIDEO_SRC_RTP_FORMAT, DEFAULT_RTP_FORMAT,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_IPX_LICENSE,
+	                                 g_param_spec_string ("ipx-license", "IPX License",
+	                                                      "IPX License File", DEFAULT_IPX_LICENSE,
+	                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_SYNC_TIMEOUT_MS,
+	                                 g_param_spec_uint ("sync-timeout-ms", "Sync Timeout",
+	                                                    "How long to wait for the missing frames of a set before pushing it incomplete (ms)",
+	                                                    0, G_MAXUINT32, DEFAULT_SYNC_TIMEOUT_MS,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_SETS,
+	                                 g_param_spec_uint64 ("sets", "Sets",
+	                                                      "Frame sets pushed", 0, G_MAXUINT64, 0,
+	                                                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_INCOMPLETE_SETS,
+	                                 g_param_spec_uint64 ("incomplete-sets", "Incomplete Sets",
+	                                                      "Frame sets pushed after sync-timeout-ms with a GAP for the missing streams",
+	                                                      0, G_MAXUINT64, 0,
+	                                                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	gstelement_class->change_state = gst_m2smultivideosrc_change_state;
+	gstelement_class->provide_clock = gst_m2smultivideosrc_provide_clock;
+
+	gst_element_class_set_static_metadata (gstelement_class,
+	                                       "M2S multi video source", "Source/Video/Network",
+	                                       "Receives several video streams and pushes frames with matching RTP timestamps together",
+	                                       "FIXME <fixme@example.com>");
+
+	gst_element_class_add_static_pad_template (gstelement_class,
+	                                           &gst_m2smultivideosrc_template);
+}
+
+static void
+gst_m2smultivideosrc_init (GstM2smultivideosrc * p_m2smultivideosrc)
+{
+	GST_OBJECT_FLAG_SET (p_m2smultivideosrc, GST_ELEMENT_FLAG_SOURCE);
+	GST_OBJECT_FLAG_SET (p_m2smultivideosrc, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
+
+	g_rec_mutex_init (&p_m2smultivideosrc->task_lock);
+	p_m2smultivideosrc->p_task = gst_task_new ((GstTaskFunction) gst_m2smultivideosrc_loop, p_m2smultivideosrc, NULL);
+	gst_task_set_lock (p_m2smultivideosrc->p_task, &p_m2smultivideosrc->task_lock);
+	p_m2smultivideosrc->p_flow_combiner = gst_flow_combiner_new ();
+	gst_video_info_init (&p_m2smultivideosrc->info);
+
+	gst_m2smultivideosrc_set_num_streams(p_m2smultivideosrc, DEFAULT_NUM_STREAMS);
+	gst_m2smultivideosrc_set_hw_hitless(p_m2smultivideosrc, DEFAULT_HW_HITLESS);
+	gst_m2smultivideosrc_set_gpu_num(p_m2smultivideosrc, DEFAULT_GPU_NUM);
+	gst_m2smultivideosrc_set_l2_cpu_num(p_m2smultivideosrc, DEFAULT_L2_CPU_NUM);
+	gst_m2smultivideosrc_set_l1_cpu_num(p_m2smultivideosrc, DEFAULT_L1_CPU_NUM);
+	gst_m2smultivideosrc_set_playout_delay_ms(p_m2smultivideosrc, DEFAULT_PLAYOUT_DELAY_MS);
+	gst_m2smultivideosrc_set_scan(p_m2smultivideosrc, DEFAULT_SCAN);
+	gst_m2smultivideosrc_set_rtp_format(p_m2smultivideosrc, DEFAULT_RTP_FORMAT);
+	gst_m2smultivideosrc_set_ipx_license(p_m2smultivideosrc, DEFAULT_IPX_LICENSE);
+	gst_m2smultivideosrc_set_sync_timeout_ms(p_m2smultivideosrc, DEFAULT_SYNC_TIMEOUT_MS);
+}
+
+static void
+gst_m2smultivideosrc_finalize (GObject * object)
+{
+	GstM2smultivideosrc *p_m2smultivideosrc = GST_M2SMULTIVIDEOSRC (object);
+
+	gst_object_unref (p_m2smultivideosrc->p_task);
+	g_rec_mutex_clear (&p_m2smultivideosrc->task_lock);
+	gst_flow_combiner_free (p_m2smultivideosrc->p_flow_combiner);
+
+	G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_m2smultivideosrc_set_property (GObject * object, guint prop_id,
+                                   const GValue * value, GParamSpec * pspec)
+{
+	GstM2smultivideosrc *p_m2smultivideosrc = GST_M2SMULTIVIDEOSRC (object);
+
+	switch (prop_id)
+	{
+	case PROP_NUM_STREAMS:
+		gst_m2smultivideosrc_set_num_streams (p_m2smultivideosrc, g_value_get_uint (value));
+		break;
+	case PROP_HW_HITLESS:
+		gst_m2smultivideosrc_set_hw_hitless (p_m2smultivideosrc, g_value_get_boolean (value));
+		break;
+	case PROP_GPU_NUM:
+		gst_m2smultivideosrc_set_gpu_num (p_m2smultivideosrc, g_value_get_uint (value));
+		break;
+	case PROP_L2_CPU_NUM:
+		gst_m2smultivideosrc_set_l2_cpu_num (p_m2smultivideosrc, g_value_get_int (value));
+		break;
+	case PROP_L1_CPU_NUM:
+		gst_m2smultivideosrc_set_l1_cpu_num (p_m2smultivideosrc, g_value_get_int (value));
+		break;
+	case PROP_PLAYOUT_DELAY_MS:
+		gst_m2smultivideosrc_set_playout_delay_ms (p_m2smultivideosrc, g_value_get_int (value));
+		break;
+	case PROP_SCAN:
+		gst_m2smultivideosrc_set_scan (p_m2smultivideosrc, g_value_get_uint (value));
+		break;
+	case PROP_RTP_FORMAT:
+		gst_m2smultivideosrc_set_rtp_format (p_m2smultivideosrc, (m2s_video_rtp_format_t)g_value_get_enum (value));
+		break;
+	case PROP_IPX_LICENSE:
+		gst_m2smultivideosrc_set_ipx_license (p_m2smultivideosrc, g_value_get_string (value));
+		break;
+	case PROP_SYNC_TIMEOUT_MS:
+		gst_m2smultivideosrc_set_sync_timeout_ms (p_m2smultivideosrc, g_value_get_uint (value));
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+		break;
+	}
+}
+
+static void
+gst_m2smultivideosrc_get_property (GObject * object, guint prop_id,
+                                   GValue * value, GParamSpec * pspec)
+{
+	GstM2smultivideosrc *p_m2smultivideosrc = GST_M2SMULTIVIDEOSRC (object);
+
+	switch (prop_id)
+	{
+	case PROP_NUM_STREAMS:
+		g_value_set_uint (value, p_m2smultivideosrc->num_streams);
+		break;
+	case PROP_HW_HITLESS:
+		g_value_set_boolean (value, p_m2smultivideosrc->hw_hitless);
+		break;
+	case PROP_GPU_NUM:
+		g_value_set_uint (value, p_m2smultivideosrc->gpu_num);
+		break;
+	case PROP_L2_CPU_NUM:
+		g_value_set_int (value, p_m2smultivideosrc->l2_cpu_num);
+		break;
+	case PROP_L1_CPU_NUM:
+		g_value_set_int (value, p_m2smultivideosrc->l1_cpu_num);
+		break;
+	case PROP_PLAYOUT_DELAY_MS:
+		g_value_set_int (value, p_m2smultivideosrc->playout_delay_ms);
+		break;
+	case PROP_SCAN:
+		g_value_set_uint (value, p_m2smultivideosrc->scan);
+		break;
+	case PROP_RTP_FORMAT:
+		g_value_set_enum (value, p_m2smultivideosrc->rtp_format);
+		break;
+	case PROP_IPX_LICENSE:
+		g_value_set_string (value, p_m2smultivideosrc->ipx_license);
+		break;
+	case PROP_SYNC_TIMEOUT_MS:
+		g_value_set_uint (value, p_m2smultivideosrc->sync_timeout_ms);
+		break;
+	case PROP_SETS:
+		g_value_set_uint64 (value, p_m2smultivideosrc->sets);
+		break;
+	case PROP_INCOMPLETE_SETS:
+		g_value_set_uint64 (value, p_m2smultivideosrc->incomplete_sets);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+		break;
+	}
+}
+
+static GstClock *
+gst_m2smultivideosrc_provide_clock (GstElement * element)
+{
+	return gst_m2s_clock_obtain();
+}
+
+static gboolean
+gst_m2smultivideosrc_pad_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+	GstM2smultivideosrc *p_m2smultivideosrc = GST_M2SMULTIVIDEOSRC (parent);
+	GstClockTime frame_duration;
+	GstClockTime min_latency;
+	GstClockTime max_latency;
+
+	switch (GST_QUERY_TYPE (query))
+	{
+	case GST_QUERY_LATENCY:
+		if (p_m2smultivideosrc->info.fps_n <= 0)
+		{
+			return FALSE;
+		}
+		// a set is held until its last frame arrived, at most sync-timeout-ms
+		frame_duration = gst_util_uint64_scale (GST_SECOND, p_m2smultivideosrc->info.fps_d, p_m2smultivideosrc->info.fps_n);
+		min_latency = (GstClockTime)MAX (p_m2smultivideosrc->playout_delay_ms, 0) * GST_MSECOND + frame_duration;
+		max_latency = min_latency + (GstClockTime)p_m2smultivideosrc->sync_timeout_ms * GST_MSECOND;
+		gst_query_set_latency (query, TRUE, min_latency, max_latency);
+		return TRUE;
+
+	default:
+		return gst_pad_query_default (pad, parent, query);
+	}
+}
+
+static void set_m2s_conf(GstM2smultivideosrc *p_m2smultivideosrc, GstM2smultivideosrcPad *pad)
+{
+	GstVideoInfo *p_info = &p_m2smultivideosrc->info;
+	m2s_media_conf_t media_conf;
+	m2s_ip_conf_t ip_conf;
+	memset(&media_conf, 0, sizeof(media_conf));
+	memset(&ip_conf, 0, sizeof(ip_conf));
+
+	for (int i = 0; i < 2; i++)
+	{
+		ip_conf.rx_only.if_ip[i] = m2s_conv_ip_address_from_string(pad->if_ip[i]);
+		ip_conf.dst_ip[i] = m2s_conv_ip_address_from_string(pad->dst_ip[i]);
+		ip_conf.src_ip[i] = m2s_conv_ip_address_from_string(pad->src_ip[i]);
+		ip_conf.dst_port[i] = pad->dst_port[i];
+		ip_conf.src_port[i] = pad->src_port[i];
+		ip_conf.payload_type[i] = pad->payload_type;
+		ip_conf.rtp_enabled[i] = (ip_conf.rx_only.if_ip[i] == 0) ? false : true;
+		DBG_MSG("%s: dst_ip[%u]=%s:%u\n", GST_PAD_NAME (pad), i, pad->dst_ip[i], ip_conf.dst_port[i]);
+	}
+	ip_conf.rx_only.playout_delay_ms = p_m2smultivideosrc->playout_delay_ms;
+
+	if (GST_VIDEO_INFO_WIDTH(p_info) == 3840)
+	{
+		media_conf.video.app_caps.resolution = M2S_VIDEO_RESOLUTION_3840x2160;
+	}
+	else
+	{
+		media_conf.video.app_caps.resolution = M2S_VIDEO_RESOLUTION_1920x1080;
+	}
+
+	switch (GST_VIDEO_INFO_FORMAT(p_info))
+	{
+	case GST_VIDEO_FORMAT_I420:
+		media_conf.video.app_caps.format = M2S_VIDEO_APP_FORMAT_I420;
+		break;
+	case GST_VIDEO_FORMAT_UYVP:
+		media_conf.video.app_caps.format = M2S_VIDEO_APP_FORMAT_UYVP;
+		break;
+	case GST_VIDEO_FORMAT_UYVY:
+		media_conf.video.app_caps.format = M2S_VIDEO_APP_FORMAT_UYVY;
+		break;
+	case GST_VIDEO_FORMAT_v210:
+		media_conf.video.app_caps.format = M2S_VIDEO_APP_FORMAT_V210;
+		break;
+	case GST_VIDEO_FORMAT_BGRx:
+		media_conf.video.app_caps.format = M2S_VIDEO_APP_FORMAT_BGRx;
+		break;
+	default:
+		DBG_MSG("!!! unknown video format !!!\n");
+		break;
+	}
+
+	if (GST_VIDEO_INFO_FPS_N(p_info) == 60000)
+	{
+		media_conf.video.app_caps.frame_rate = M2S_FRAME_RATE_60000_1001;
+	}
+	else if (GST_VIDEO_INFO_FPS_N(p_info) == 30000)
+	{
+		media_conf.video.app_caps.frame_rate = M2S_FRAME_RATE_30000_1001;
+	}
+	else if (GST_VIDEO_INFO_FPS_N(p_info) == 50)
+	{
+		media_conf.video.app_caps.frame_rate = M2S_FRAME_RATE_50_1;
+	}
+	else
+	{
+		media_conf.video.app_caps.frame_rate = M2S_FRAME_RATE_25_1;
+	}
+
+	media_conf.video.rtp_caps.format = p_m2smultivideosrc->rtp_format;
+	media_conf.video.rtp_caps.scan = (m2s_video_scan_t)p_m2smultivideosrc->scan;
+	media_conf.video.rtp_caps.frame_rate = media_conf.video.app_caps.frame_rate;
+	media_conf.video.rtp_caps.resolution = media_conf.video.app_caps.resolution;
+	media_conf.video.rtp_caps.target_bpp = 0; // TX only
+	p_m2smultivideosrc->m2s_frame_rate = media_conf.video.rtp_caps.frame_rate;
+
+	m2s_set_media_conf(pad->strm_id, &media_conf);
+	m2s_set_ip_conf(pad->strm_id, &ip_conf);
+}
+
+static GstCaps *fixate_caps_m2s(GstM2smultivideosrc *p_m2smultivideosrc, GstCaps *p_caps)
+{
+	GstStructure *structure;
+
+	p_caps = gst_caps_truncate (p_caps);
+	p_caps = gst_caps_make_writable (p_caps);
+	structure = gst_caps_get_structure (p_caps, 0);
+
+	gst_structure_fixate_field_nearest_fraction (structure, "framerate", 60000, 1001);
+	gst_structure_set (structure, "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1, NULL);
+
+	if (p_m2smultivideosrc->scan == M2S_VIDEO_SCAN_PROGRESSIVE)
+	{
+		gst_structure_set (structure, "interlace-mode", G_TYPE_STRING, "progressive", NULL);
+	}
+	else
+	{
+		gst_structure_set (structure, "interlace-mode", G_TYPE_STRING, "interleaved",
+		                   "field-order", G_TYPE_STRING,
+		                   (p_m2smultivideosrc->scan == M2S_VIDEO_SCAN_INTERLACE_TFF) ? "top-field-first" : "bottom-field-first",
+		                   NULL);
+	}
+
+	return gst_caps_fixate (p_caps);
+}
+
+// All pads carry the same caps, so intersect what every peer accepts,
+// then send the sticky events and configure the m2s streams with the result.
+static gboolean negotiate_m2s(GstM2smultivideosrc *p_m2smultivideosrc)
+{
+	GstM2smultivideosrcPad *pad;
+	GstCaps *p_caps;
+	GstCaps *p_peer_caps;
+	GstSegment segment;
+	gchar *p_stream_id;
+	guint group_id;
+	GstEvent *p_event;
+	guint i;
+
+	p_caps = gst_static_pad_template_get_caps (&gst_m2smultivideosrc_template);
+	for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+	{
+		p_peer_caps = gst_pad_peer_query_caps (GST_PAD (p_m2smultivideosrc->p_pads[i]), p_caps);
+		gst_caps_unref (p_caps);
+		p_caps = p_peer_caps;
+		if (gst_caps_is_empty (p_caps))
+		{
+			gst_caps_unref (p_caps);
+			GST_ELEMENT_ERROR (p_m2smultivideosrc, CORE, NEGOTIATION, (NULL),
+			                   ("no caps accepted by all downstream peers"));
+			return FALSE;
+		}
+	}
+	p_caps = fixate_caps_m2s (p_m2smultivideosrc, p_caps);
+	GST_DEBUG_OBJECT (p_m2smultivideosrc, "negotiated %" GST_PTR_FORMAT, p_caps);
+
+	if (!gst_video_info_from_caps (&p_m2smultivideosrc->info, p_caps))
+	{
+		gst_caps_unref (p_caps);
+		GST_ELEMENT_ERROR (p_m2smultivideosrc, CORE, NEGOTIATION, (NULL),
+		                   ("invalid caps"));
+		return FALSE;
+	}
+
+	gst_segment_init (&segment, GST_FORMAT_TIME);
+	group_id = gst_util_group_id_next ();
+
+	for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+	{
+		pad = p_m2smultivideosrc->p_pads[i];
+
+		p_stream_id = gst_pad_create_stream_id (GST_PAD (pad), GST_ELEMENT (p_m2smultivideosrc), GST_PAD_NAME (pad));
+		p_event = gst_event_new_stream_start (p_stream_id);
+		gst_event_set_group_id (p_event, group_id);
+		gst_pad_push_event (GST_PAD (pad), p_event);
+		g_free (p_stream_id);
+
+		gst_pad_push_event (GST_PAD (pad), gst_event_new_caps (p_caps));
+		gst_pad_push_event (GST_PAD (pad), gst_event_new_segment (&segment));
+
+		set_m2s_conf (p_m2smultivideosrc, pad);
+	}
+	gst_caps_unref (p_caps);
+
+	return TRUE;
+}
+
+// Leases still held downstream when the stream is deleted. The stream is only
+// deleted once the last of them is released.
+typedef struct
+{
+	m2s_strm_id_t strm_id;
+	guint count;
+} GstM2smultivideosrcOrphans;
+
+// One m2s read pointer, pushed downstream without a copy like the frames of m2svideosrc
+struct _GstM2smultivideosrcLease
+{
+	GstM2smultivideosrcPad *pad;
+	uint8_t *p_frame;
+	uint32_t frame_size;
+	uint32_t rtp_timestamp;
+	uint64_t capture_tai;
+	gint ref_count;
+	bool released;
+	GstM2smultivideosrcOrphans *p_orphans; /* set once the stream is deleted */
+};
+
+// m2s_free_read_ptr() always returns the oldest read pointer, so a lease that is
+// dropped out of order is only marked released, and freed here once all older
+// leases are done. Only the streaming thread, or the state change thread while
+// the task is stopped, calls this.
+static void reclaim_leases_m2s(GstM2smultivideosrcPad *pad)
+{
+	GstM2smultivideosrcLease *p_lease;
+
+	g_mutex_lock(&pad->lease_lock);
+	while (((p_lease = (GstM2smultivideosrcLease *)g_queue_peek_head(&pad->leases)) != nullptr) &&
+		   p_lease->released)
+	{
+		g_queue_pop_head(&pad->leases);
+		g_free(p_lease);
+		m2s_free_read_ptr(pad->strm_id);
+	}
+	g_mutex_unlock(&pad->lease_lock);
+}
+
+static inline void read_frame_m2s(GstM2smultivideosrcPad *pad)
+{
+	GstM2smultivideosrcLease *p_lease;
+	m2s_media_t media;
+	m2s_media_size_t size;
+	uint32_t rtp_timestamp;
+
+	reclaim_leases_m2s(pad);
+
+	if (m2s_get_read_ptr(pad->strm_id, &rtp_timestamp, &media, &size) != M2S_RET_SUCCESS)
+	{
+		return;
+	}
+
+	p_lease = g_new0(GstM2smultivideosrcLease, 1);
+	p_lease->pad = (GstM2smultivideosrcPad *)gst_object_ref(pad);
+	p_lease->p_frame = media.video.p_frame;
+	p_lease->frame_size = size.video.frame_size;
+	p_lease->rtp_timestamp = rtp_timestamp;
+	p_lease->capture_tai = m2s_conv_rtptime_to_tai(rtp_timestamp, M2S_RTP_COUNTER_FREQ_90KHZ);
+	p_lease->ref_count = 1;
+
+	g_mutex_lock(&pad->lease_lock);
+	g_queue_push_tail(&pad->leases, p_lease);
+	g_mutex_unlock(&pad->lease_lock);
+
+	pad->p_lease = p_lease;
+}
+
+// Also the GDestroyNotify of pushed buffers, so this runs on any thread and
+// never calls into m2s itself, except to delete a stream left to its orphans.
+static void release_lease_m2s(GstM2smultivideosrcLease *p_lease)
+{
+	GstM2smultivideosrcPad *pad = p_lease->pad;
+	GstM2smultivideosrcOrphans *p_orphans;
+
+	if (!g_atomic_int_dec_and_test(&p_lease->ref_count))
+	{
+		return;
+	}
+
+	g_mutex_lock(&pad->lease_lock);
+	p_orphans = p_lease->p_orphans;
+	if (p_orphans == nullptr)
+	{
+		p_lease->released = true;
+		g_cond_broadcast(&pad->lease_cond);
+	}
+	else
+	{
+		g_free(p_lease);
+		if (--p_orphans->count == 0)
+		{
+			GST_DEBUG_OBJECT (pad, "last orphaned frame released, deleting the stream");
+			m2s_delete(p_orphans->strm_id);
+			g_free(p_orphans);
+		}
+	}
+	g_mutex_unlock(&pad->lease_lock);
+
+	gst_object_unref(pad);
+}
+
+static inline void free_frame_m2s(GstM2smultivideosrcPad *pad)
+{
+	if (pad->p_lease != nullptr)
+	{
+		release_lease_m2s(pad->p_lease);
+		pad->p_lease = nullptr;
+	}
+}
+
+// Frames of the stream downstream holds, not counting the one about to be pushed
+static guint held_leases_locked_m2s(GstM2smultivideosrcPad *pad)
+{
+	GstM2smultivideosrcLease *p_lease;
+	GList *p_link;
+	guint held = 0;
+
+	for (p_link = pad->leases.head; p_link != nullptr; p_link = p_link->next)
+	{
+		p_lease = (GstM2smultivideosrcLease *)p_link->data;
+		held += (!p_lease->released && (p_lease != pad->p_lease)) ? 1 : 0;
+	}
+	return held;
+}
+
+// Called instead of m2s_delete(). The frame memory of leases still held
+// downstream belongs to the stream, so then the stream is handed over to them
+// and deleted by the last release. Returns false if the stream can be deleted now.
+static bool orphan_leases_m2s(GstM2smultivideosrcPad *pad)
+{
+	GstM2smultivideosrcOrphans *p_orphans;
+	GstM2smultivideosrcLease *p_lease;
+	GList *p_link;
+	guint held = 0;
+
+	g_mutex_lock(&pad->lease_lock);
+	for (p_link = pad->leases.head; p_link != nullptr; p_link = p_link->next)
+	{
+		held += ((GstM2smultivideosrcLease *)p_link->data)->released ? 0 : 1;
+	}
+
+	p_orphans = nullptr;
+	if (held > 0)
+	{
+		p_orphans = g_new0(GstM2smultivideosrcOrphans, 1);
+		p_orphans->strm_id = pad->strm_id;
+		p_orphans->count = held;
+		GST_DEBUG_OBJECT (pad, "%u frames still held downstream, deleting the stream after them", held);
+	}
+
+	while ((p_lease = (GstM2smultivideosrcLease *)g_queue_pop_head(&pad->leases)) != nullptr)
+	{
+		if (p_lease->released)
+		{
+			g_free(p_lease);
+		}
+		else
+		{
+			p_lease->p_orphans = p_orphans;
+		}
+	}
+	g_mutex_unlock(&pad->lease_lock);
+
+	return p_orphans != nullptr;
+}
+
+// The buffer shares the m2s frame. m2s_free_read_ptr() only frees the oldest
+// read pointer, so a copy would not give a FIFO slot back while older frames
+// are held: once downstream holds MAX_LEASES frames of this stream, wait for
+// one to be returned, like a buffer pool. Returns NULL when flushing.
+static GstBuffer *wrap_lease_m2s(GstM2smultivideosrc *p_m2smultivideosrc, GstM2smultivideosrcPad *pad, uint32_t gst_size)
+{
+	GstM2smultivideosrcLease *p_lease = pad->p_lease;
+	bool flushing;
+	bool full;
+
+	do
+	{
+		GST_OBJECT_LOCK (p_m2smultivideosrc);
+		flushing = p_m2smultivideosrc->flushing;
+		GST_OBJECT_UNLOCK (p_m2smultivideosrc);
+		if (flushing)
+		{
+			return NULL;
+		}
+
+		// the object lock is never taken under lease_lock
+		g_mutex_lock(&pad->lease_lock);
+		full = (held_leases_locked_m2s(pad) >= MAX_LEASES);
+		if (full)
+		{
+			g_cond_wait_until(&pad->lease_cond, &pad->lease_lock,
+			                  g_get_monotonic_time() + LEASE_WAIT_INTERVAL_MS * G_TIME_SPAN_MILLISECOND);
+		}
+		g_mutex_unlock(&pad->lease_lock);
+	} while (full);
+
+	g_atomic_int_inc(&p_lease->ref_count);
+	return gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, p_lease->p_frame, gst_size,
+	                                   0, gst_size, p_lease, (GDestroyNotify)release_lease_m2s);
+}
+
+// Clock callback of wait_frame_m2s(): the frame did not come in time, so wake
+// the streaming thread by disabling select on the stream it waits on.
+static gboolean select_timeout_m2s(GstClock *p_clock, GstClockTime time, GstClockID id, gpointer user_data)
+{
+	GstM2smultivideosrc *p_m2smultivideosrc = GST_M2SMULTIVIDEOSRC (user_data);
+
+	GST_OBJECT_LOCK (p_m2smultivideosrc);
+	if ((p_m2smultivideosrc->p_select_pad != NULL) && (p_m2smultivideosrc->select_clock_id == id))
+	{
+		p_m2smultivideosrc->select_timed_out = true;
+		m2s_enable_select(p_m2smultivideosrc->p_select_pad->strm_id, false);
+	}
+	GST_OBJECT_UNLOCK (p_m2smultivideosrc);
+
+	return TRUE;
+}
+
+// Sleep in m2s_read_select() until the stream has a frame. m2s has no timeout
+// for it, so a clock callback at deadline_tai disables select to wake the
+// thread, like a state change does. Returns true if a frame is ready.
+static bool wait_frame_m2s(GstM2smultivideosrc *p_m2smultivideosrc, GstM2smultivideosrcPad *pad, uint64_t deadline_tai)
+{
+	m2s_media_size_t read_size;
+	m2s_media_size_t max_read_size;
+	GstClock *p_clock;
+	GstClockID clock_id;
+	int32_t m2s_ret;
+	bool timed_out;
+
+	p_clock = gst_m2s_clock_obtain();
+	clock_id = gst_clock_new_single_shot_id(p_clock, deadline_tai);
+	gst_object_unref(p_clock);
+
+	GST_OBJECT_LOCK (p_m2smultivideosrc);
+	if (p_m2smultivideosrc->flushing)
+	{
+		GST_OBJECT_UNLOCK (p_m2smultivideosrc);
+		gst_clock_id_unref(clock_id);
+		return false;
+	}
+	p_m2smultivideosrc->p_select_pad = pad;
+	p_m2smultivideosrc->select_clock_id = clock_id;
+	p_m2smultivideosrc->select_timed_out = false;
+	GST_OBJECT_UNLOCK (p_m2smultivideosrc);
+
+	gst_clock_id_wait_async(clock_id, select_timeout_m2s, p_m2smultivideosrc, NULL);
+
+	max_read_size.video.frame_size = (uint32_t)GST_VIDEO_INFO_SIZE(&p_m2smultivideosrc->info);
+	m2s_ret = m2s_read_select(pad->strm_id, &read_size, &max_read_size, nullptr);
+
+	gst_clock_id_unschedule(clock_id);
+
+	GST_OBJECT_LOCK (p_m2smultivideosrc);
+	p_m2smultivideosrc->p_select_pad = NULL;
+	p_m2smultivideosrc->select_clock_id = NULL;
+	timed_out = p_m2smultivideosrc->select_timed_out;
+	if (timed_out && !p_m2smultivideosrc->flushing)
+	{
+		m2s_enable_select(pad->strm_id, true);
+	}
+	GST_OBJECT_UNLOCK (p_m2smultivideosrc);
+	gst_clock_id_unref(clock_id);
+
+	return (m2s_ret == M2S_RET_SUCCESS) && !timed_out;
+}
+
+// Wake the streaming thread from m2s_read_select() and keep it from waiting
+// again, or let it wait again after a flush.
+static void set_flushing_m2s(GstM2smultivideosrc *p_m2smultivideosrc, bool flushing)
+{
+	guint i;
+
+	GST_OBJECT_LOCK (p_m2smultivideosrc);
+	p_m2smultivideosrc->flushing = flushing;
+	for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+	{
+		m2s_enable_select(p_m2smultivideosrc->p_pads[i]->strm_id, !flushing);
+	}
+	GST_OBJECT_UNLOCK (p_m2smultivideosrc);
+
+	// also wake a wait for downstream to return a frame
+	for (i = 0; flushing && (i < p_m2smultivideosrc->num_streams); i++)
+	{
+		g_mutex_lock(&p_m2smultivideosrc->p_pads[i]->lease_lock);
+		g_cond_broadcast(&p_m2smultivideosrc->p_pads[i]->lease_cond);
+		g_mutex_unlock(&p_m2smultivideosrc->p_pads[i]->lease_lock);
+	}
+}
+
+// Running time of the pipeline clock at the given TAI time
+static GstClockTime tai_running_time_m2s(GstM2smultivideosrc *p_m2smultivideosrc, uint64_t tai)
+{
+	GstElement *p_element = GST_ELEMENT (p_m2smultivideosrc);
+	GstClock *p_clock;
+	GstClockTime now;
+	GstClockTimeDiff running_time;
+	uint64_t now_tai;
+
+	p_clock = gst_element_get_clock(p_element);
+	if (p_clock == NULL)
+	{
+		return GST_CLOCK_TIME_NONE;
+	}
+	now = gst_clock_get_time(p_clock);
+	now_tai = m2s_get_current_tai_ns();
+	gst_object_unref(p_clock);
+
+	running_time = GST_CLOCK_DIFF (gst_element_get_base_time(p_element), now) - (GstClockTimeDiff)(now_tai - tai);
+
+	return (running_time < 0) ? 0 : (GstClockTime)running_time;
+}
+
+// Push the held frames as one set, all with the same timestamp,
+// and a GAP event on the pads whose frame did not arrive in time.
+static GstFlowReturn push_set_m2s(GstM2smultivideosrc *p_m2smultivideosrc, uint64_t capture_tai)
+{
+	GstClockTime pts = tai_running_time_m2s(p_m2smultivideosrc, capture_tai);
+	GstClockTime duration = gst_util_uint64_scale (GST_SECOND, p_m2smultivideosrc->info.fps_d, p_m2smultivideosrc->info.fps_n);
+	uint32_t gst_size = (uint32_t)GST_VIDEO_INFO_SIZE(&p_m2smultivideosrc->info);
+	GstM2smultivideosrcPad *pad;
+	GstBuffer *p_buffer;
+	GstFlowReturn ret = GST_FLOW_OK;
+	GstFlowReturn pad_ret;
+	guint i;
+
+	for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+	{
+		pad = p_m2smultivideosrc->p_pads[i];
+
+		if ((pad->p_lease != nullptr) && (pad->p_lease->frame_size == gst_size))
+		{
+			p_buffer = wrap_lease_m2s (p_m2smultivideosrc, pad, gst_size);
+			free_frame_m2s (pad);
+
+			if (p_buffer == NULL)
+			{
+				pad_ret = GST_FLOW_FLUSHING;
+			}
+			else
+			{
+				GST_BUFFER_PTS (p_buffer) = pts;
+				GST_BUFFER_DURATION (p_buffer) = duration;
+				pad_ret = gst_pad_push (GST_PAD (pad), p_buffer);
+			}
+		}
+		else
+		{
+			free_frame_m2s (pad);
+			gst_pad_push_event (GST_PAD (pad), gst_event_new_gap (pts, duration));
+			pad_ret = GST_FLOW_OK;
+		}
+
+		ret = gst_flow_combiner_update_pad_flow (p_m2smultivideosrc->p_flow_combiner, GST_PAD (pad), pad_ret);
+	}
+
+	p_m2smultivideosrc->sets++;
+	return ret;
+}
+
+// One streaming thread for all streams: collect one frame per stream, drop
+// frames that are older than the newest one held, and push the set once every
+// stream has a frame with the same RTP timestamp or sync-timeout-ms passed.
+// In between the thread sleeps in m2s_read_select() on a stream without a frame.
+// A stream that misses the timeout is not waited on again until it delivers,
+// so one dead stream does not hold every set back and let the others' FIFOs grow.
+static void
+gst_m2smultivideosrc_loop (GstM2smultivideosrc * p_m2smultivideosrc)
+{
+	GstClockTime duration = gst_util_uint64_scale (GST_SECOND, p_m2smultivideosrc->info.fps_d, p_m2smultivideosrc->info.fps_n);
+	GstM2smultivideosrcPad *pad;
+	GstM2smultivideosrcPad *p_newest = NULL;
+	GstM2smultivideosrcPad *p_missing = NULL;
+	uint64_t now_tai;
+	uint64_t deadline_tai;
+	GstFlowReturn ret;
+	guint i;
+
+	for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+	{
+		pad = p_m2smultivideosrc->p_pads[i];
+		if (pad->p_lease == nullptr)
+		{
+			read_frame_m2s (pad);
+		}
+		else
+		{
+			reclaim_leases_m2s (pad);
+		}
+		if ((pad->p_lease != nullptr) && pad->timed_out)
+		{
+			GST_INFO_OBJECT (pad, "stream delivers again");
+			pad->timed_out = false;
+		}
+		if ((pad->p_lease != nullptr) &&
+			((p_newest == NULL) || ((int32_t)(pad->p_lease->rtp_timestamp - p_newest->p_lease->rtp_timestamp) > 0)))
+		{
+			p_newest = pad;
+		}
+	}
+
+	if (p_newest == NULL)
+	{
+		// no stream has a frame; after a frame time without one another stream
+		// is waited on, in case this one stopped
+		pad = p_m2smultivideosrc->p_pads[p_m2smultivideosrc->select_index % p_m2smultivideosrc->num_streams];
+		if (!wait_frame_m2s (p_m2smultivideosrc, pad, m2s_get_current_tai_ns() + duration))
+		{
+			p_m2smultivideosrc->select_index++;
+		}
+		return;
+	}
+
+	// a frame older than the newest one can never be part of a complete set
+	for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+	{
+		pad = p_m2smultivideosrc->p_pads[i];
+		if ((pad->p_lease != nullptr) && (pad->p_lease->rtp_timestamp != p_newest->p_lease->rtp_timestamp))
+		{
+			free_frame_m2s (pad);
+			pad->dropped++;
+		}
+		if ((pad->p_lease == nullptr) && !pad->timed_out && (p_missing == NULL))
+		{
+			p_missing = pad;
+		}
+	}
+
+	if (p_missing != NULL)
+	{
+		now_tai = m2s_get_current_tai_ns();
+		if (p_m2smultivideosrc->wait_start_tai == 0)
+		{
+			p_m2smultivideosrc->wait_start_tai = now_tai;
+		}
+		deadline_tai = p_m2smultivideosrc->wait_start_tai + (uint64_t)p_m2smultivideosrc->sync_timeout_ms * GST_MSECOND;
+		if (now_tai < deadline_tai)
+		{
+			wait_frame_m2s (p_m2smultivideosrc, p_missing, deadline_tai);
+			return;
+		}
+		for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+		{
+			pad = p_m2smultivideosrc->p_pads[i];
+			if (pad->p_lease == nullptr)
+			{
+				GST_INFO_OBJECT (pad, "no frame within sync-timeout-ms, not waiting on the stream");
+				pad->timed_out = true;
+			}
+		}
+	}
+	for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+	{
+		if (p_m2smultivideosrc->p_pads[i]->p_lease == nullptr)
+		{
+			p_m2smultivideosrc->incomplete_sets++;
+			GST_LOG_OBJECT (p_m2smultivideosrc, "pushing incomplete set for RTP timestamp %u", p_newest->p_lease->rtp_timestamp);
+			break;
+		}
+	}
+	p_m2smultivideosrc->wait_start_tai = 0;
+
+	ret = push_set_m2s (p_m2smultivideosrc, p_newest->p_lease->capture_tai);
+	if (G_UNLIKELY (ret != GST_FLOW_OK))
+	{
+		GST_DEBUG_OBJECT (p_m2smultivideosrc, "pausing task, reason %s", gst_flow_get_name (ret));
+		gst_task_pause (p_m2smultivideosrc->p_task);
+
+		if ((ret == GST_FLOW_NOT_LINKED) || (ret < GST_FLOW_EOS))
+		{
+			GST_ELEMENT_FLOW_ERROR (p_m2smultivideosrc, ret);
+			for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+			{
+				gst_pad_push_event (GST_PAD (p_m2smultivideosrc->p_pads[i]), gst_event_new_eos ());
+			}
+		}
+	}
+}
+
+static GstStateChangeReturn
+gst_m2smultivideosrc_change_state (GstElement * element, GstStateChange transition)
+{
+	GstM2smultivideosrc *p_m2smultivideosrc = GST_M2SMULTIVIDEOSRC (element);
+	GstStateChangeReturn ret;
+	guint i;
+
+	switch (transition)
+	{
+	case GST_STATE_CHANGE_NULL_TO_READY:
+	{
+		if (p_m2smultivideosrc->num_streams == 0)
+		{
+			GST_ELEMENT_ERROR (p_m2smultivideosrc, RESOURCE, SETTINGS, (NULL), ("num-streams is 0"));
+			return GST_STATE_CHANGE_FAILURE;
+		}
+
+		m2s_open_conf_t open_conf;
+		open_conf.cuda_dev_num = p_m2smultivideosrc->gpu_num;
+		open_conf.p_ipx_license_file = p_m2smultivideosrc->ipx_license;
+		m2s_open(&open_conf);
+
+		m2s_cpu_affinity_t cpu_affinity;
+		cpu_affinity.rx.l2_num = p_m2smultivideosrc->l2_cpu_num;
+		cpu_affinity.rx.l1_num = p_m2smultivideosrc->l1_cpu_num;
+		for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+		{
+			m2s_create(&p_m2smultivideosrc->p_pads[i]->strm_id, M2S_IO_TYPE_RX, M2S_MEDIA_TYPE_VIDEO, M2S_MEMORY_MODE_CPU,
+			           &cpu_affinity, NULL, p_m2smultivideosrc->hw_hitless);
+			p_m2smultivideosrc->p_pads[i]->p_lease = nullptr;
+		}
+		p_m2smultivideosrc->m2s_created = true;
+		break;
+	}
+
+	case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+		if (!p_m2smultivideosrc->m2s_started)
+		{
+			for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+			{
+				m2s_start(p_m2smultivideosrc->p_pads[i]->strm_id);
+			}
+			p_m2smultivideosrc->m2s_started = true;
+		}
+		set_flushing_m2s (p_m2smultivideosrc, false);
+		p_m2smultivideosrc->wait_start_tai = 0;
+		for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+		{
+			p_m2smultivideosrc->p_pads[i]->timed_out = false;
+		}
+		gst_task_start (p_m2smultivideosrc->p_task);
+		break;
+
+	case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+		// the thread may be blocked downstream, so it is only stopped once
+		// the pads are deactivated in PAUSED_TO_READY
+		set_flushing_m2s (p_m2smultivideosrc, true);
+		gst_task_pause (p_m2smultivideosrc->p_task);
+		break;
+
+	default:
+		break;
+	}
+
+	ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+	if (ret == GST_STATE_CHANGE_FAILURE)
+	{
+		return ret;
+	}
+
+	switch (transition)
+	{
+	case GST_STATE_CHANGE_READY_TO_PAUSED:
+		gst_flow_combiner_reset (p_m2smultivideosrc->p_flow_combiner);
+		p_m2smultivideosrc->sets = 0;
+		p_m2smultivideosrc->incomplete_sets = 0;
+		if (!negotiate_m2s (p_m2smultivideosrc))
+		{
+			return GST_STATE_CHANGE_FAILURE;
+		}
+		// live source, no preroll
+		ret = GST_STATE_CHANGE_NO_PREROLL;
+		break;
+
+	case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+		ret = GST_STATE_CHANGE_NO_PREROLL;
+		break;
+
+	case GST_STATE_CHANGE_PAUSED_TO_READY:
+		set_flushing_m2s (p_m2smultivideosrc, true);
+		gst_task_stop (p_m2smultivideosrc->p_task);
+		gst_task_join (p_m2smultivideosrc->p_task);
+		for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+		{
+			free_frame_m2s (p_m2smultivideosrc->p_pads[i]);
+			reclaim_leases_m2s (p_m2smultivideosrc->p_pads[i]);
+			if (p_m2smultivideosrc->m2s_started)
+			{
+				m2s_stop (p_m2smultivideosrc->p_pads[i]->strm_id);
+			}
+		}
+		p_m2smultivideosrc->m2s_started = false;
+		break;
+
+	case GST_STATE_CHANGE_READY_TO_NULL:
+		if (p_m2smultivideosrc->m2s_created)
+		{
+			for (i = 0; i < p_m2smultivideosrc->num_streams; i++)
+			{
+				if (!orphan_leases_m2s (p_m2smultivideosrc->p_pads[i]))
+				{
+					m2s_delete (p_m2smultivideosrc->p_pads[i]->strm_id);
+				}
+			}
+			p_m2smultivideosrc->m2s_created = false;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return ret;
+}
+
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+	GST_DEBUG_CATEGORY_INIT (m2smultivideosrc_debug, "m2smultivideosrc", 0,
+	                         "M2S multi video source");
+
+	return gst_element_register (plugin, "m2smultivideosrc",
+	                             GST_RANK_NONE, GST_TYPE_M2SMULTIVIDEOSRC);
+}
+
+#ifndef VERSION
+#define VERSION "2.12.1"
+#endif
+#ifndef PACKAGE
+#define PACKAGE "FIXME_package"
+#endif
+#ifndef GST_PACKAGE_NAME
+#define GST_PACKAGE_NAME "FIXME_package_name"
+#endif
+#ifndef GST_PACKAGE_ORIGIN
+#define GST_PACKAGE_ORIGIN "http://FIXME.org/"
+#endif
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+                   GST_VERSION_MINOR,
+                   m2smultivideosrc,
+                   "FIXME plugin description",
+                   plugin_init, VERSION, GST_LICENSE_UNKNOWN, GST_PACKAGE_NAME, GST_PACKAGE_ORIGIN)
@@ -0,0 +1,119 @@
+//==============================================================================
+// Copyright (C) 2023 Macnica Inc. All Rights Reserved.
+//
+// Use in source and binary forms, with or without modification, are permitted
+// provided by agreeing to the following terms and conditions:
+//
+// REDISTRIBUTIONS OR SUBLICENSING IN SOURCE AND BINARY FORM ARE NOT ALLOWED.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//------------------------------------------------------------------------------
+//! @file
+//! @brief
+//==============================================================================
+#ifndef __GST_M2SMULTIVIDEOSRC_H__
+#define __GST_M2SMULTIVIDEOSRC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstflowcombiner.h>
+#include <gst/video/video.h>
+#include <m2s_api.h>
+
+G_BEGIN_DECLS
+
+#define M2SMULTIVIDEOSRC_MAX_STREAMS (16)
+
+#define GST_TYPE_M2SMULTIVIDEOSRC (gst_m2smultivideosrc_get_type())
+G_DECLARE_FINAL_TYPE (GstM2smultivideosrc, gst_m2smultivideosrc, GST, M2SMULTIVIDEOSRC,
+                      GstElement)
+
+#define GST_TYPE_M2SMULTIVIDEOSRC_PAD (gst_m2smultivideosrc_pad_get_type())
+G_DECLARE_FINAL_TYPE (GstM2smultivideosrcPad, gst_m2smultivideosrc_pad, GST, M2SMULTIVIDEOSRC_PAD,
+                      GstPad)
+
+typedef struct _GstM2smultivideosrcLease GstM2smultivideosrcLease;
+
+/**
+ * GstM2smultivideosrcPad:
+ *
+ * One RX stream, with its network settings as pad properties.
+ */
+struct _GstM2smultivideosrcPad {
+	GstPad pad;
+
+	/*< private >*/
+	char if_ip[2][32];
+	char dst_ip[2][32];
+	char src_ip[2][32];
+	uint16_t dst_port[2];
+	uint16_t src_port[2];
+	uint8_t payload_type;
+
+	/* stream state, only touched by the streaming thread */
+	m2s_strm_id_t strm_id;
+	GstM2smultivideosrcLease *p_lease;    /* frame currently held from m2s */
+	bool timed_out;                       /* not waited on until it delivers again */
+	guint64 dropped;
+
+	/* outstanding m2s read pointers, oldest first */
+	GMutex lease_lock;
+	GCond lease_cond;                     /* a lease was released */
+	GQueue leases;
+};
+
+/**
+ * GstM2smultivideosrc:
+ *
+ * Opaque data structure.
+ */
+struct _GstM2smultivideosrc {
+	GstElement element;
+
+	/*< private >*/
+	guint num_streams;
+	GstM2smultivideosrcPad *p_pads[M2SMULTIVIDEOSRC_MAX_STREAMS];
+
+	bool hw_hitless;
+	uint8_t gpu_num;
+	int32_t l2_cpu_num;
+	int32_t l1_cpu_num;
+	int32_t playout_delay_ms;
+	uint8_t scan;
+	m2s_video_rtp_format_t rtp_format;
+	char ipx_license[128];
+	uint32_t sync_timeout_ms;
+
+	GstVideoInfo info;
+	m2s_frame_rate_t m2s_frame_rate;
+	bool m2s_created;
+	bool m2s_started;
+
+	/* one streaming thread for all pads */
+	GstTask *p_task;
+	GRecMutex task_lock;
+	GstFlowCombiner *p_flow_combiner;
+
+	/* m2s_read_select() of the streaming thread, protected by the object lock */
+	bool flushing;
+	GstM2smultivideosrcPad *p_select_pad;
+	GstClockID select_clock_id;
+	bool select_timed_out;
+	guint select_index;                   /* stream waited on while none has a frame */
+
+	uint64_t wait_start_tai;              /* first frame of an incomplete set, 0 when none */
+	guint64 sets;
+	guint64 incomplete_sets;
+};
+
+G_END_DECLS
+
+#endif /* __GST_M2SMULTIVIDEOSRC_H__ */
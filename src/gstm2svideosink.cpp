@@ -28,6 +28,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
 #include <string>
 #include <chrono>
 #include <thread>
@@ -38,6 +40,7 @@
 #include <gst/video/gstvideosink.h>
 #include <m2s_api.h>
 #include <tr_offset.h>
+#include <gstm2sclock.h>
 #include "gstm2svideosink.h"
 
 #define DBG_MSG(format, args...) printf("[m2svideosink] " format, ## args)
@@ -65,6 +68,19 @@ GST_DEBUG_CATEGORY_STATIC (gst_m2svideosink_debug_category);
 #define DEFAULT_BOX_SIZE                 (60)
 #define DEFAULT_GPUDIRECT                (FALSE)
 #define DEFAULT_TX_DELAY_MS              (500)
+#define DEFAULT_HUGEPAGE_POOL            (TRUE)
+#define DEFAULT_ASYNC_TX                 (FALSE)
+#define DEFAULT_TX_RING_DEPTH            (4)
+#define DEFAULT_TX_OVERFLOW_POLICY       GST_M2SVIDEOSINK_TX_OVERFLOW_BLOCK
+#define DEFAULT_TX_SCHEDULE              GST_M2SVIDEOSINK_TX_SCHEDULE_COUNTER
+#define DEFAULT_DROP_LATE                (FALSE)
+#define DEFAULT_MIN_LEAD_US              (1000)
+#define DEFAULT_KEEPALIVE                GST_M2SVIDEOSINK_KEEPALIVE_OFF
+#define DEFAULT_PREROLL_FRAMES           (0)
+
+#define HUGEPAGE_SIZE                    (2 * 1024 * 1024)
+#define HUGEPAGE_POOL_ALIGN              (64)
+#define HUGEPAGE_POOL_MIN_BUFFERS        (3)
 
 #define GST_TYPE_M2S_VIDEO_SINK_RTP_FORMAT (gst_m2s_video_sink_rtp_format_get_type ())
 static GType gst_m2s_video_sink_rtp_format_get_type (void)
@@ -83,6 +99,52 @@ static GType gst_m2s_video_sink_rtp_format_get_type (void)
 	return m2s_video_sink_rtp_format;
 }
 
+#define GST_TYPE_M2S_VIDEO_SINK_TX_OVERFLOW_POLICY (gst_m2s_video_sink_tx_overflow_policy_get_type ())
+static GType gst_m2s_video_sink_tx_overflow_policy_get_type (void)
+{
+	static GType m2s_video_sink_tx_overflow_policy = 0;
+	if (!m2s_video_sink_tx_overflow_policy) {
+		static const GEnumValue policies[] = {
+			{GST_M2SVIDEOSINK_TX_OVERFLOW_BLOCK, "Block upstream until a slot is free", "block"},
+			{GST_M2SVIDEOSINK_TX_OVERFLOW_DROP, "Drop the incoming frame", "drop"},
+			{0, NULL, NULL},
+		};
+		m2s_video_sink_tx_overflow_policy = g_enum_register_static ("GstM2sVideoSinkTxOverflowPolicy", policies);
+	}
+	return m2s_video_sink_tx_overflow_policy;
+}
+
+#define GST_TYPE_M2S_VIDEO_SINK_KEEPALIVE (gst_m2s_video_sink_keepalive_get_type ())
+static GType gst_m2s_video_sink_keepalive_get_type (void)
+{
+	static GType m2s_video_sink_keepalive = 0;
+	if (!m2s_video_sink_keepalive) {
+		static const GEnumValue keepalives[] = {
+			{GST_M2SVIDEOSINK_KEEPALIVE_OFF, "Send nothing while upstream stalls", "off"},
+			{GST_M2SVIDEOSINK_KEEPALIVE_LAST, "Repeat the last frame, black before the first one", "last"},
+			{GST_M2SVIDEOSINK_KEEPALIVE_SLATE, "Send a black slate", "slate"},
+			{0, NULL, NULL},
+		};
+		m2s_video_sink_keepalive = g_enum_register_static ("GstM2sVideoSinkKeepalive", keepalives);
+	}
+	return m2s_video_sink_keepalive;
+}
+
+#define GST_TYPE_M2S_VIDEO_SINK_TX_SCHEDULE (gst_m2s_video_sink_tx_schedule_get_type ())
+static GType gst_m2s_video_sink_tx_schedule_get_type (void)
+{
+	static GType m2s_video_sink_tx_schedule = 0;
+	if (!m2s_video_sink_tx_schedule) {
+		static const GEnumValue schedules[] = {
+			{GST_M2SVIDEOSINK_TX_SCHEDULE_COUNTER, "Consecutive alignment points from the first frame", "counter"},
+			{GST_M2SVIDEOSINK_TX_SCHEDULE_PTS, "Alignment point of the buffer running time", "pts"},
+			{0, NULL, NULL},
+		};
+		m2s_video_sink_tx_schedule = g_enum_register_static ("GstM2sVideoSinkTxSchedule", schedules);
+	}
+	return m2s_video_sink_tx_schedule;
+}
+
 /* prototypes */
 
 static void gst_m2svideosink_set_gpu_num (GstM2svideosink *m2svideosink, uint8_t gpu_num);
@@ -105,6 +167,15 @@ static void gst_m2svideosink_set_box_mode (GstM2svideosink *m2svideosink, bool b
 static void gst_m2svideosink_set_box_size (GstM2svideosink *m2svideosink, uint8_t box_size);
 static void gst_m2svideosink_set_gpudirect (GstM2svideosink *m2svideosink, bool gpudirect);
 static void gst_m2svideosink_set_tx_delay_ms (GstM2svideosink *m2svideosink, int32_t tx_delay_ms);
+static void gst_m2svideosink_set_hugepage_pool (GstM2svideosink *m2svideosink, bool hugepage_pool);
+static void gst_m2svideosink_set_async_tx (GstM2svideosink *m2svideosink, bool async_tx);
+static void gst_m2svideosink_set_tx_ring_depth (GstM2svideosink *m2svideosink, uint32_t depth);
+static void gst_m2svideosink_set_tx_overflow_policy (GstM2svideosink *m2svideosink, GstM2svideosinkTxOverflowPolicy policy);
+static void gst_m2svideosink_set_tx_schedule (GstM2svideosink *m2svideosink, GstM2svideosinkTxSchedule schedule);
+static void gst_m2svideosink_set_drop_late (GstM2svideosink *m2svideosink, bool drop_late);
+static void gst_m2svideosink_set_min_lead_us (GstM2svideosink *m2svideosink, uint32_t min_lead_us);
+static void gst_m2svideosink_set_keepalive (GstM2svideosink *m2svideosink, GstM2svideosinkKeepalive keepalive);
+static void gst_m2svideosink_set_preroll_frames (GstM2svideosink *m2svideosink, uint32_t preroll_frames);
 static void gst_m2svideosink_set_property (GObject * object,
                                            guint property_id, const GValue * value, GParamSpec * pspec);
 static void gst_m2svideosink_get_property (GObject * object,
@@ -113,8 +184,20 @@ static void gst_m2svideosink_dispose (GObject * object);
 static void gst_m2svideosink_finalize (GObject * object);
 
 static GstStateChangeReturn gst_m2svideosink_change_state (GstElement * element, GstStateChange transition);
+static GstClock *gst_m2svideosink_provide_clock (GstElement * element);
 
 static gboolean gst_m2svideosink_set_caps (GstBaseSink * bsink, GstCaps * caps);
+static gboolean gst_m2svideosink_propose_allocation (GstBaseSink * bsink, GstQuery * query);
+static gboolean gst_m2svideosink_unlock (GstBaseSink * bsink);
+static gboolean gst_m2svideosink_unlock_stop (GstBaseSink * bsink);
+static gboolean gst_m2svideosink_event (GstBaseSink * bsink, GstEvent * event);
+static GstFlowReturn gst_m2svideosink_preroll (GstBaseSink * bsink, GstBuffer * buf);
+static GstFlowReturn render_frame_m2s (GstM2svideosink *p_m2svideosink, GstBuffer *buf);
+static GstBuffer *create_slate_m2s (GstVideoInfo *p_info);
+static void start_keepalive_thread(GstM2svideosink *p_m2svideosink);
+static void stop_keepalive_thread(GstM2svideosink *p_m2svideosink);
+static GstFlowReturn flush_preroll_m2s (GstM2svideosink *p_m2svideosink);
+static void clear_preroll_m2s (GstM2svideosink *p_m2svideosink);
 
 static GstFlowReturn gst_m2svideosink_show_frame (GstVideoSink * video_sink,
                                                   GstBuffer * buf);
@@ -142,14 +225,28 @@ enum
 	PROP_BOX_SIZE,
 	PROP_GPUDIRECT,
 	PROP_TX_DELAY_MS,
+	PROP_HUGEPAGE_POOL,
+	PROP_ASYNC_TX,
+	PROP_TX_RING_DEPTH,
+	PROP_TX_OVERFLOW_POLICY,
+	PROP_TX_DROPPED,
+	PROP_TX_SCHEDULE,
+	PROP_SCHEDULE_DROPPED,
+	PROP_DROP_LATE,
+	PROP_MIN_LEAD_US,
+	PROP_LATE_DROPPED,
+	PROP_KEEPALIVE,
+	PROP_KEEPALIVE_INSERTED,
+	PROP_PREROLL_FRAMES,
 };
 
-static int32_t g_start_time_offset_ns = 0;
 /* pad templates */
 
 /* FIXME: add/remove formats you can handle */
 #define VIDEO_SINK_CAPS \
-	GST_VIDEO_CAPS_MAKE("{ UYVP, UYVY, I420, v210, BGRx }")
+	GST_VIDEO_CAPS_MAKE("{ UYVP, UYVY, I420, v210, BGRx }") "; " \
+	GST_VIDEO_CAPS_MAKE_WITH_FEATURES(GST_CAPS_FEATURE_FORMAT_INTERLACED, "{ UYVP, UYVY, I420, v210, BGRx }") ", " \
+	"interlace-mode = (string) alternate"
 
 
 /* class initialization */
@@ -158,6 +255,125 @@ G_DEFINE_TYPE_WITH_CODE (GstM2svideosink, gst_m2svideosink, GST_TYPE_VIDEO_SINK,
                          GST_DEBUG_CATEGORY_INIT (gst_m2svideosink_debug_category, "m2svideosink", 0,
                                                   "debug category for m2svideosink element"));
 
+// Frame memory for the TX path: 2MB pages, populated and locked up front so
+// that the copy into the m2s FIFO in m2s_write() takes neither page faults nor
+// many TLB misses. Without reserved hugepages the kernel is asked for
+// transparent ones instead.
+typedef struct
+{
+	GstMemory mem;
+	uint8_t *p_data;
+	gsize map_size;                       /* 0 for a share of another memory */
+} GstM2sHugepageMemory;
+
+typedef struct
+{
+	GstAllocator parent;
+} GstM2sHugepageAllocator;
+
+typedef struct
+{
+	GstAllocatorClass parent_class;
+} GstM2sHugepageAllocatorClass;
+
+G_DEFINE_TYPE (GstM2sHugepageAllocator, gst_m2s_hugepage_allocator, GST_TYPE_ALLOCATOR);
+
+static GstMemory *hugepage_alloc_m2s (GstAllocator *p_allocator, gsize size, GstAllocationParams *p_params)
+{
+	GstM2sHugepageMemory *p_mem;
+	/* the data after the prefix starts at least on HUGEPAGE_POOL_ALIGN */
+	gsize align = p_params->align | (HUGEPAGE_POOL_ALIGN - 1);
+	gsize pad = (align + 1 - (p_params->prefix & align)) & align;
+	gsize maxsize = size + p_params->prefix + pad + p_params->padding;
+	gsize map_size = (maxsize + HUGEPAGE_SIZE - 1) & ~((gsize)HUGEPAGE_SIZE - 1);
+	void *p_data;
+
+	/* mmap() is page aligned, so only the prefix can move the data off */
+	p_data = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE | MAP_HUGETLB, -1, 0);
+	if (p_data == MAP_FAILED)
+	{
+		p_data = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p_data == MAP_FAILED)
+		{
+			return NULL;
+		}
+		madvise(p_data, map_size, MADV_HUGEPAGE);
+	}
+	if (mlock(p_data, map_size) != 0)
+	{
+		GST_DEBUG ("mlock of %" G_GSIZE_FORMAT " bytes failed: %s", map_size, g_strerror(errno));
+	}
+
+	p_mem = g_new(GstM2sHugepageMemory, 1);
+	gst_memory_init(GST_MEMORY_CAST(p_mem), p_params->flags, p_allocator, NULL,
+	                maxsize, align, p_params->prefix + pad, size);
+	p_mem->p_data = (uint8_t *)p_data;
+	p_mem->map_size = map_size;
+
+	return GST_MEMORY_CAST(p_mem);
+}
+
+static void hugepage_free_m2s (GstAllocator *p_allocator, GstMemory *p_memory)
+{
+	GstM2sHugepageMemory *p_mem = (GstM2sHugepageMemory *)p_memory;
+
+	if (p_mem->map_size > 0)
+	{
+		munmap(p_mem->p_data, p_mem->map_size);
+	}
+	g_free(p_mem);
+}
+
+static gpointer hugepage_map_m2s (GstMemory *p_memory, gsize maxsize, GstMapFlags flags)
+{
+	return ((GstM2sHugepageMemory *)p_memory)->p_data;
+}
+
+static void hugepage_unmap_m2s (GstMemory *p_memory)
+{
+}
+
+static GstMemory *hugepage_share_m2s (GstMemory *p_memory, gssize offset, gssize size)
+{
+	GstM2sHugepageMemory *p_sub;
+	GstMemory *p_parent = (p_memory->parent != NULL) ? p_memory->parent : p_memory;
+
+	if (size == -1)
+	{
+		size = p_memory->size - offset;
+	}
+
+	p_sub = g_new(GstM2sHugepageMemory, 1);
+	gst_memory_init(GST_MEMORY_CAST(p_sub),
+	                (GstMemoryFlags)(GST_MINI_OBJECT_FLAGS(p_parent) | GST_MINI_OBJECT_FLAG_LOCK_READONLY),
+	                p_memory->allocator, p_parent, p_memory->maxsize, p_memory->align,
+	                p_memory->offset + offset, size);
+	p_sub->p_data = ((GstM2sHugepageMemory *)p_memory)->p_data;
+	p_sub->map_size = 0;
+
+	return GST_MEMORY_CAST(p_sub);
+}
+
+static void gst_m2s_hugepage_allocator_class_init (GstM2sHugepageAllocatorClass *klass)
+{
+	GstAllocatorClass *allocator_class = GST_ALLOCATOR_CLASS (klass);
+
+	allocator_class->alloc = hugepage_alloc_m2s;
+	allocator_class->free = hugepage_free_m2s;
+}
+
+static void gst_m2s_hugepage_allocator_init (GstM2sHugepageAllocator *p_allocator)
+{
+	GstAllocator *p_alloc = GST_ALLOCATOR_CAST (p_allocator);
+
+	p_alloc->mem_type = "M2sHugepageMemory";
+	p_alloc->mem_map = hugepage_map_m2s;
+	p_alloc->mem_unmap = hugepage_unmap_m2s;
+	p_alloc->mem_share = hugepage_share_m2s;
+
+	GST_OBJECT_FLAG_SET (p_allocator, GST_ALLOCATOR_FLAG_CUSTOM_ALLOC);
+}
+
 static void monitoring_thread_main(GstM2svideosink *p_m2svideosink)
 {
 	m2s_status_t status;
@@ -215,6 +431,213 @@ static void stop_monitoring_timer(GstM2svideosink *p_m2svideosink)
 	delete p_m2svideosink->p_mon_thread;
 }
 
+// Asynchronous TX: show_frame only queues a reference into a ring that the TX
+// thread empties, so m2s_write_select() backpressure and the copy in
+// m2s_write() stay off the upstream streaming thread. The ring has a single
+// producer (show_frame) and a single consumer (the TX thread), and pushing or
+// popping a frame takes no lock. tx_lock is only taken to sleep, and to wake
+// the other side when the ring was empty or full.
+static void notify_tx_m2s(GstM2svideosink *p_m2svideosink)
+{
+	std::unique_lock<std::mutex> lock(p_m2svideosink->tx_lock);
+	p_m2svideosink->tx_cond.notify_all();
+}
+
+static inline bool tx_ring_empty(GstM2svideosink *p_m2svideosink)
+{
+	return g_atomic_int_get(&p_m2svideosink->tx_tail) == g_atomic_int_get(&p_m2svideosink->tx_head);
+}
+
+static void tx_thread_main(GstM2svideosink *p_m2svideosink)
+{
+	GstBuffer *p_buffer;
+	GstFlowReturn ret;
+	guint tail;
+	guint next;
+	guint head;
+	bool flushing;
+
+	while (1)
+	{
+		{
+			std::unique_lock<std::mutex> lock(p_m2svideosink->tx_lock);
+			p_m2svideosink->tx_busy = false;
+			if (p_m2svideosink->tx_paused)
+			{
+				p_m2svideosink->tx_cond.notify_all();
+			}
+			// while paused m2s is stopped, the frames wait unless flushed
+			p_m2svideosink->tx_cond.wait(lock, [p_m2svideosink] {
+				return !p_m2svideosink->tx_running ||
+					(!tx_ring_empty(p_m2svideosink) && (!p_m2svideosink->tx_paused || p_m2svideosink->tx_flushing));
+			});
+			if (!p_m2svideosink->tx_running)
+			{
+				break;
+			}
+			flushing = p_m2svideosink->tx_flushing;
+			p_m2svideosink->tx_busy = true;
+		}
+
+		tail = g_atomic_int_get(&p_m2svideosink->tx_tail);
+		p_buffer = p_m2svideosink->p_tx_ring[tail];
+		p_m2svideosink->p_tx_ring[tail] = NULL;
+
+		// queued before a flush, dropped unwritten
+		if (!flushing)
+		{
+			ret = render_frame_m2s(p_m2svideosink, p_buffer);
+			if (ret != GST_FLOW_OK)
+			{
+				g_atomic_int_set(&p_m2svideosink->tx_flow_ret, ret);
+			}
+		}
+		gst_buffer_unref(p_buffer);
+
+		next = (tail + 1) % p_m2svideosink->tx_ring_size;
+		g_atomic_int_set(&p_m2svideosink->tx_tail, next);
+		// show_frame may wait for a free slot, a drain for the ring to empty
+		head = g_atomic_int_get(&p_m2svideosink->tx_head);
+		if ((head == next) || ((head + 1) % p_m2svideosink->tx_ring_size == tail))
+		{
+			notify_tx_m2s(p_m2svideosink);
+		}
+	}
+}
+
+static void start_tx_thread(GstM2svideosink *p_m2svideosink)
+{
+	// one slot stays free to tell a full ring from an empty one
+	p_m2svideosink->tx_ring_size = p_m2svideosink->tx_ring_depth + 1;
+	p_m2svideosink->p_tx_ring = g_new0(GstBuffer *, p_m2svideosink->tx_ring_size);
+	g_atomic_int_set(&p_m2svideosink->tx_head, 0);
+	g_atomic_int_set(&p_m2svideosink->tx_tail, 0);
+	g_atomic_int_set(&p_m2svideosink->tx_flow_ret, GST_FLOW_OK);
+	p_m2svideosink->tx_dropped = 0;
+	p_m2svideosink->tx_flushing = false;
+	p_m2svideosink->tx_unlocked = false;
+	// m2s is started in PLAYING, see resume_tx_thread()
+	p_m2svideosink->tx_paused = true;
+	p_m2svideosink->tx_busy = false;
+	p_m2svideosink->tx_running = true;
+	p_m2svideosink->p_tx_thread = new std::thread(&tx_thread_main, p_m2svideosink);
+}
+
+static void stop_tx_thread(GstM2svideosink *p_m2svideosink)
+{
+	guint i;
+
+	if (p_m2svideosink->p_tx_thread == nullptr)
+	{
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(p_m2svideosink->tx_lock);
+		p_m2svideosink->tx_running = false;
+		p_m2svideosink->tx_cond.notify_all();
+	}
+	p_m2svideosink->p_tx_thread->join();
+	delete p_m2svideosink->p_tx_thread;
+	p_m2svideosink->p_tx_thread = nullptr;
+
+	for (i = 0; i < p_m2svideosink->tx_ring_size; i++)
+	{
+		if (p_m2svideosink->p_tx_ring[i] != NULL)
+		{
+			gst_buffer_unref(p_m2svideosink->p_tx_ring[i]);
+		}
+	}
+	g_free(p_m2svideosink->p_tx_ring);
+	p_m2svideosink->p_tx_ring = NULL;
+}
+
+// Before m2s_stop(): the TX thread finishes the frame it is writing and keeps
+// the rest queued. Disabling select releases a write waiting for a slot.
+static void pause_tx_thread(GstM2svideosink *p_m2svideosink)
+{
+	if (p_m2svideosink->p_tx_thread == nullptr)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(p_m2svideosink->tx_lock);
+	p_m2svideosink->tx_paused = true;
+	m2s_enable_select(p_m2svideosink->strm_id, false);
+	p_m2svideosink->tx_cond.wait(lock, [p_m2svideosink] {
+		return !p_m2svideosink->tx_busy;
+	});
+}
+
+// After m2s_start(): the frames queued before the pause go out
+static void resume_tx_thread(GstM2svideosink *p_m2svideosink)
+{
+	if (p_m2svideosink->p_tx_thread == nullptr)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(p_m2svideosink->tx_lock);
+	p_m2svideosink->tx_paused = false;
+	p_m2svideosink->tx_cond.notify_all();
+}
+
+// Producer side, called from show_frame. A write error of the TX thread is
+// returned on the next frame.
+static GstFlowReturn push_tx_m2s(GstM2svideosink *p_m2svideosink, GstBuffer *p_buffer)
+{
+	guint head = g_atomic_int_get(&p_m2svideosink->tx_head);
+	guint next = (head + 1) % p_m2svideosink->tx_ring_size;
+	GstFlowReturn ret = (GstFlowReturn)g_atomic_int_get(&p_m2svideosink->tx_flow_ret);
+
+	if (ret != GST_FLOW_OK)
+	{
+		return ret;
+	}
+
+	if (next == (guint)g_atomic_int_get(&p_m2svideosink->tx_tail))
+	{
+		if (p_m2svideosink->tx_overflow_policy == GST_M2SVIDEOSINK_TX_OVERFLOW_DROP)
+		{
+			p_m2svideosink->tx_dropped++;
+			GST_DEBUG_OBJECT (p_m2svideosink, "TX ring full, dropping frame (%" G_GUINT64_FORMAT " dropped)",
+			                  p_m2svideosink->tx_dropped);
+			return GST_FLOW_OK;
+		}
+
+		std::unique_lock<std::mutex> lock(p_m2svideosink->tx_lock);
+		p_m2svideosink->tx_cond.wait(lock, [p_m2svideosink, next] {
+			return !p_m2svideosink->tx_running || p_m2svideosink->tx_unlocked ||
+				(next != (guint)g_atomic_int_get(&p_m2svideosink->tx_tail));
+		});
+		if (!p_m2svideosink->tx_running || p_m2svideosink->tx_unlocked)
+		{
+			return GST_FLOW_FLUSHING;
+		}
+	}
+
+	p_m2svideosink->p_tx_ring[head] = gst_buffer_ref(p_buffer);
+	g_atomic_int_set(&p_m2svideosink->tx_head, next);
+	// the TX thread sleeps only once it has caught up with the old head
+	if ((guint)g_atomic_int_get(&p_m2svideosink->tx_tail) == head)
+	{
+		notify_tx_m2s(p_m2svideosink);
+	}
+
+	return GST_FLOW_OK;
+}
+
+// Wait until the TX thread has written everything queued, e.g. before the
+// caps change under it or at EOS. unlock() ends the wait, since a paused
+// thread writes nothing.
+static void drain_tx_m2s(GstM2svideosink *p_m2svideosink)
+{
+	std::unique_lock<std::mutex> lock(p_m2svideosink->tx_lock);
+	p_m2svideosink->tx_cond.wait(lock, [p_m2svideosink] {
+		return !p_m2svideosink->tx_running || p_m2svideosink->tx_unlocked || tx_ring_empty(p_m2svideosink);
+	});
+}
+
 static void gst_m2svideosink_set_gpu_num (GstM2svideosink *m2svideosink, uint8_t gpu_num)
 {
 	m2svideosink->gpu_num = gpu_num;
@@ -316,6 +739,51 @@ static void gst_m2svideosink_set_tx_delay_ms (GstM2svideosink *m2svideosink, int
 	m2svideosink->tx_delay_ms = tx_delay_ms;
 }
 
+static void gst_m2svideosink_set_hugepage_pool (GstM2svideosink *m2svideosink, bool hugepage_pool)
+{
+	m2svideosink->hugepage_pool = hugepage_pool;
+}
+
+static void gst_m2svideosink_set_async_tx (GstM2svideosink *m2svideosink, bool async_tx)
+{
+	m2svideosink->async_tx = async_tx;
+}
+
+static void gst_m2svideosink_set_tx_ring_depth (GstM2svideosink *m2svideosink, uint32_t depth)
+{
+	m2svideosink->tx_ring_depth = depth;
+}
+
+static void gst_m2svideosink_set_tx_overflow_policy (GstM2svideosink *m2svideosink, GstM2svideosinkTxOverflowPolicy policy)
+{
+	m2svideosink->tx_overflow_policy = policy;
+}
+
+static void gst_m2svideosink_set_tx_schedule (GstM2svideosink *m2svideosink, GstM2svideosinkTxSchedule schedule)
+{
+	m2svideosink->tx_schedule = schedule;
+}
+
+static void gst_m2svideosink_set_drop_late (GstM2svideosink *m2svideosink, bool drop_late)
+{
+	m2svideosink->drop_late = drop_late;
+}
+
+static void gst_m2svideosink_set_min_lead_us (GstM2svideosink *m2svideosink, uint32_t min_lead_us)
+{
+	m2svideosink->min_lead_us = min_lead_us;
+}
+
+static void gst_m2svideosink_set_keepalive (GstM2svideosink *m2svideosink, GstM2svideosinkKeepalive keepalive)
+{
+	m2svideosink->keepalive = keepalive;
+}
+
+static void gst_m2svideosink_set_preroll_frames (GstM2svideosink *m2svideosink, uint32_t preroll_frames)
+{
+	m2svideosink->preroll_frames = preroll_frames;
+}
+
 static void
 gst_m2svideosink_class_init (GstM2svideosinkClass * klass)
 {
@@ -439,12 +907,93 @@ gst_m2svideosink_class_init (GstM2svideosinkClass * klass)
 	                                                    "Tx delay ms", 0x80000000, 0x7fffffff, DEFAULT_TX_DELAY_MS,
 	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
+	g_object_class_install_property (gobject_class, PROP_HUGEPAGE_POOL,
+	                                 g_param_spec_boolean ("hugepage-pool", "Hugepage Pool",
+	                                                       "Propose a pool of locked 2MB-page frames to upstream",
+	                                                       DEFAULT_HUGEPAGE_POOL,
+	                                                       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_ASYNC_TX,
+	                                 g_param_spec_boolean ("async-tx", "Async TX",
+	                                                       "Write to m2s from a TX thread fed through a ring of tx-ring-depth frames",
+	                                                       DEFAULT_ASYNC_TX,
+	                                                       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_TX_RING_DEPTH,
+	                                 g_param_spec_uint ("tx-ring-depth", "TX Ring Depth",
+	                                                    "Frames queued for the TX thread in async-tx mode",
+	                                                    1, 64, DEFAULT_TX_RING_DEPTH,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_TX_OVERFLOW_POLICY,
+	                                 g_param_spec_enum ("tx-overflow-policy", "TX Overflow Policy",
+	                                                    "What to do with a frame when the TX ring is full",
+	                                                    GST_TYPE_M2S_VIDEO_SINK_TX_OVERFLOW_POLICY, DEFAULT_TX_OVERFLOW_POLICY,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_TX_DROPPED,
+	                                 g_param_spec_uint64 ("tx-dropped", "TX Dropped",
+	                                                      "Frames dropped on a full TX ring", 0, G_MAXUINT64, 0,
+	                                                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_TX_SCHEDULE,
+	                                 g_param_spec_enum ("tx-schedule", "TX Schedule",
+	                                                    "How frames are assigned to alignment points",
+	                                                    GST_TYPE_M2S_VIDEO_SINK_TX_SCHEDULE, DEFAULT_TX_SCHEDULE,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_SCHEDULE_DROPPED,
+	                                 g_param_spec_uint64 ("schedule-dropped", "Schedule Dropped",
+	                                                      "Frames dropped because their alignment point was already used (tx-schedule=pts)",
+	                                                      0, G_MAXUINT64, 0,
+	                                                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_DROP_LATE,
+	                                 g_param_spec_boolean ("drop-late", "Drop Late",
+	                                                       "Drop frames due less than min-lead-us from now and send QoS events upstream",
+	                                                       DEFAULT_DROP_LATE,
+	                                                       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_MIN_LEAD_US,
+	                                 g_param_spec_uint ("min-lead-us", "Minimum Lead",
+	                                                    "Minimum time in microseconds between m2s_write() and the start of the frame on the wire",
+	                                                    0, 1000000, DEFAULT_MIN_LEAD_US,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_LATE_DROPPED,
+	                                 g_param_spec_uint64 ("late-dropped", "Late Dropped",
+	                                                      "Frames dropped for being late (drop-late)", 0, G_MAXUINT64, 0,
+	                                                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_KEEPALIVE,
+	                                 g_param_spec_enum ("keep-alive", "Keep Alive",
+	                                                    "Fill alignment points left empty by upstream while PLAYING",
+	                                                    GST_TYPE_M2S_VIDEO_SINK_KEEPALIVE, DEFAULT_KEEPALIVE,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_KEEPALIVE_INSERTED,
+	                                 g_param_spec_uint64 ("keep-alive-inserted", "Keep Alive Inserted",
+	                                                      "Frames sent by keep-alive", 0, G_MAXUINT64, 0,
+	                                                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PREROLL_FRAMES,
+	                                 g_param_spec_uint ("preroll-frames", "Pre-roll Frames",
+	                                                    "Frames collected before the first write, 0 to start with the first frame",
+	                                                    0, 64, DEFAULT_PREROLL_FRAMES,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
 	gobject_class->dispose = gst_m2svideosink_dispose;
 	gobject_class->finalize = gst_m2svideosink_finalize;
 
 	element_class->change_state = gst_m2svideosink_change_state;
+	element_class->provide_clock = gst_m2svideosink_provide_clock;
 
 	basesink_class->set_caps = GST_DEBUG_FUNCPTR (gst_m2svideosink_set_caps);
+	basesink_class->propose_allocation = GST_DEBUG_FUNCPTR (gst_m2svideosink_propose_allocation);
+	basesink_class->unlock = GST_DEBUG_FUNCPTR (gst_m2svideosink_unlock);
+	basesink_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_m2svideosink_unlock_stop);
+	basesink_class->event = GST_DEBUG_FUNCPTR (gst_m2svideosink_event);
+	basesink_class->preroll = GST_DEBUG_FUNCPTR (gst_m2svideosink_preroll);
 
 	video_sink_class->show_frame = GST_DEBUG_FUNCPTR (gst_m2svideosink_show_frame);
 
@@ -453,6 +1002,7 @@ gst_m2svideosink_class_init (GstM2svideosinkClass * klass)
 static void
 gst_m2svideosink_init (GstM2svideosink * p_m2svideosink)
 {
+	GST_OBJECT_FLAG_SET (p_m2svideosink, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
 	gst_m2svideosink_set_gpu_num(p_m2svideosink, DEFAULT_GPU_NUM);
 	gst_m2svideosink_set_cpu_num(p_m2svideosink, DEFAULT_CPU_NUM);
 	gst_m2svideosink_set_p_dst_address(p_m2svideosink, DEFAULT_P_DST_ADDRESS);
@@ -473,6 +1023,20 @@ gst_m2svideosink_init (GstM2svideosink * p_m2svideosink)
 	gst_m2svideosink_set_box_size(p_m2svideosink, DEFAULT_BOX_SIZE);
 	gst_m2svideosink_set_gpudirect(p_m2svideosink, DEFAULT_GPUDIRECT);
 	gst_m2svideosink_set_tx_delay_ms(p_m2svideosink, DEFAULT_TX_DELAY_MS);
+	gst_m2svideosink_set_hugepage_pool(p_m2svideosink, DEFAULT_HUGEPAGE_POOL);
+	gst_m2svideosink_set_async_tx(p_m2svideosink, DEFAULT_ASYNC_TX);
+	gst_m2svideosink_set_tx_ring_depth(p_m2svideosink, DEFAULT_TX_RING_DEPTH);
+	gst_m2svideosink_set_tx_overflow_policy(p_m2svideosink, DEFAULT_TX_OVERFLOW_POLICY);
+	gst_m2svideosink_set_tx_schedule(p_m2svideosink, DEFAULT_TX_SCHEDULE);
+	gst_m2svideosink_set_drop_late(p_m2svideosink, DEFAULT_DROP_LATE);
+	gst_m2svideosink_set_min_lead_us(p_m2svideosink, DEFAULT_MIN_LEAD_US);
+	gst_m2svideosink_set_keepalive(p_m2svideosink, DEFAULT_KEEPALIVE);
+	gst_m2svideosink_set_preroll_frames(p_m2svideosink, DEFAULT_PREROLL_FRAMES);
+	// m2s sends nothing before PLAYING, where render delivers the preroll
+	// buffer again; showing it in PAUSED too would send it twice
+	g_object_set (p_m2svideosink, "show-preroll-frame", FALSE, NULL);
+	p_m2svideosink->p_hugepage_allocator =
+		(GstAllocator *)gst_object_ref_sink(g_object_new(gst_m2s_hugepage_allocator_get_type(), NULL));
 }
 
 void
@@ -544,6 +1108,33 @@ gst_m2svideosink_set_property (GObject * object, guint property_id,
 	case PROP_TX_DELAY_MS:
 		gst_m2svideosink_set_tx_delay_ms (p_m2svideosink, g_value_get_int (value));
 		break;
+	case PROP_HUGEPAGE_POOL:
+		gst_m2svideosink_set_hugepage_pool (p_m2svideosink, g_value_get_boolean (value));
+		break;
+	case PROP_ASYNC_TX:
+		gst_m2svideosink_set_async_tx (p_m2svideosink, g_value_get_boolean (value));
+		break;
+	case PROP_TX_RING_DEPTH:
+		gst_m2svideosink_set_tx_ring_depth (p_m2svideosink, g_value_get_uint (value));
+		break;
+	case PROP_TX_OVERFLOW_POLICY:
+		gst_m2svideosink_set_tx_overflow_policy (p_m2svideosink, (GstM2svideosinkTxOverflowPolicy)g_value_get_enum (value));
+		break;
+	case PROP_TX_SCHEDULE:
+		gst_m2svideosink_set_tx_schedule (p_m2svideosink, (GstM2svideosinkTxSchedule)g_value_get_enum (value));
+		break;
+	case PROP_DROP_LATE:
+		gst_m2svideosink_set_drop_late (p_m2svideosink, g_value_get_boolean (value));
+		break;
+	case PROP_MIN_LEAD_US:
+		gst_m2svideosink_set_min_lead_us (p_m2svideosink, g_value_get_uint (value));
+		break;
+	case PROP_KEEPALIVE:
+		gst_m2svideosink_set_keepalive (p_m2svideosink, (GstM2svideosinkKeepalive)g_value_get_enum (value));
+		break;
+	case PROP_PREROLL_FRAMES:
+		gst_m2svideosink_set_preroll_frames (p_m2svideosink, g_value_get_uint (value));
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
 		break;
@@ -619,6 +1210,45 @@ gst_m2svideosink_get_property (GObject * object, guint property_id,
 	case PROP_TX_DELAY_MS:
 		g_value_set_int (value, p_m2svideosink->tx_delay_ms);
 		break;
+	case PROP_HUGEPAGE_POOL:
+		g_value_set_boolean (value, p_m2svideosink->hugepage_pool);
+		break;
+	case PROP_ASYNC_TX:
+		g_value_set_boolean (value, p_m2svideosink->async_tx);
+		break;
+	case PROP_TX_RING_DEPTH:
+		g_value_set_uint (value, p_m2svideosink->tx_ring_depth);
+		break;
+	case PROP_TX_OVERFLOW_POLICY:
+		g_value_set_enum (value, p_m2svideosink->tx_overflow_policy);
+		break;
+	case PROP_TX_DROPPED:
+		g_value_set_uint64 (value, p_m2svideosink->tx_dropped);
+		break;
+	case PROP_TX_SCHEDULE:
+		g_value_set_enum (value, p_m2svideosink->tx_schedule);
+		break;
+	case PROP_SCHEDULE_DROPPED:
+		g_value_set_uint64 (value, p_m2svideosink->schedule_dropped);
+		break;
+	case PROP_DROP_LATE:
+		g_value_set_boolean (value, p_m2svideosink->drop_late);
+		break;
+	case PROP_MIN_LEAD_US:
+		g_value_set_uint (value, p_m2svideosink->min_lead_us);
+		break;
+	case PROP_LATE_DROPPED:
+		g_value_set_uint64 (value, p_m2svideosink->late_dropped);
+		break;
+	case PROP_KEEPALIVE:
+		g_value_set_enum (value, p_m2svideosink->keepalive);
+		break;
+	case PROP_KEEPALIVE_INSERTED:
+		g_value_set_uint64 (value, p_m2svideosink->keepalive_inserted);
+		break;
+	case PROP_PREROLL_FRAMES:
+		g_value_set_uint (value, p_m2svideosink->preroll_frames);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
 		break;
@@ -645,10 +1275,22 @@ gst_m2svideosink_finalize (GObject * object)
 	GST_DEBUG_OBJECT (m2svideosink, "finalize");
 
 	/* clean up object here */
+	g_free (m2svideosink->p_weave);
+	m2svideosink->p_weave = NULL;
+	gst_buffer_replace (&m2svideosink->p_slate, NULL);
+	gst_buffer_replace (&m2svideosink->p_keepalive_last, NULL);
+	clear_preroll_m2s (m2svideosink);
+	gst_object_unref (m2svideosink->p_hugepage_allocator);
 
 	G_OBJECT_CLASS (gst_m2svideosink_parent_class)->finalize (object);
 }
 
+static GstClock *
+gst_m2svideosink_provide_clock (GstElement * element)
+{
+	return gst_m2s_clock_obtain();
+}
+
 static GstStateChangeReturn
 gst_m2svideosink_change_state (GstElement * element, GstStateChange transition)
 {
@@ -670,18 +1312,33 @@ gst_m2svideosink_change_state (GstElement * element, GstStateChange transition)
 		break;
 
 	case GST_STATE_CHANGE_READY_TO_PAUSED:
+		if (p_m2svideosink->async_tx)
+		{
+			start_tx_thread(p_m2svideosink);
+		}
 		break;
 
 	case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
 		m2s_start(p_m2svideosink->strm_id);
 		m2s_enable_select(p_m2svideosink->strm_id, true);
+		resume_tx_thread(p_m2svideosink);
 		start_monitoring_timer(p_m2svideosink);
+		if (p_m2svideosink->keepalive != GST_M2SVIDEOSINK_KEEPALIVE_OFF)
+		{
+			start_keepalive_thread(p_m2svideosink);
+		}
 		break;
 
 	case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+		stop_keepalive_thread(p_m2svideosink);
 		stop_monitoring_timer(p_m2svideosink);
+		pause_tx_thread(p_m2svideosink);
 		m2s_enable_select(p_m2svideosink->strm_id, false);
-		m2s_stop(p_m2svideosink->strm_id);
+		{
+			// a write from show_frame finishes first
+			std::lock_guard<std::mutex> lock(p_m2svideosink->write_lock);
+			m2s_stop(p_m2svideosink->strm_id);
+		}
 		break;
 
 	case GST_STATE_CHANGE_PAUSED_TO_READY:
@@ -697,32 +1354,171 @@ gst_m2svideosink_change_state (GstElement * element, GstStateChange transition)
 	}
 
 	ret = GST_ELEMENT_CLASS (gst_m2svideosink_parent_class)->change_state (element, transition);
+
+	switch (transition)
+	{
+	case GST_STATE_CHANGE_PAUSED_TO_READY:
+		/* the pad is deactivated, show_frame no longer runs */
+		stop_tx_thread(p_m2svideosink);
+		gst_buffer_replace (&p_m2svideosink->p_keepalive_last, NULL);
+		clear_preroll_m2s(p_m2svideosink);
+		break;
+
+	default:
+		break;
+	}
+
 	return ret;
 }
 
-static gboolean gst_m2svideosink_set_caps (GstBaseSink * p_bsink, GstCaps * p_caps)
+static gboolean
+gst_m2svideosink_unlock (GstBaseSink * p_bsink)
 {
-	GstVideoSink *p_vsink;
-	GstM2svideosink *p_m2svideosink;
-	GstVideoInfo info;
-	uint32_t frame_pixel_num;
-	m2s_sys_conf_t sys_conf;
-	m2s_media_conf_t media_conf;
-	m2s_ip_conf_t ip_conf;
-	memset(&sys_conf, 0, sizeof(sys_conf));
-	memset(&media_conf, 0, sizeof(media_conf));
-	memset(&ip_conf, 0, sizeof(ip_conf));
-
-	p_vsink = GST_VIDEO_SINK_CAST (p_bsink);
-	p_m2svideosink = GST_M2SVIDEOSINK (p_vsink);
+	GstM2svideosink *p_m2svideosink = GST_M2SVIDEOSINK (p_bsink);
 
-	if (!gst_video_info_from_caps (&info, p_caps)) {
-		GST_ERROR_OBJECT (p_bsink, "Failed to parse caps %" GST_PTR_FORMAT, p_caps);
-		return FALSE;
-	}
+	/* release show_frame waiting for a free slot, the queued frames stay */
+	std::unique_lock<std::mutex> lock(p_m2svideosink->tx_lock);
+	p_m2svideosink->tx_unlocked = true;
+	p_m2svideosink->tx_cond.notify_all();
 
-	GST_DEBUG_OBJECT (p_bsink, "Setting caps %" GST_PTR_FORMAT, p_caps);
-	p_m2svideosink->info = info;
+	return TRUE;
+}
+
+static gboolean
+gst_m2svideosink_unlock_stop (GstBaseSink * p_bsink)
+{
+	GstM2svideosink *p_m2svideosink = GST_M2SVIDEOSINK (p_bsink);
+
+	{
+		std::unique_lock<std::mutex> lock(p_m2svideosink->tx_lock);
+		p_m2svideosink->tx_unlocked = false;
+	}
+	g_atomic_int_set(&p_m2svideosink->tx_flow_ret, GST_FLOW_OK);
+
+	// after a flush or a pause the running time no longer follows TAI
+	p_m2svideosink->pts_anchor_valid = false;
+
+	if (p_m2svideosink->preroll_frames > 0)
+	{
+		// held frames are flushed and m2s starts empty, pre-roll again
+		clear_preroll_m2s(p_m2svideosink);
+		p_m2svideosink->done_first_set_contents = false;
+		p_m2svideosink->frame_offset = 0;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+gst_m2svideosink_event (GstBaseSink * p_bsink, GstEvent * p_event)
+{
+	GstM2svideosink *p_m2svideosink = GST_M2SVIDEOSINK (p_bsink);
+
+	switch (GST_EVENT_TYPE (p_event))
+	{
+	case GST_EVENT_FLUSH_START:
+		// the TX thread drops what is queued, even while paused
+		if (p_m2svideosink->p_tx_thread != nullptr)
+		{
+			std::unique_lock<std::mutex> lock(p_m2svideosink->tx_lock);
+			p_m2svideosink->tx_flushing = true;
+			p_m2svideosink->tx_cond.notify_all();
+		}
+		break;
+
+	case GST_EVENT_FLUSH_STOP:
+		if (p_m2svideosink->p_tx_thread != nullptr)
+		{
+			// flushing, the ring empties even while paused
+			std::unique_lock<std::mutex> lock(p_m2svideosink->tx_lock);
+			p_m2svideosink->tx_cond.wait(lock, [p_m2svideosink] {
+				return !p_m2svideosink->tx_running || tx_ring_empty(p_m2svideosink);
+			});
+			p_m2svideosink->tx_flushing = false;
+			g_atomic_int_set(&p_m2svideosink->tx_flow_ret, GST_FLOW_OK);
+		}
+		break;
+
+	case GST_EVENT_EOS:
+		// the TX thread writes all queued frames before EOS goes on
+		if (p_m2svideosink->p_tx_thread != nullptr)
+		{
+			drain_tx_m2s(p_m2svideosink);
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	if (GST_EVENT_TYPE (p_event) == GST_EVENT_EOS)
+	{
+		// the stream ended before the pre-roll was complete, send what there is
+		if (!g_queue_is_empty(&p_m2svideosink->preroll_queue))
+		{
+			flush_preroll_m2s(p_m2svideosink);
+		}
+	}
+
+	return GST_BASE_SINK_CLASS (gst_m2svideosink_parent_class)->event (p_bsink, p_event);
+}
+
+static gboolean gst_m2svideosink_set_caps (GstBaseSink * p_bsink, GstCaps * p_caps)
+{
+	GstVideoSink *p_vsink;
+	GstM2svideosink *p_m2svideosink;
+	GstVideoInfo info;
+	uint32_t frame_pixel_num;
+	m2s_sys_conf_t sys_conf;
+	m2s_media_conf_t media_conf;
+	m2s_ip_conf_t ip_conf;
+	memset(&sys_conf, 0, sizeof(sys_conf));
+	memset(&media_conf, 0, sizeof(media_conf));
+	memset(&ip_conf, 0, sizeof(ip_conf));
+
+	p_vsink = GST_VIDEO_SINK_CAST (p_bsink);
+	p_m2svideosink = GST_M2SVIDEOSINK (p_vsink);
+
+	if (p_m2svideosink->p_tx_thread != nullptr)
+	{
+		drain_tx_m2s(p_m2svideosink);
+	}
+	// frames held for pre-roll go out with the caps they came with
+	if (!g_queue_is_empty(&p_m2svideosink->preroll_queue))
+	{
+		flush_preroll_m2s(p_m2svideosink);
+	}
+	p_m2svideosink->preroll_done = false;
+
+	if (!gst_video_info_from_caps (&info, p_caps)) {
+		GST_ERROR_OBJECT (p_bsink, "Failed to parse caps %" GST_PTR_FORMAT, p_caps);
+		return FALSE;
+	}
+
+	GST_DEBUG_OBJECT (p_bsink, "Setting caps %" GST_PTR_FORMAT, p_caps);
+	p_m2svideosink->info = info;
+
+	// m2s sends whole frames, fields from an alternate stream are woven here
+	g_free (p_m2svideosink->p_weave);
+	p_m2svideosink->p_weave = NULL;
+	p_m2svideosink->weave_fields = 0;
+	if (GST_VIDEO_INFO_INTERLACE_MODE(&info) == GST_VIDEO_INTERLACE_MODE_ALTERNATE)
+	{
+		gst_video_info_set_format(&p_m2svideosink->frame_info, GST_VIDEO_INFO_FORMAT(&info),
+		                          GST_VIDEO_INFO_WIDTH(&info), GST_VIDEO_INFO_HEIGHT(&info));
+		p_m2svideosink->p_weave = (uint8_t *)g_malloc0(GST_VIDEO_INFO_SIZE(&p_m2svideosink->frame_info));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(p_m2svideosink->write_lock);
+		gst_buffer_replace (&p_m2svideosink->p_keepalive_last, NULL);
+		gst_buffer_replace (&p_m2svideosink->p_slate, NULL);
+		if (p_m2svideosink->keepalive != GST_M2SVIDEOSINK_KEEPALIVE_OFF)
+		{
+			p_m2svideosink->p_slate = create_slate_m2s((p_m2svideosink->p_weave != NULL) ?
+			                                           &p_m2svideosink->frame_info : &p_m2svideosink->info);
+		}
+	}
 
 	DBG_MSG("framerate %u/%u\n", GST_VIDEO_INFO_FPS_N(&p_m2svideosink->info), GST_VIDEO_INFO_FPS_D(&p_m2svideosink->info));
 
@@ -852,7 +1648,8 @@ static gboolean gst_m2svideosink_set_caps (GstBaseSink * p_bsink, GstCaps * p_ca
 	m2s_set_media_conf(p_m2svideosink->strm_id, &media_conf);
 	m2s_set_ip_conf(p_m2svideosink->strm_id, &ip_conf);
 
-	g_start_time_offset_ns = calc_tr_offset(M2S_MEDIA_TYPE_VIDEO, &media_conf);
+	p_m2svideosink->start_time_offset_ns = calc_tr_offset(M2S_MEDIA_TYPE_VIDEO, &media_conf);
+	GST_INFO_OBJECT (p_m2svideosink, "TR offset %d ns", p_m2svideosink->start_time_offset_ns);
 
 	p_m2svideosink->done_first_set_contents = false;
 	p_m2svideosink->frame_offset = 0;
@@ -860,59 +1657,642 @@ static gboolean gst_m2svideosink_set_caps (GstBaseSink * p_bsink, GstCaps * p_ca
 	return TRUE;
 }
 
-static GstFlowReturn
-gst_m2svideosink_show_frame (GstVideoSink * sink, GstBuffer * buf)
+// Offer upstream frames in the hugepage memory, so that converters write
+// straight into what m2s_write() copies from.
+static gboolean gst_m2svideosink_propose_allocation (GstBaseSink * p_bsink, GstQuery * p_query)
+{
+	GstM2svideosink *p_m2svideosink = GST_M2SVIDEOSINK (p_bsink);
+	GstBufferPool *p_pool = NULL;
+	GstStructure *p_config;
+	GstAllocationParams params;
+	GstVideoInfo info;
+	GstCaps *p_caps;
+	gboolean need_pool;
+
+	/* nothing to propose is not a failure, upstream allocates as it likes */
+	if (!p_m2svideosink->hugepage_pool)
+	{
+		return TRUE;
+	}
+
+	gst_query_parse_allocation (p_query, &p_caps, &need_pool);
+	if ((p_caps == NULL) || !gst_video_info_from_caps (&info, p_caps))
+	{
+		GST_DEBUG_OBJECT (p_m2svideosink, "no usable caps in the allocation query");
+		return TRUE;
+	}
+
+	gst_allocation_params_init (&params);
+	params.align = HUGEPAGE_POOL_ALIGN - 1;
+
+	if (need_pool)
+	{
+		p_pool = gst_video_buffer_pool_new ();
+		p_config = gst_buffer_pool_get_config (p_pool);
+		gst_buffer_pool_config_set_params (p_config, p_caps, GST_VIDEO_INFO_SIZE (&info), HUGEPAGE_POOL_MIN_BUFFERS, 0);
+		gst_buffer_pool_config_set_allocator (p_config, p_m2svideosink->p_hugepage_allocator, &params);
+		if (!gst_buffer_pool_set_config (p_pool, p_config))
+		{
+			GST_WARNING_OBJECT (p_m2svideosink, "failed to configure the hugepage pool");
+			gst_object_unref (p_pool);
+			return FALSE;
+		}
+	}
+
+	gst_query_add_allocation_pool (p_query, p_pool, GST_VIDEO_INFO_SIZE (&info), HUGEPAGE_POOL_MIN_BUFFERS, 0);
+	if (p_pool != NULL)
+	{
+		gst_object_unref (p_pool);
+	}
+	gst_query_add_allocation_param (p_query, p_m2svideosink->p_hugepage_allocator, &params);
+
+	return TRUE;
+}
+
+// tx-schedule=pts: the alignment point nearest to the TAI at which the frame
+// is due, tx_delay_ms after its running time. With the m2s clock selected,
+// base_time plus running time already is TAI; otherwise the first frame
+// anchors the running time to the alignment point tx_delay_ms from now, and
+// the anchor moves by the drift of the pipeline clock against TAI whenever
+// that exceeds half a frame. After keep-alive insertion the anchor is the
+// slot following it.
+static bool pts_alignment_point_m2s (GstM2svideosink *p_m2svideosink, GstClockTime pts, uint64_t *p_align_time)
+{
+	GstClockTime running_time;
+	GstClockTime base_time;
+	GstClockTime clock_now = GST_CLOCK_TIME_NONE;
+	GstClock *p_clock;
+	bool m2s_clock;
+	uint64_t tx_delay_ns = (int64_t)p_m2svideosink->tx_delay_ms * 1000000;
+	uint64_t half_frame;
+	uint64_t tai_now;
+	uint64_t tai;
+	int64_t drift;
+
+	if (!GST_CLOCK_TIME_IS_VALID(pts))
+	{
+		return false;
+	}
+
+	GST_OBJECT_LOCK (p_m2svideosink);
+	running_time = gst_segment_to_running_time(&GST_BASE_SINK_CAST(p_m2svideosink)->segment, GST_FORMAT_TIME, pts);
+	p_clock = GST_ELEMENT_CLOCK (p_m2svideosink);
+	m2s_clock = (p_clock != NULL) && GST_IS_M2S_CLOCK(p_clock);
+	if ((p_clock != NULL) && !m2s_clock)
+	{
+		gst_object_ref (p_clock);
+	}
+	else
+	{
+		p_clock = NULL;
+	}
+	base_time = GST_ELEMENT_CAST (p_m2svideosink)->base_time;
+	GST_OBJECT_UNLOCK (p_m2svideosink);
+
+	if (p_clock != NULL)
+	{
+		clock_now = gst_clock_get_time (p_clock);
+		gst_object_unref (p_clock);
+	}
+	tai_now = m2s_get_current_tai_ns();
+
+	if (!GST_CLOCK_TIME_IS_VALID(running_time))
+	{
+		return false;
+	}
+
+	half_frame = gst_util_uint64_scale(GST_SECOND, GST_VIDEO_INFO_FPS_D(&p_m2svideosink->info),
+	                                   2 * GST_VIDEO_INFO_FPS_N(&p_m2svideosink->info));
+
+	if (p_m2svideosink->keepalive_resync)
+	{
+		// keep-alive frames went out during a stall, continue right after them
+		p_m2svideosink->pts_anchor_tai = m2s_calc_next_video_alignment_point(p_m2svideosink->last_align_time + 1,
+		                                                                     p_m2svideosink->m2s_frame_rate, 0);
+		p_m2svideosink->pts_anchor_rt = running_time;
+		p_m2svideosink->pts_anchor_clock = clock_now;
+		p_m2svideosink->pts_anchor_clock_tai = tai_now;
+		p_m2svideosink->pts_anchor_valid = true;
+	}
+
+	if (m2s_clock && !p_m2svideosink->pts_anchor_valid)
+	{
+		tai = base_time + running_time + tx_delay_ns;
+	}
+	else
+	{
+		if (!p_m2svideosink->pts_anchor_valid || (running_time < p_m2svideosink->pts_anchor_rt))
+		{
+			p_m2svideosink->pts_anchor_tai = m2s_calc_next_video_alignment_point(tai_now + tx_delay_ns,
+			                                                                     p_m2svideosink->m2s_frame_rate, 0);
+			p_m2svideosink->pts_anchor_rt = running_time;
+			p_m2svideosink->pts_anchor_clock = clock_now;
+			p_m2svideosink->pts_anchor_clock_tai = tai_now;
+			p_m2svideosink->pts_anchor_valid = true;
+		}
+		tai = p_m2svideosink->pts_anchor_tai + running_time - p_m2svideosink->pts_anchor_rt;
+
+		// running time is paced by the pipeline clock, which may run apart from TAI
+		if (GST_CLOCK_TIME_IS_VALID(clock_now) && GST_CLOCK_TIME_IS_VALID(p_m2svideosink->pts_anchor_clock))
+		{
+			drift = (int64_t)(tai_now - p_m2svideosink->pts_anchor_clock_tai) -
+			        GST_CLOCK_DIFF (p_m2svideosink->pts_anchor_clock, clock_now);
+			if ((uint64_t)ABS (drift) > half_frame)
+			{
+				GST_DEBUG_OBJECT (p_m2svideosink, "pipeline clock drifted %" G_GINT64_FORMAT " ns from TAI, re-anchoring",
+				                  drift);
+				tai += drift;
+				p_m2svideosink->pts_anchor_tai = tai;
+				p_m2svideosink->pts_anchor_rt = running_time;
+				p_m2svideosink->pts_anchor_clock = clock_now;
+				p_m2svideosink->pts_anchor_clock_tai = tai_now;
+			}
+		}
+	}
+
+	// round to the nearest point, so that jitter in the timestamps does not
+	// move a frame into the next slot
+	*p_align_time = m2s_calc_next_video_alignment_point(tai - half_frame, p_m2svideosink->m2s_frame_rate, 0);
+
+	return true;
+}
+
+// Report a frame dropped for being late: a QoS event lets upstream, e.g. a
+// decoder, skip work until it catches up, the QoS message informs the
+// application as basesink does for its own drops.
+static void late_qos_m2s (GstM2svideosink *p_m2svideosink, GstClockTime pts, GstClockTimeDiff jitter)
+{
+	GstBaseSink *p_bsink = GST_BASE_SINK_CAST (p_m2svideosink);
+	GstClockTime running_time;
+	GstClockTime stream_time;
+	GstClockTime duration;
+	GstMessage *p_msg;
+
+	if (!gst_base_sink_is_qos_enabled(p_bsink) || !GST_CLOCK_TIME_IS_VALID(pts))
+	{
+		return;
+	}
+
+	GST_OBJECT_LOCK (p_m2svideosink);
+	running_time = gst_segment_to_running_time(&p_bsink->segment, GST_FORMAT_TIME, pts);
+	stream_time = gst_segment_to_stream_time(&p_bsink->segment, GST_FORMAT_TIME, pts);
+	GST_OBJECT_UNLOCK (p_m2svideosink);
+
+	if (!GST_CLOCK_TIME_IS_VALID(running_time))
+	{
+		return;
+	}
+
+	gst_pad_push_event(GST_BASE_SINK_PAD(p_bsink), gst_event_new_qos(GST_QOS_TYPE_UNDERFLOW, 1.0, jitter, running_time));
+
+	duration = gst_util_uint64_scale(GST_SECOND, GST_VIDEO_INFO_FPS_D(&p_m2svideosink->info),
+	                                 GST_VIDEO_INFO_FPS_N(&p_m2svideosink->info));
+	p_msg = gst_message_new_qos(GST_OBJECT_CAST (p_m2svideosink), TRUE, running_time, stream_time, pts, duration);
+	gst_message_set_qos_values(p_msg, jitter, 1.0, 1000000);
+	gst_message_set_qos_stats(p_msg, GST_FORMAT_BUFFERS, p_m2svideosink->qos_processed, p_m2svideosink->late_dropped);
+	gst_element_post_message(GST_ELEMENT_CAST (p_m2svideosink), p_msg);
+}
+
+// Write one frame for the alignment point align_time. Called with write_lock
+// held, after m2s_write_select().
+static GstFlowReturn write_slot_m2s (GstM2svideosink *p_m2svideosink, uint8_t *p_data, m2s_media_size_t *p_size, uint64_t align_time)
 {
-	GstFlowReturn ret;
 	int32_t ret_m2s;
-	GstM2svideosink *p_m2svideosink = GST_M2SVIDEOSINK (sink);
-	GstMapInfo info;
 	m2s_media_t media;
-	m2s_media_size_t size;
 	m2s_time_info_t time_info;
+
+	time_info.start_time_ns = align_time;
+	time_info.start_time_ns += p_m2svideosink->start_time_offset_ns;
+	time_info.rtp_timestamp = m2s_conv_tai_to_rtptime(align_time, M2S_RTP_COUNTER_FREQ_90KHZ);
+	GST_LOG_OBJECT (p_m2svideosink, "write at %" G_GUINT64_FORMAT " with TR offset %" G_GINT64_FORMAT " ns",
+	                align_time, (gint64)(time_info.start_time_ns - align_time));
+
+	media.video.p_frame = p_data;
+
+	if ((ret_m2s = m2s_write(p_m2svideosink->strm_id, &time_info, &media, p_size)) != 0)
+	{
+		if (ret_m2s != M2S_RET_NOT_START)
+		{
+			//DBG_MSG("!!! gst_m2svideosink_show_frame : m2s_write error: ret=%d\n", ret_m2s);
+		}
+		return GST_FLOW_ERROR;
+	}
+	p_m2svideosink->last_align_time = align_time;
+
+	return GST_FLOW_OK;
+}
+
+static GstFlowReturn write_frame_m2s (GstM2svideosink *p_m2svideosink, uint8_t *p_data, uint32_t data_size, GstClockTime pts)
+{
+	std::unique_lock<std::mutex> lock(p_m2svideosink->write_lock);
+	uint64_t earliest_time;
+	uint64_t start_time_ns;
+	uint64_t now;
+	int32_t ret_m2s;
+	m2s_media_size_t size;
 	uint64_t align_time;
 
-	GST_DEBUG_OBJECT (p_m2svideosink, "show_frame");
+	size.video.frame_size = data_size;
+	if ((ret_m2s = m2s_write_select(p_m2svideosink->strm_id, &size, nullptr)) != 0)
+	{
+		if (ret_m2s != M2S_RET_NOT_START)
+		{
+			//DBG_MSG("!!! gst_m2svideosink_show_frame : m2s_write_select error: ret=%#010x size=%u\n", ret_m2s, size.video.frame_size);
+		}
+		return GST_FLOW_OK;
+	}
 
-	if (gst_buffer_map(buf, &info, GST_MAP_READ))
+	if (!p_m2svideosink->done_first_set_contents)
 	{
-		size.video.frame_size = info.size;
-		if ((ret_m2s = m2s_write_select(p_m2svideosink->strm_id, &size, nullptr)) != 0)
+		if (p_m2svideosink->keepalive_resync)
 		{
-			if (ret_m2s != M2S_RET_NOT_START)
+			// keep-alive is on the wire, continue right after it
+			p_m2svideosink->start_time = p_m2svideosink->last_align_time + 1;
+		}
+		else
+		{
+			// The first frame will be sent 500 msec after the current time.
+			now = m2s_get_current_tai_ns();
+			p_m2svideosink->start_time = now + ((int64_t)p_m2svideosink->tx_delay_ms * 1000000);
+			if (p_m2svideosink->last_align_time < now)
 			{
-				//DBG_MSG("!!! gst_m2svideosink_show_frame : m2s_write_select error: ret=%#010x size=%u\n", ret_m2s, size.video.frame_size);
+				// already on the wire, no slot left to protect
+				p_m2svideosink->last_align_time = 0;
 			}
-			ret = GST_FLOW_OK;
-			goto UNMAP;
 		}
+		// the count restarts at the new start time
+		p_m2svideosink->frame_offset = 0;
+		p_m2svideosink->done_first_set_contents = true;
+		p_m2svideosink->pts_anchor_valid = false;
+	}
 
-		if (!p_m2svideosink->done_first_set_contents)
+	if (p_m2svideosink->tx_schedule == GST_M2SVIDEOSINK_TX_SCHEDULE_PTS)
+	{
+		if (!pts_alignment_point_m2s(p_m2svideosink, pts, &align_time))
 		{
-			// The first frame will be sent 500 msec after the current time.
-			p_m2svideosink->start_time = m2s_get_current_tai_ns() + ((int64_t)p_m2svideosink->tx_delay_ms * 1000000);
-			p_m2svideosink->done_first_set_contents = true;
+			// no timestamp, take the slot after the previous frame
+			align_time = m2s_calc_next_video_alignment_point((p_m2svideosink->last_align_time != 0) ?
+			                                                 p_m2svideosink->last_align_time + 1 : p_m2svideosink->start_time,
+			                                                 p_m2svideosink->m2s_frame_rate, 0);
+		}
+		else if (align_time <= p_m2svideosink->last_align_time)
+		{
+			// a burst after a stall, do not push the following frames back
+			p_m2svideosink->schedule_dropped++;
+			GST_DEBUG_OBJECT (p_m2svideosink, "alignment point %" G_GUINT64_FORMAT " already used, dropping frame", align_time);
+			return GST_FLOW_OK;
 		}
+	}
+	else
+	{
 		align_time = m2s_calc_next_video_alignment_point(p_m2svideosink->start_time, p_m2svideosink->m2s_frame_rate, p_m2svideosink->frame_offset++);
-		time_info.start_time_ns = align_time;
-		time_info.start_time_ns += g_start_time_offset_ns;
-		time_info.rtp_timestamp = m2s_conv_tai_to_rtptime(align_time, M2S_RTP_COUNTER_FREQ_90KHZ);
+		if (align_time <= p_m2svideosink->last_align_time)
+		{
+			// taken by keep-alive during a stall, restart the count after it
+			p_m2svideosink->start_time = p_m2svideosink->last_align_time + 1;
+			p_m2svideosink->frame_offset = 0;
+			align_time = m2s_calc_next_video_alignment_point(p_m2svideosink->start_time, p_m2svideosink->m2s_frame_rate, p_m2svideosink->frame_offset++);
+		}
+	}
+	p_m2svideosink->keepalive_resync = false;
+	start_time_ns = align_time + p_m2svideosink->start_time_offset_ns;
+
+	p_m2svideosink->qos_processed++;
+	if (p_m2svideosink->drop_late)
+	{
+		earliest_time = m2s_get_current_tai_ns() + (uint64_t)p_m2svideosink->min_lead_us * 1000;
+		if (start_time_ns < earliest_time)
+		{
+			p_m2svideosink->late_dropped++;
+			GST_DEBUG_OBJECT (p_m2svideosink, "frame late by %" G_GUINT64_FORMAT " ns, dropping (%" G_GUINT64_FORMAT " dropped)",
+			                  earliest_time - start_time_ns, p_m2svideosink->late_dropped);
+			if (p_m2svideosink->tx_schedule == GST_M2SVIDEOSINK_TX_SCHEDULE_COUNTER)
+			{
+				// every following slot would be late too, restart tx_delay_ms from now
+				p_m2svideosink->done_first_set_contents = false;
+			}
+			lock.unlock();
+			late_qos_m2s(p_m2svideosink, pts, (GstClockTimeDiff)(earliest_time - start_time_ns));
+			return GST_FLOW_OK;
+		}
+	}
+
+	return write_slot_m2s(p_m2svideosink, p_data, &size, align_time);
+}
+
+// Black frame in the layout written to m2s, sent by keep-alive while no
+// upstream frame is available.
+static GstBuffer *create_slate_m2s (GstVideoInfo *p_info)
+{
+	const GstVideoFormatInfo *p_finfo = p_info->finfo;
+	const GstVideoFormatInfo *p_unpack_finfo = gst_video_format_get_info(p_finfo->unpack_format);
+	bool yuv = GST_VIDEO_FORMAT_INFO_IS_YUV(p_finfo);
+	gint width = GST_VIDEO_INFO_WIDTH(p_info);
+	GstVideoFrame frame;
+	GstBuffer *p_buffer;
+	guint16 *p_line16;
+	guint8 *p_line;
+	gint x;
+	gint y;
+
+	// one line of black in the unpack format, AYUV/ARGB with 8 or 16 bits
+	p_line = (guint8 *)g_malloc(width * 8);
+	p_line16 = (guint16 *)p_line;
+	for (x = 0; x < width; x++)
+	{
+		if (GST_VIDEO_FORMAT_INFO_BITS(p_unpack_finfo) > 8)
+		{
+			p_line16[x * 4 + 0] = 0xffff;
+			p_line16[x * 4 + 1] = yuv ? (16 << 8) : 0;
+			p_line16[x * 4 + 2] = yuv ? (128 << 8) : 0;
+			p_line16[x * 4 + 3] = yuv ? (128 << 8) : 0;
+		}
+		else
+		{
+			p_line[x * 4 + 0] = 0xff;
+			p_line[x * 4 + 1] = yuv ? 16 : 0;
+			p_line[x * 4 + 2] = yuv ? 128 : 0;
+			p_line[x * 4 + 3] = yuv ? 128 : 0;
+		}
+	}
+
+	p_buffer = gst_buffer_new_allocate(NULL, GST_VIDEO_INFO_SIZE(p_info), NULL);
+	if (!gst_video_frame_map(&frame, p_info, p_buffer, GST_MAP_WRITE))
+	{
+		g_free(p_line);
+		gst_buffer_unref(p_buffer);
+		return NULL;
+	}
+	for (y = 0; y < GST_VIDEO_INFO_HEIGHT(p_info); y += p_finfo->pack_lines)
+	{
+		p_finfo->pack_func(p_finfo, GST_VIDEO_PACK_FLAG_NONE, p_line, 0, frame.data, frame.info.stride,
+		                   GST_VIDEO_INFO_CHROMA_SITE(p_info), y, width);
+	}
+	gst_video_frame_unmap(&frame);
+	g_free(p_line);
+
+	return p_buffer;
+}
+
+// Keep-alive: a timer thread wakes one frame before each alignment point and,
+// when no frame was written for it, sends the last frame or the slate, so
+// that receivers stay locked while upstream stalls. The buffers are written
+// by reference, m2s_write() does the only copy.
+static void insert_keepalive_m2s (GstM2svideosink *p_m2svideosink, uint64_t align_time)
+{
+	std::lock_guard<std::mutex> lock(p_m2svideosink->write_lock);
+	GstBuffer *p_buffer;
+	GstMapInfo info;
+	m2s_media_size_t size;
+
+	// upstream already filled it, or it is too close to make it
+	if ((align_time <= p_m2svideosink->last_align_time) ||
+		(align_time + p_m2svideosink->start_time_offset_ns <
+		 m2s_get_current_tai_ns() + (uint64_t)p_m2svideosink->min_lead_us * 1000))
+	{
+		return;
+	}
+
+	p_buffer = p_m2svideosink->p_keepalive_last;
+	if ((p_buffer == NULL) || (p_m2svideosink->keepalive == GST_M2SVIDEOSINK_KEEPALIVE_SLATE))
+	{
+		p_buffer = p_m2svideosink->p_slate;
+	}
+	if ((p_buffer == NULL) || !gst_buffer_map(p_buffer, &info, GST_MAP_READ))
+	{
+		return;
+	}
 
-		media.video.p_frame = &info.data[0];
+	size.video.frame_size = info.size;
+	if ((m2s_write_select(p_m2svideosink->strm_id, &size, nullptr) == 0) &&
+		(write_slot_m2s(p_m2svideosink, info.data, &size, align_time) == GST_FLOW_OK))
+	{
+		p_m2svideosink->keepalive_inserted++;
+		// the next upstream frame continues after this one
+		p_m2svideosink->keepalive_resync = true;
+	}
+	gst_buffer_unmap(p_buffer, &info);
+}
+
+static void keepalive_thread_main(GstM2svideosink *p_m2svideosink)
+{
+	uint64_t align_time;
+	uint64_t wake_time;
+	uint64_t now;
+	uint64_t lead_ns;
+	bool ready;
+
+	while (1)
+	{
+		now = m2s_get_current_tai_ns();
+		{
+			std::lock_guard<std::mutex> lock(p_m2svideosink->write_lock);
+			ready = (p_m2svideosink->p_slate != NULL);
+			// one frame plus the minimum lead before the alignment point
+			lead_ns = ready ? gst_util_uint64_scale(GST_SECOND, GST_VIDEO_INFO_FPS_D(&p_m2svideosink->info),
+			                                        GST_VIDEO_INFO_FPS_N(&p_m2svideosink->info)) : 0;
+			lead_ns += (uint64_t)p_m2svideosink->min_lead_us * 1000;
+			align_time = ready ? m2s_calc_next_video_alignment_point(MAX(p_m2svideosink->last_align_time + 1, now + lead_ns),
+			                                                         p_m2svideosink->m2s_frame_rate, 0) : 0;
+		}
+		// no caps yet, poll
+		wake_time = ready ? (align_time - lead_ns) : (now + 100000000);
 
-		if ((ret_m2s = m2s_write(p_m2svideosink->strm_id, &time_info, &media, &size)) != 0)
 		{
-			if (ret_m2s != M2S_RET_NOT_START)
+			std::unique_lock<std::mutex> lock(p_m2svideosink->keepalive_lock);
+			if (wake_time > now)
 			{
-				//DBG_MSG("!!! gst_m2svideosink_show_frame : m2s_write error: ret=%d\n", ret_m2s);
+				p_m2svideosink->keepalive_cond.wait_for(lock, std::chrono::nanoseconds(wake_time - now));
+			}
+			if (!p_m2svideosink->keepalive_running)
+			{
+				break;
 			}
-			ret = GST_FLOW_ERROR;
-			goto UNMAP;
 		}
 
-		ret = GST_FLOW_OK;
+		if (ready && (m2s_get_current_tai_ns() >= wake_time))
+		{
+			insert_keepalive_m2s(p_m2svideosink, align_time);
+		}
+	}
+}
 
-	  UNMAP:
+static void start_keepalive_thread(GstM2svideosink *p_m2svideosink)
+{
+	p_m2svideosink->keepalive_running = true;
+	p_m2svideosink->p_keepalive_thread = new std::thread(&keepalive_thread_main, p_m2svideosink);
+}
+
+static void stop_keepalive_thread(GstM2svideosink *p_m2svideosink)
+{
+	if (p_m2svideosink->p_keepalive_thread == nullptr)
+	{
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(p_m2svideosink->keepalive_lock);
+		p_m2svideosink->keepalive_running = false;
+		p_m2svideosink->keepalive_cond.notify_all();
+	}
+	p_m2svideosink->p_keepalive_thread->join();
+	delete p_m2svideosink->p_keepalive_thread;
+	p_m2svideosink->p_keepalive_thread = nullptr;
+}
+
+// A frame starts with the field the scan sends first, top for TFF and bottom
+// for BFF, and takes one field of each parity. A field without parity or a
+// second field without its first is dropped; a field of a parity already
+// woven means the other one was lost, and the frame restarts. Returns false
+// if the field is not woven.
+static bool weave_start_m2s (GstM2svideosink *p_m2svideosink, GstBuffer *buf)
+{
+	bool bottom = GST_VIDEO_BUFFER_IS_BOTTOM_FIELD(buf);
+	bool first_bottom = (p_m2svideosink->scan == M2S_VIDEO_SCAN_INTERLACE_BFF);
+
+	if (!bottom && !GST_VIDEO_BUFFER_IS_TOP_FIELD(buf))
+	{
+		GST_WARNING_OBJECT (p_m2svideosink, "field without parity, dropped");
+		return false;
+	}
+
+	if ((p_m2svideosink->weave_fields & (bottom ? 2 : 1)) != 0)
+	{
+		GST_DEBUG_OBJECT (p_m2svideosink, "second %s field in a row, restarting the frame", bottom ? "bottom" : "top");
+		p_m2svideosink->weave_fields = 0;
+	}
+
+	if (p_m2svideosink->weave_fields == 0)
+	{
+		if (bottom != first_bottom)
+		{
+			GST_DEBUG_OBJECT (p_m2svideosink, "%s field without its first field, dropped", bottom ? "bottom" : "top");
+			return false;
+		}
+		// the frame is due with its first field
+		p_m2svideosink->weave_pts = GST_BUFFER_PTS(buf);
+	}
+
+	return true;
+}
+
+// Copy one field of an interlace-mode=alternate stream into every other line
+// of the weave frame.
+static bool weave_field_m2s (GstM2svideosink *p_m2svideosink, GstBuffer *buf)
+{
+	GstVideoInfo *p_frame_info = &p_m2svideosink->frame_info;
+	bool bottom = GST_VIDEO_BUFFER_IS_BOTTOM_FIELD(buf);
+	GstVideoFrame field;
+	uint8_t *p_src;
+	uint8_t *p_dst;
+	gint src_stride;
+	gint dst_stride;
+	gint line_size;
+	guint plane;
+	gint y;
+
+	if (!gst_video_frame_map(&field, &p_m2svideosink->info, buf, GST_MAP_READ))
+	{
+		return false;
+	}
+
+	for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES(&field); plane++)
+	{
+		p_src = (uint8_t *)GST_VIDEO_FRAME_PLANE_DATA(&field, plane);
+		src_stride = GST_VIDEO_FRAME_PLANE_STRIDE(&field, plane);
+		p_dst = p_m2svideosink->p_weave + GST_VIDEO_INFO_PLANE_OFFSET(p_frame_info, plane) +
+			(bottom ? GST_VIDEO_INFO_PLANE_STRIDE(p_frame_info, plane) : 0);
+		dst_stride = GST_VIDEO_INFO_PLANE_STRIDE(p_frame_info, plane) * 2;
+		line_size = MIN(src_stride, GST_VIDEO_INFO_PLANE_STRIDE(p_frame_info, plane));
+
+		for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT(&field, plane); y++)
+		{
+			memcpy(p_dst + y * dst_stride, p_src + y * src_stride, line_size);
+		}
+	}
+	gst_video_frame_unmap(&field);
+
+	p_m2svideosink->weave_fields |= bottom ? 2 : 1;
+
+	return true;
+}
+
+// Pre-roll: m2s cannot take frames before m2s_start(), so the first
+// preroll_frames frames after caps, a flush or a pause are held here and then
+// written back to back. TX starts with that many frames queued in m2s, on the
+// alignment point computed for the first of them, and a short tx-delay-ms
+// no longer underflows while upstream gets up to speed.
+static GstFlowReturn flush_preroll_m2s (GstM2svideosink *p_m2svideosink)
+{
+	GstFlowReturn ret = GST_FLOW_OK;
+	GstBuffer *p_buffer;
+
+	p_m2svideosink->preroll_done = true;
+	while ((p_buffer = (GstBuffer *)g_queue_pop_head(&p_m2svideosink->preroll_queue)) != NULL)
+	{
+		if (ret == GST_FLOW_OK)
+		{
+			ret = render_frame_m2s(p_m2svideosink, p_buffer);
+		}
+		gst_buffer_unref(p_buffer);
+	}
+
+	return ret;
+}
+
+static void clear_preroll_m2s (GstM2svideosink *p_m2svideosink)
+{
+	GstBuffer *p_buffer;
+
+	while ((p_buffer = (GstBuffer *)g_queue_pop_head(&p_m2svideosink->preroll_queue)) != NULL)
+	{
+		gst_buffer_unref(p_buffer);
+	}
+	p_m2svideosink->preroll_done = false;
+}
+
+// Weave or map the buffer and write it, on the streaming thread or, in
+// async-tx mode, on the TX thread.
+static GstFlowReturn render_frame_m2s (GstM2svideosink *p_m2svideosink, GstBuffer *buf)
+{
+	GstFlowReturn ret;
+	GstMapInfo info;
+
+	if (!p_m2svideosink->preroll_done && (p_m2svideosink->preroll_frames > 0))
+	{
+		g_queue_push_tail(&p_m2svideosink->preroll_queue, gst_buffer_ref(buf));
+		// alternate input counts fields
+		if (g_queue_get_length(&p_m2svideosink->preroll_queue) <
+			p_m2svideosink->preroll_frames * ((p_m2svideosink->p_weave != NULL) ? 2 : 1))
+		{
+			return GST_FLOW_OK;
+		}
+		return flush_preroll_m2s(p_m2svideosink);
+	}
+
+	if (p_m2svideosink->p_weave != NULL)
+	{
+		if (!weave_start_m2s(p_m2svideosink, buf))
+		{
+			return GST_FLOW_OK;
+		}
+		if (!weave_field_m2s(p_m2svideosink, buf))
+		{
+			return GST_FLOW_ERROR;
+		}
+		if (p_m2svideosink->weave_fields != 3)
+		{
+			return GST_FLOW_OK;
+		}
+		p_m2svideosink->weave_fields = 0;
+
+		return write_frame_m2s(p_m2svideosink, p_m2svideosink->p_weave,
+		                       GST_VIDEO_INFO_SIZE(&p_m2svideosink->frame_info), p_m2svideosink->weave_pts);
+	}
+
+	if (gst_buffer_map(buf, &info, GST_MAP_READ))
+	{
+		ret = write_frame_m2s(p_m2svideosink, &info.data[0], info.size, GST_BUFFER_PTS(buf));
 		gst_buffer_unmap(buf, &info);
 	}
 	else
@@ -920,9 +2300,48 @@ gst_m2svideosink_show_frame (GstVideoSink * sink, GstBuffer * buf)
 		ret = GST_FLOW_ERROR;
 	}
 
+	// kept by reference for keep-alive, the weave buffer is refilled in place
+	// and keep-alive sends the slate for alternate input instead
+	if ((ret == GST_FLOW_OK) && (p_m2svideosink->keepalive == GST_M2SVIDEOSINK_KEEPALIVE_LAST))
+	{
+		std::lock_guard<std::mutex> lock(p_m2svideosink->write_lock);
+		gst_buffer_replace (&p_m2svideosink->p_keepalive_last, buf);
+	}
+
 	return ret;
 }
 
+// In async-tx mode the preroll buffer is never queued, even with
+// show-preroll-frame turned on: render queues it in PLAYING, and a second
+// entry in the ring would send it twice and shift the cadence by one slot.
+static GstFlowReturn
+gst_m2svideosink_preroll (GstBaseSink * p_bsink, GstBuffer * buf)
+{
+	GstM2svideosink *p_m2svideosink = GST_M2SVIDEOSINK (p_bsink);
+
+	if (p_m2svideosink->p_tx_thread != nullptr)
+	{
+		return GST_FLOW_OK;
+	}
+
+	return GST_BASE_SINK_CLASS (gst_m2svideosink_parent_class)->preroll (p_bsink, buf);
+}
+
+static GstFlowReturn
+gst_m2svideosink_show_frame (GstVideoSink * sink, GstBuffer * buf)
+{
+	GstM2svideosink *p_m2svideosink = GST_M2SVIDEOSINK (sink);
+
+	GST_DEBUG_OBJECT (p_m2svideosink, "show_frame");
+
+	if (p_m2svideosink->p_tx_thread != nullptr)
+	{
+		return push_tx_m2s(p_m2svideosink, buf);
+	}
+
+	return render_frame_m2s(p_m2svideosink, buf);
+}
+
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
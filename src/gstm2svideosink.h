@@ -35,6 +35,22 @@ G_BEGIN_DECLS
 #define GST_IS_M2SVIDEOSINK_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_M2SVIDEOSINK))
 
 typedef struct _GstM2svideosink GstM2svideosink;
+
+typedef enum {
+	GST_M2SVIDEOSINK_TX_OVERFLOW_BLOCK,
+	GST_M2SVIDEOSINK_TX_OVERFLOW_DROP,
+} GstM2svideosinkTxOverflowPolicy;
+
+typedef enum {
+	GST_M2SVIDEOSINK_TX_SCHEDULE_COUNTER,
+	GST_M2SVIDEOSINK_TX_SCHEDULE_PTS,
+} GstM2svideosinkTxSchedule;
+
+typedef enum {
+	GST_M2SVIDEOSINK_KEEPALIVE_OFF,
+	GST_M2SVIDEOSINK_KEEPALIVE_LAST,
+	GST_M2SVIDEOSINK_KEEPALIVE_SLATE,
+} GstM2svideosinkKeepalive;
 typedef struct _GstM2svideosinkClass GstM2svideosinkClass;
 
 struct _GstM2svideosink
@@ -64,11 +80,72 @@ struct _GstM2svideosink
 	uint8_t box_size;
 	bool gpudirect;
 	int32_t tx_delay_ms;
+	bool hugepage_pool;
+	GstAllocator *p_hugepage_allocator;   /* backs the pool proposed upstream */
+
+	/* asynchronous TX */
+	bool async_tx;
+	uint32_t tx_ring_depth;
+	GstM2svideosinkTxOverflowPolicy tx_overflow_policy;
+	std::thread *p_tx_thread;
+	GstBuffer **p_tx_ring;                /* tx_ring_size slots, one always free */
+	guint tx_ring_size;
+	guint tx_head;                        /* next slot written by show_frame */
+	guint tx_tail;                        /* next slot read by the TX thread */
+	gint tx_flow_ret;                     /* last write error of the TX thread */
+	std::mutex tx_lock;                   /* only to sleep and wake, see push_tx_m2s() */
+	std::condition_variable tx_cond;
+	bool tx_running;                      /* protected by tx_lock */
+	bool tx_flushing;                     /* protected by tx_lock, queued frames are dropped */
+	bool tx_unlocked;                     /* protected by tx_lock, show_frame does not wait */
+	bool tx_paused;                       /* protected by tx_lock, m2s is stopped */
+	bool tx_busy;                         /* protected by tx_lock, a frame is being written */
+	guint64 tx_dropped;
 
 	bool done_first_set_contents;
 	uint64_t start_time;
+	int32_t start_time_offset_ns;          /* TR offset of the current caps */
 	uint64_t frame_offset;
 	m2s_frame_rate_t m2s_frame_rate;
+
+	/* PTS-anchored scheduling */
+	GstM2svideosinkTxSchedule tx_schedule;
+	bool pts_anchor_valid;
+	uint64_t pts_anchor_tai;              /* alignment point of pts_anchor_rt */
+	GstClockTime pts_anchor_rt;
+	GstClockTime pts_anchor_clock;        /* pipeline clock when the anchor was taken */
+	uint64_t pts_anchor_clock_tai;        /* TAI when the anchor was taken */
+	uint64_t last_align_time;             /* alignment point of the last frame written */
+	guint64 schedule_dropped;
+
+	/* late frame dropping */
+	bool drop_late;
+	uint32_t min_lead_us;
+	guint64 qos_processed;
+	guint64 late_dropped;
+
+	/* keep-alive during upstream stalls */
+	GstM2svideosinkKeepalive keepalive;
+	std::thread *p_keepalive_thread;
+	std::mutex keepalive_lock;
+	std::condition_variable keepalive_cond;
+	bool keepalive_running;
+	std::mutex write_lock;                /* m2s_write() from show_frame and keep-alive */
+	GstBuffer *p_slate;                   /* protected by write_lock */
+	GstBuffer *p_keepalive_last;          /* protected by write_lock */
+	bool keepalive_resync;                /* keep-alive wrote the last slot */
+	guint64 keepalive_inserted;
+
+	/* TX pre-roll */
+	uint32_t preroll_frames;
+	GQueue preroll_queue;                 /* frames held until preroll_frames are there */
+	bool preroll_done;
+
+	/* interlace-mode=alternate input */
+	GstVideoInfo frame_info;
+	uint8_t *p_weave;
+	uint8_t weave_fields;
+	GstClockTime weave_pts;               /* timestamp of the first field */
 };
 
 struct _GstM2svideosinkClass
@@ -30,6 +30,8 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <map>
+#include <tuple>
 #include <m2s_api.h>
 
 #ifdef HAVE_CONFIG_H
@@ -38,6 +40,8 @@
 #include <gst/gst.h>
 #include <gst/base/gstpushsrc.h>
 #include <gst/video/gstvideometa.h>
+#include <gstm2sclock.h>
+#include <gstm2srxmeta.h>
 #include "gstm2svideosrc.h"
 
 #define DBG_MSG(format, args...) printf("[m2svideosrc] " format, ## args)
@@ -76,6 +80,36 @@ GST_DEBUG_CATEGORY_STATIC (m2svideosrc_debug);
 #define DEFAULT_FIFO_OVER_THRESHOLD      (6)
 #define DEFAULT_UNDER_COUNT_MAX          (60)
 #define DEFAULT_GPUDIRECT                (FALSE)
+#define DEFAULT_ZERO_COPY                (FALSE)
+#define DEFAULT_ZERO_COPY_MAX_LEASES     (4)
+#define DEFAULT_READ_SELECT              (FALSE)
+#define DEFAULT_ADAPTIVE_FIFO            (FALSE)
+#define DEFAULT_ADAPTIVE_WINDOW          (300)
+#define DEFAULT_UNDERFLOW_POLICY         GST_M2SVIDEOSRC_UNDERFLOW_POLICY_BLACK
+#define DEFAULT_RTP_TIMESTAMP_PTS        (FALSE)
+#define DEFAULT_FIELD_OUTPUT             (FALSE)
+#define DEFAULT_QOS                      (FALSE)
+#define DEFAULT_GENLOCK                  (FALSE)
+#define DEFAULT_GENLOCK_OFFSET           (0)
+#define DEFAULT_FRAME_SYNC               GST_M2SVIDEOSRC_FRAME_SYNC_OFF
+#define DEFAULT_CROP_X                   (0)
+#define DEFAULT_CROP_Y                   (0)
+#define DEFAULT_CROP_WIDTH               (0)
+#define DEFAULT_CROP_HEIGHT              (0)
+#define DEFAULT_INPUT_RESOLUTION         GST_M2SVIDEOSRC_INPUT_RESOLUTION_AUTO
+#define DEFAULT_AUTO_CAPS                (FALSE)
+#define DEFAULT_PROBE_TIMEOUT_MS         (1000)
+
+// RTP timestamps further than this from the previous one restart the unwrapping
+#define RTP_UNWRAP_RESYNC_NS             (GST_SECOND)
+// frames in a row with a size error before auto-caps looks for a new format
+#define FORMAT_CHANGE_FRAMES             (3)
+// how often a probe looks for a frame
+#define PROBE_POLL_INTERVAL_MS           (1)
+// how long a stop waits for downstream to release the frames it holds
+#define LEASE_DRAIN_TIMEOUT_MS           (100)
+// how often a wait for a returned frame looks for a flush
+#define LEASE_WAIT_INTERVAL_MS           (10)
 
 enum
 {
@@ -110,21 +144,75 @@ enum
 	PROP_FIFO_OVER_THRESHOLD,
 	PROP_UNDER_COUNT_MAX,
 	PROP_GPUDIRECT,
+	PROP_ZERO_COPY,
+	PROP_ZERO_COPY_MAX_LEASES,
+	PROP_READ_SELECT,
+	PROP_ADAPTIVE_FIFO,
+	PROP_ADAPTIVE_WINDOW,
+	PROP_ADAPTIVE_TARGET,
+	PROP_ADAPTIVE_DROPPED,
+	PROP_ADAPTIVE_REPEATED,
+	PROP_UNDERFLOW_POLICY,
+	PROP_RTP_TIMESTAMP_PTS,
+	PROP_FIELD_OUTPUT,
+	PROP_QOS,
+	PROP_QOS_DROPPED,
+	PROP_GENLOCK,
+	PROP_GENLOCK_OFFSET,
+	PROP_FRAME_SYNC,
+	PROP_FRAME_SYNC_DROPPED,
+	PROP_FRAME_SYNC_REPEATED,
+	PROP_CROP_X,
+	PROP_CROP_Y,
+	PROP_CROP_WIDTH,
+	PROP_CROP_HEIGHT,
+	PROP_INPUT_RESOLUTION,
+	PROP_AUTO_CAPS,
+	PROP_PROBE_TIMEOUT_MS,
+	PROP_LAST_SWITCH_TIME,
 	PROP_LAST
 };
 
+enum
+{
+	SIGNAL_SWITCH_SOURCE,
+	LAST_SIGNAL
+};
+
+static guint gst_m2svideosrc_signals[LAST_SIGNAL] = { 0 };
 
-#define VTS_VIDEO_CAPS GST_VIDEO_CAPS_MAKE ("{ UYVP, UYVY, I420, v210, BGRx }") "," \
+
+#define VTS_VIDEO_FORMATS "{ UYVP, UYVY, I420, v210, BGRx }"
+
+#define VTS_VIDEO_CAPS GST_VIDEO_CAPS_MAKE (VTS_VIDEO_FORMATS) "," \
   "width = " GST_VIDEO_SIZE_RANGE ", "                                 \
   "height = " GST_VIDEO_SIZE_RANGE ", "                                \
   "framerate = " GST_VIDEO_FPS_RANGE
 
+/* one field per buffer, see field-output */
+#define VTS_VIDEO_FIELD_CAPS \
+  GST_VIDEO_CAPS_MAKE_WITH_FEATURES (GST_CAPS_FEATURE_FORMAT_INTERLACED, VTS_VIDEO_FORMATS) "," \
+  "width = " GST_VIDEO_SIZE_RANGE ", "                                 \
+  "height = " GST_VIDEO_SIZE_RANGE ", "                                \
+  "framerate = " GST_VIDEO_FPS_RANGE ", "                              \
+  "interlace-mode = (string) alternate"
+
+
+/* what m2s can receive, any window of it can be output with crop-* */
+#define M2S_VIDEO_RATES "framerate = { (fraction) 60000/1001, (fraction) 30000/1001, (fraction) 50/1, (fraction) 25/1 }"
+
+static GstStaticCaps m2s_supported_caps = GST_STATIC_CAPS (
+	"video/x-raw(ANY), width = (int) 1920, height = (int) 1080, " M2S_VIDEO_RATES "; "
+	"video/x-raw(ANY), width = (int) 3840, height = (int) 2160, " M2S_VIDEO_RATES);
+static GstStaticCaps m2s_rate_caps = GST_STATIC_CAPS ("video/x-raw(ANY), " M2S_VIDEO_RATES);
+
+static GstStaticCaps tai_caps = GST_STATIC_CAPS ("timestamp/x-tai");
 
 static GstStaticPadTemplate gst_m2svideosrc_template =
 GST_STATIC_PAD_TEMPLATE ("src",
 	GST_PAD_SRC,
 	GST_PAD_ALWAYS,
-	GST_STATIC_CAPS (VTS_VIDEO_CAPS)
+	GST_STATIC_CAPS (VTS_VIDEO_CAPS "; " VTS_VIDEO_FIELD_CAPS)
 	);
 
 #define gst_m2svideosrc_parent_class parent_class
@@ -147,6 +235,54 @@ static GType gst_m2s_video_src_rtp_format_get_type (void)
 	return m2s_video_src_rtp_format;
 }
 
+#define GST_TYPE_M2S_VIDEO_SRC_UNDERFLOW_POLICY (gst_m2s_video_src_underflow_policy_get_type ())
+static GType gst_m2s_video_src_underflow_policy_get_type (void)
+{
+	static GType m2s_video_src_underflow_policy = 0;
+	if (!m2s_video_src_underflow_policy) {
+		static const GEnumValue underflow_policies[] = {
+			{GST_M2SVIDEOSRC_UNDERFLOW_POLICY_BLACK, "Output a black frame", "black"},
+			{GST_M2SVIDEOSRC_UNDERFLOW_POLICY_REPEAT_LAST, "Repeat the last frame without copying", "repeat-last"},
+			{GST_M2SVIDEOSRC_UNDERFLOW_POLICY_GAP, "Output a GAP flagged buffer", "gap"},
+			{0, NULL, NULL},
+		};
+		m2s_video_src_underflow_policy = g_enum_register_static ("GstM2sVideoSrcUnderflowPolicy", underflow_policies);
+	}
+	return m2s_video_src_underflow_policy;
+}
+
+#define GST_TYPE_M2S_VIDEO_SRC_FRAME_SYNC (gst_m2s_video_src_frame_sync_get_type ())
+static GType gst_m2s_video_src_frame_sync_get_type (void)
+{
+	static GType m2s_video_src_frame_sync = 0;
+	if (!m2s_video_src_frame_sync) {
+		static const GEnumValue frame_sync_modes[] = {
+			{GST_M2SVIDEOSRC_FRAME_SYNC_OFF, "Follow the FIFO depth", "off"},
+			{GST_M2SVIDEOSRC_FRAME_SYNC_ON, "Output at the local frame cadence", "on"},
+			{GST_M2SVIDEOSRC_FRAME_SYNC_AUTO, "Output at the local frame cadence while the stream is asynchronous", "auto"},
+			{0, NULL, NULL},
+		};
+		m2s_video_src_frame_sync = g_enum_register_static ("GstM2sVideoSrcFrameSync", frame_sync_modes);
+	}
+	return m2s_video_src_frame_sync;
+}
+
+#define GST_TYPE_M2S_VIDEO_SRC_INPUT_RESOLUTION (gst_m2s_video_src_input_resolution_get_type ())
+static GType gst_m2s_video_src_input_resolution_get_type (void)
+{
+	static GType m2s_video_src_input_resolution = 0;
+	if (!m2s_video_src_input_resolution) {
+		static const GEnumValue input_resolutions[] = {
+			{GST_M2SVIDEOSRC_INPUT_RESOLUTION_AUTO, "Detected size, cropping needs a detected stream", "auto"},
+			{GST_M2SVIDEOSRC_INPUT_RESOLUTION_1920x1080, "1920x1080", "1080"},
+			{GST_M2SVIDEOSRC_INPUT_RESOLUTION_3840x2160, "3840x2160", "2160"},
+			{0, NULL, NULL},
+		};
+		m2s_video_src_input_resolution = g_enum_register_static ("GstM2sVideoSrcInputResolution", input_resolutions);
+	}
+	return m2s_video_src_input_resolution;
+}
+
 static void gst_m2svideosrc_set_hw_hitless (GstM2svideosrc *m2svideosrc, bool hw_hitless);
 static void gst_m2svideosrc_set_gpu_num (GstM2svideosrc *m2svideosrc, uint8_t gpu_num);
 static void gst_m2svideosrc_set_l2_cpu_num (GstM2svideosrc *m2svideosrc, int32_t cpu_num);
@@ -175,7 +311,27 @@ static void gst_m2svideosrc_set_fifo_middle (GstM2svideosrc *m2svideosrc, uint8_
 static void gst_m2svideosrc_set_fifo_over_threshold (GstM2svideosrc *m2svideosrc, uint8_t fifo_over_threshold);
 static void gst_m2svideosrc_set_under_count_max (GstM2svideosrc *m2svideosrc, uint8_t under_count_max);
 static void gst_m2svideosrc_set_gpudirect (GstM2svideosrc *m2svideosrc, bool gpudirect);
-
+static void gst_m2svideosrc_set_zero_copy (GstM2svideosrc *m2svideosrc, bool zero_copy);
+static void gst_m2svideosrc_set_zero_copy_max_leases (GstM2svideosrc *m2svideosrc, uint8_t max_leases);
+static void gst_m2svideosrc_set_read_select (GstM2svideosrc *m2svideosrc, bool read_select);
+static void gst_m2svideosrc_set_adaptive_fifo (GstM2svideosrc *m2svideosrc, bool adaptive_fifo);
+static void gst_m2svideosrc_set_adaptive_window (GstM2svideosrc *m2svideosrc, uint32_t window);
+static void gst_m2svideosrc_set_underflow_policy (GstM2svideosrc *m2svideosrc, GstM2svideosrcUnderflowPolicy policy);
+static void gst_m2svideosrc_set_rtp_timestamp_pts (GstM2svideosrc *m2svideosrc, bool rtp_timestamp_pts);
+static void gst_m2svideosrc_set_field_output (GstM2svideosrc *m2svideosrc, bool field_output);
+static void gst_m2svideosrc_set_qos (GstM2svideosrc *m2svideosrc, bool qos);
+static void gst_m2svideosrc_set_genlock (GstM2svideosrc *m2svideosrc, bool genlock);
+static void gst_m2svideosrc_set_genlock_offset (GstM2svideosrc *m2svideosrc, guint64 offset);
+static void gst_m2svideosrc_set_frame_sync (GstM2svideosrc *m2svideosrc, GstM2svideosrcFrameSync frame_sync);
+static void gst_m2svideosrc_set_crop_x (GstM2svideosrc *m2svideosrc, guint crop_x);
+static void gst_m2svideosrc_set_crop_y (GstM2svideosrc *m2svideosrc, guint crop_y);
+static void gst_m2svideosrc_set_crop_width (GstM2svideosrc *m2svideosrc, guint crop_width);
+static void gst_m2svideosrc_set_crop_height (GstM2svideosrc *m2svideosrc, guint crop_height);
+static void gst_m2svideosrc_set_input_resolution (GstM2svideosrc *m2svideosrc, GstM2svideosrcInputResolution input_resolution);
+static void gst_m2svideosrc_set_auto_caps (GstM2svideosrc *m2svideosrc, bool auto_caps);
+static void gst_m2svideosrc_set_probe_timeout_ms (GstM2svideosrc *m2svideosrc, uint32_t timeout_ms);
+
+static void gst_m2svideosrc_finalize (GObject * object);
 static void gst_m2svideosrc_set_property (GObject * object, guint prop_id,
                                           const GValue * value, GParamSpec * pspec);
 static void gst_m2svideosrc_get_property (GObject * object, guint prop_id,
@@ -183,8 +339,10 @@ static void gst_m2svideosrc_get_property (GObject * object, guint prop_id,
 
 static GstStateChangeReturn gst_m2svideosrc_change_state (GstElement * element,
                                                           GstStateChange transition);
+static GstClock *gst_m2svideosrc_provide_clock (GstElement * element);
 
 static gboolean gst_m2svideosrc_setcaps (GstBaseSrc * bsrc, GstCaps * caps);
+static GstCaps *gst_m2svideosrc_get_caps (GstBaseSrc * bsrc, GstCaps * filter);
 static GstCaps *gst_m2svideosrc_src_fixate (GstBaseSrc * bsrc,
                                             GstCaps * caps);
 
@@ -192,15 +350,23 @@ static gboolean gst_m2svideosrc_is_seekable (GstBaseSrc * psrc);
 static gboolean gst_m2svideosrc_do_seek (GstBaseSrc * bsrc,
                                          GstSegment * segment);
 static gboolean gst_m2svideosrc_query (GstBaseSrc * bsrc, GstQuery * query);
+static gboolean gst_m2svideosrc_event (GstBaseSrc * bsrc, GstEvent * event);
 
 static void gst_m2svideosrc_get_times (GstBaseSrc * basesrc,
                                        GstBuffer * buffer, GstClockTime * start, GstClockTime * end);
 static gboolean gst_m2svideosrc_decide_allocation (GstBaseSrc * bsrc,
                                                    GstQuery * query);
-static GstFlowReturn gst_m2svideosrc_fill (GstPushSrc * psrc,
-                                           GstBuffer * buffer);
+static GstFlowReturn gst_m2svideosrc_create (GstPushSrc * psrc,
+                                             GstBuffer ** p_buffer);
 static gboolean gst_m2svideosrc_start (GstBaseSrc * basesrc);
 static gboolean gst_m2svideosrc_stop (GstBaseSrc * basesrc);
+static gboolean gst_m2svideosrc_unlock (GstBaseSrc * basesrc);
+static gboolean gst_m2svideosrc_unlock_stop (GstBaseSrc * basesrc);
+
+static void probe_m2s (GstM2svideosrc *p_m2svideosrc);
+static void resume_m2s (GstM2svideosrc *p_m2svideosrc);
+static gboolean gst_m2svideosrc_switch_source (GstM2svideosrc * src,
+                                               const gchar * p_dst_address, const gchar * s_dst_address);
 
 
 
@@ -299,6 +465,319 @@ static void stop_monitoring_timer(GstM2svideosrc *p_m2svideosrc)
 	delete p_m2svideosrc->p_mon_thread;
 }
 
+// Leases still held downstream when their stream is given up. The stream is
+// only deleted once the last of them is released, and then on the streaming
+// thread, see reclaim_leases_m2s().
+typedef struct
+{
+	m2s_strm_id_t strm_id;
+	guint count;
+} GstM2svideosrcOrphans;
+
+struct _GstM2svideosrcLease
+{
+	GstM2svideosrc *p_m2svideosrc;
+	uint8_t *p_frame;
+	uint32_t frame_size;
+	uint64_t capture_tai;                 /* unwrapped RTP timestamp in TAI ns */
+	uint32_t rtp_timestamp;
+	m2s_read_status_t read_status;        /* packets of this frame */
+	guint64 seq;
+	gint ref_count;
+	bool released;
+	GstM2svideosrcOrphans *p_orphans;     /* set once detached from the stream */
+};
+
+// The 90kHz RTP timestamp wraps every ~13 hours. Extend it from the previous
+// frame and only go back to m2s_conv_rtptime_to_tai() on the first frame or
+// after a jump in the stream.
+static uint64_t unwrap_rtp_timestamp_m2s(GstM2svideosrc *p_m2svideosrc, uint32_t rtp_timestamp)
+{
+	int32_t delta = (int32_t)(rtp_timestamp - p_m2svideosrc->last_rtp_timestamp);
+	int64_t delta_ns = (delta < 0) ?
+		-(int64_t)gst_util_uint64_scale(-(int64_t)delta, GST_SECOND, M2S_RTP_COUNTER_FREQ_90KHZ) :
+		(int64_t)gst_util_uint64_scale(delta, GST_SECOND, M2S_RTP_COUNTER_FREQ_90KHZ);
+
+	if (!p_m2svideosrc->rtp_unwrap_valid || (ABS(delta_ns) > (int64_t)RTP_UNWRAP_RESYNC_NS))
+	{
+		p_m2svideosrc->last_capture_tai = m2s_conv_rtptime_to_tai(rtp_timestamp, M2S_RTP_COUNTER_FREQ_90KHZ);
+		p_m2svideosrc->rtp_unwrap_valid = true;
+	}
+	else
+	{
+		p_m2svideosrc->last_capture_tai += delta_ns;
+	}
+	p_m2svideosrc->last_rtp_timestamp = rtp_timestamp;
+
+	return p_m2svideosrc->last_capture_tai;
+}
+
+// Delete the streams given up earlier whose frames downstream has all released
+static void delete_dead_streams_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	GstM2svideosrcOrphans *p_orphans;
+
+	while (1)
+	{
+		g_mutex_lock(&p_m2svideosrc->lease_lock);
+		p_orphans = (GstM2svideosrcOrphans *)g_queue_pop_head(&p_m2svideosrc->dead_streams);
+		g_mutex_unlock(&p_m2svideosrc->lease_lock);
+		if (p_orphans == nullptr)
+		{
+			break;
+		}
+		GST_DEBUG_OBJECT (p_m2svideosrc, "last frame of a given up stream released, deleting it");
+		m2s_delete(p_orphans->strm_id);
+		g_free(p_orphans);
+	}
+}
+
+// m2s_free_read_ptr() always returns the oldest read pointer, so a lease that is
+// dropped out of order is only marked released, and freed here once all older
+// leases are done. Only the streaming thread, or the state change thread while
+// streaming is stopped, calls this, so m2s_free_read_ptr() never runs alongside
+// m2s_get_read_ptr() on the same stream.
+static void reclaim_leases_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	GstM2svideosrcLease *p_lease;
+
+	g_mutex_lock(&p_m2svideosrc->lease_lock);
+	while (((p_lease = (GstM2svideosrcLease *)g_queue_peek_head(&p_m2svideosrc->leases)) != nullptr) &&
+		   p_lease->released)
+	{
+		g_queue_pop_head(&p_m2svideosrc->leases);
+		g_free(p_lease);
+		m2s_free_read_ptr(p_m2svideosrc->strm_id);
+	}
+	g_mutex_unlock(&p_m2svideosrc->lease_lock);
+
+	delete_dead_streams_m2s(p_m2svideosrc);
+}
+
+static GstM2svideosrcLease *acquire_lease_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	GstM2svideosrcLease *p_lease;
+	m2s_media_t media;
+	m2s_media_size_t size;
+	m2s_read_status_t read_status;
+	uint32_t rtp_timestamp;
+
+	reclaim_leases_m2s(p_m2svideosrc);
+
+	if (m2s_get_read_ptr_with_status(p_m2svideosrc->strm_id, &rtp_timestamp, &media, &size, &read_status) != M2S_RET_SUCCESS)
+	{
+		return nullptr;
+	}
+
+	p_lease = g_new0(GstM2svideosrcLease, 1);
+	p_lease->p_m2svideosrc = (GstM2svideosrc *)gst_object_ref(p_m2svideosrc);
+	p_lease->p_frame = media.video.p_frame;
+	p_lease->frame_size = size.video.frame_size;
+	p_lease->capture_tai = unwrap_rtp_timestamp_m2s(p_m2svideosrc, rtp_timestamp);
+	p_lease->rtp_timestamp = rtp_timestamp;
+	p_lease->read_status = read_status;
+	p_lease->seq = ++p_m2svideosrc->lease_seq;
+	p_lease->ref_count = 1;
+
+	g_mutex_lock(&p_m2svideosrc->lease_lock);
+	g_queue_push_tail(&p_m2svideosrc->leases, p_lease);
+	g_mutex_unlock(&p_m2svideosrc->lease_lock);
+
+	return p_lease;
+}
+
+// Also the GDestroyNotify of wrapped buffers, so this runs on any thread and
+// never calls into m2s itself.
+static void release_lease_m2s(GstM2svideosrcLease *p_lease)
+{
+	GstM2svideosrc *p_m2svideosrc = p_lease->p_m2svideosrc;
+	GstM2svideosrcOrphans *p_orphans;
+
+	if (!g_atomic_int_dec_and_test(&p_lease->ref_count))
+	{
+		return;
+	}
+
+	g_mutex_lock(&p_m2svideosrc->lease_lock);
+	p_orphans = p_lease->p_orphans;
+	if (p_orphans == nullptr)
+	{
+		p_lease->released = true;
+		g_cond_broadcast(&p_m2svideosrc->lease_cond);
+	}
+	else
+	{
+		g_free(p_lease);
+		if (--p_orphans->count == 0)
+		{
+			g_queue_push_tail(&p_m2svideosrc->dead_streams, p_orphans);
+		}
+	}
+	g_mutex_unlock(&p_m2svideosrc->lease_lock);
+
+	gst_object_unref(p_m2svideosrc);
+}
+
+static guint held_leases_locked_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	GList *p_link;
+	guint held = 0;
+
+	for (p_link = p_m2svideosrc->leases.head; p_link != nullptr; p_link = p_link->next)
+	{
+		held += ((GstM2svideosrcLease *)p_link->data)->released ? 0 : 1;
+	}
+	return held;
+}
+
+// Instead of m2s_delete(): take the leases out of the stream's free order.
+// Leases still held downstream are freed on their own, and since their frame
+// memory belongs to the stream, it is deleted after the last of them. Returns
+// false if no lease is held any more and the stream can go now.
+static bool detach_leases_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	GstM2svideosrcOrphans *p_orphans;
+	GstM2svideosrcLease *p_lease;
+	guint held;
+
+	g_mutex_lock(&p_m2svideosrc->lease_lock);
+	held = held_leases_locked_m2s(p_m2svideosrc);
+
+	p_orphans = nullptr;
+	if (held > 0)
+	{
+		p_orphans = g_new0(GstM2svideosrcOrphans, 1);
+		p_orphans->strm_id = p_m2svideosrc->strm_id;
+		p_orphans->count = held;
+		GST_DEBUG_OBJECT (p_m2svideosrc, "%u frames still held downstream, deleting the stream after them", held);
+	}
+
+	while ((p_lease = (GstM2svideosrcLease *)g_queue_pop_head(&p_m2svideosrc->leases)) != nullptr)
+	{
+		if (p_lease->released)
+		{
+			g_free(p_lease);
+		}
+		else
+		{
+			p_lease->p_orphans = p_orphans;
+		}
+	}
+	g_mutex_unlock(&p_m2svideosrc->lease_lock);
+
+	return p_orphans != nullptr;
+}
+
+static void create_stream_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	m2s_cpu_affinity_t cpu_affinity;
+
+	cpu_affinity.rx.l2_num = p_m2svideosrc->l2_cpu_num;
+	cpu_affinity.rx.l1_num = p_m2svideosrc->l1_cpu_num;
+	m2s_create(&p_m2svideosrc->strm_id, M2S_IO_TYPE_RX, M2S_MEDIA_TYPE_VIDEO, M2S_MEMORY_MODE_CPU, &cpu_affinity, NULL, p_m2svideosrc->hw_hitless);
+}
+
+// Before the stopped stream is started again, which lets m2s reuse its frame
+// memory. Frames downstream still holds would be overwritten, so the stream is
+// then given up to them and a new one created, which the caller configures.
+// Streaming thread, or the state change thread while streaming waits.
+// Returns true if the stream was renewed.
+static bool renew_stream_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	reclaim_leases_m2s(p_m2svideosrc);
+	if (!detach_leases_m2s(p_m2svideosrc))
+	{
+		return false;
+	}
+
+	GST_DEBUG_OBJECT (p_m2svideosrc, "frames of the stream still held downstream, continuing on a new stream");
+	create_stream_m2s(p_m2svideosrc);
+	return true;
+}
+
+// Before the running stream is stopped: give downstream LEASE_DRAIN_TIMEOUT_MS
+// to release its frames, so that the stream can usually be kept.
+static void drain_leases_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	gint64 end_time = g_get_monotonic_time() + LEASE_DRAIN_TIMEOUT_MS * G_TIME_SPAN_MILLISECOND;
+
+	g_mutex_lock(&p_m2svideosrc->lease_lock);
+	while ((held_leases_locked_m2s(p_m2svideosrc) > 0) &&
+		   g_cond_wait_until(&p_m2svideosrc->lease_cond, &p_m2svideosrc->lease_lock, end_time))
+	{
+	}
+	g_mutex_unlock(&p_m2svideosrc->lease_lock);
+}
+
+// The current frame and the one genlock queued behind it
+static void release_held_leases_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	if (p_m2svideosrc->p_cur_lease != nullptr)
+	{
+		release_lease_m2s(p_m2svideosrc->p_cur_lease);
+		p_m2svideosrc->p_cur_lease = nullptr;
+	}
+	if (p_m2svideosrc->p_next_lease != nullptr)
+	{
+		release_lease_m2s(p_m2svideosrc->p_next_lease);
+		p_m2svideosrc->p_next_lease = nullptr;
+	}
+}
+
+// RTP timestamps that are not locked to PTP cannot be compared with TAI
+static inline bool is_genlock(GstM2svideosrc *p_m2svideosrc)
+{
+	return p_m2svideosrc->genlock && !p_m2svideosrc->async_rtp_timestamp;
+}
+
+// The scan received: the detected one once auto-caps found a stream,
+// else the scan property
+static inline uint8_t scan_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	return (p_m2svideosrc->probe_width > 0) ? p_m2svideosrc->probe_scan : p_m2svideosrc->scan;
+}
+
+static void reset_adaptive_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	p_m2svideosrc->adaptive_target = p_m2svideosrc->fifo_middle;
+	p_m2svideosrc->adaptive_depth_avg = p_m2svideosrc->fifo_middle;
+	p_m2svideosrc->adaptive_window_frames = 0;
+	p_m2svideosrc->adaptive_window_min = G_MAXUINT32;
+	p_m2svideosrc->adaptive_window_max = 0;
+	p_m2svideosrc->adaptive_raised = false;
+	p_m2svideosrc->adaptive_dropped = 0;
+	p_m2svideosrc->adaptive_repeated = 0;
+}
+
+static void post_adaptive_message(GstM2svideosrc *p_m2svideosrc, uint32_t jitter)
+{
+	GST_INFO_OBJECT (p_m2svideosrc, "adaptive FIFO target %u frames (jitter %u)",
+	                 p_m2svideosrc->adaptive_target, jitter);
+
+	gst_element_post_message (GST_ELEMENT (p_m2svideosrc),
+	                          gst_message_new_element (GST_OBJECT (p_m2svideosrc),
+	                                                   gst_structure_new ("m2s-adaptive-fifo",
+	                                                                      "target", G_TYPE_UINT, (guint)p_m2svideosrc->adaptive_target,
+	                                                                      "jitter", G_TYPE_UINT, (guint)jitter,
+	                                                                      "dropped", G_TYPE_UINT64, (guint64)p_m2svideosrc->adaptive_dropped,
+	                                                                      "repeated", G_TYPE_UINT64, (guint64)p_m2svideosrc->adaptive_repeated,
+	                                                                      NULL)));
+}
+
+static void set_adaptive_target(GstM2svideosrc *p_m2svideosrc, uint32_t target, uint32_t jitter)
+{
+	target = CLAMP(target, 1, MAX(p_m2svideosrc->fifo_over_threshold, 1));
+	if (target != p_m2svideosrc->adaptive_target)
+	{
+		p_m2svideosrc->adaptive_target = target;
+		post_adaptive_message(p_m2svideosrc, jitter);
+
+		// the reported latency follows the target depth
+		gst_element_post_message (GST_ELEMENT (p_m2svideosrc),
+		                          gst_message_new_latency (GST_OBJECT (p_m2svideosrc)));
+	}
+}
+
 static void gst_m2svideosrc_set_hw_hitless (GstM2svideosrc *m2svideosrc, bool hw_hitless)
 {
 	m2svideosrc->hw_hitless = hw_hitless;
@@ -440,6 +919,101 @@ static void gst_m2svideosrc_set_gpudirect (GstM2svideosrc *m2svideosrc, bool gpu
 	m2svideosrc->gpudirect = gpudirect;
 }
 
+static void gst_m2svideosrc_set_zero_copy (GstM2svideosrc *m2svideosrc, bool zero_copy)
+{
+	m2svideosrc->zero_copy = zero_copy;
+}
+
+static void gst_m2svideosrc_set_zero_copy_max_leases (GstM2svideosrc *m2svideosrc, uint8_t max_leases)
+{
+	m2svideosrc->zero_copy_max_leases = max_leases;
+}
+
+static void gst_m2svideosrc_set_read_select (GstM2svideosrc *m2svideosrc, bool read_select)
+{
+	m2svideosrc->read_select = read_select;
+}
+
+static void gst_m2svideosrc_set_adaptive_fifo (GstM2svideosrc *m2svideosrc, bool adaptive_fifo)
+{
+	m2svideosrc->adaptive_fifo = adaptive_fifo;
+}
+
+static void gst_m2svideosrc_set_adaptive_window (GstM2svideosrc *m2svideosrc, uint32_t window)
+{
+	m2svideosrc->adaptive_window = window;
+}
+
+static void gst_m2svideosrc_set_underflow_policy (GstM2svideosrc *m2svideosrc, GstM2svideosrcUnderflowPolicy policy)
+{
+	m2svideosrc->underflow_policy = policy;
+}
+
+static void gst_m2svideosrc_set_rtp_timestamp_pts (GstM2svideosrc *m2svideosrc, bool rtp_timestamp_pts)
+{
+	m2svideosrc->rtp_timestamp_pts = rtp_timestamp_pts;
+}
+
+static void gst_m2svideosrc_set_field_output (GstM2svideosrc *m2svideosrc, bool field_output)
+{
+	m2svideosrc->field_output = field_output;
+}
+
+static void gst_m2svideosrc_set_qos (GstM2svideosrc *m2svideosrc, bool qos)
+{
+	m2svideosrc->qos = qos;
+}
+
+static void gst_m2svideosrc_set_genlock (GstM2svideosrc *m2svideosrc, bool genlock)
+{
+	m2svideosrc->genlock = genlock;
+}
+
+static void gst_m2svideosrc_set_genlock_offset (GstM2svideosrc *m2svideosrc, guint64 offset)
+{
+	m2svideosrc->genlock_offset = offset;
+}
+
+static void gst_m2svideosrc_set_frame_sync (GstM2svideosrc *m2svideosrc, GstM2svideosrcFrameSync frame_sync)
+{
+	m2svideosrc->frame_sync = frame_sync;
+}
+
+static void gst_m2svideosrc_set_crop_x (GstM2svideosrc *m2svideosrc, guint crop_x)
+{
+	m2svideosrc->crop_x = crop_x;
+}
+
+static void gst_m2svideosrc_set_crop_y (GstM2svideosrc *m2svideosrc, guint crop_y)
+{
+	m2svideosrc->crop_y = crop_y;
+}
+
+static void gst_m2svideosrc_set_crop_width (GstM2svideosrc *m2svideosrc, guint crop_width)
+{
+	m2svideosrc->crop_width = crop_width;
+}
+
+static void gst_m2svideosrc_set_crop_height (GstM2svideosrc *m2svideosrc, guint crop_height)
+{
+	m2svideosrc->crop_height = crop_height;
+}
+
+static void gst_m2svideosrc_set_input_resolution (GstM2svideosrc *m2svideosrc, GstM2svideosrcInputResolution input_resolution)
+{
+	m2svideosrc->input_resolution = input_resolution;
+}
+
+static void gst_m2svideosrc_set_auto_caps (GstM2svideosrc *m2svideosrc, bool auto_caps)
+{
+	m2svideosrc->auto_caps = auto_caps;
+}
+
+static void gst_m2svideosrc_set_probe_timeout_ms (GstM2svideosrc *m2svideosrc, uint32_t timeout_ms)
+{
+	m2svideosrc->probe_timeout_ms = timeout_ms;
+}
+
 static void
 gst_m2svideosrc_class_init (GstM2svideosrcClass * klass)
 {
@@ -455,6 +1029,7 @@ gst_m2svideosrc_class_init (GstM2svideosrcClass * klass)
 
 	gobject_class->set_property = gst_m2svideosrc_set_property;
 	gobject_class->get_property = gst_m2svideosrc_get_property;
+	gobject_class->finalize = gst_m2svideosrc_finalize;
 
 	g_object_class_install_property (gobject_class, PROP_TIMESTAMP_OFFSET,
 	                                 g_param_spec_int64 ("timestamp-offset", "Timestamp offset",
@@ -608,7 +1183,174 @@ gst_m2svideosrc_class_init (GstM2svideosrcClass * klass)
 	                                                       "GPUDirect", DEFAULT_GPUDIRECT,
 	                                                       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
+	g_object_class_install_property (gobject_class, PROP_ZERO_COPY,
+	                                 g_param_spec_boolean ("zero-copy", "Zero Copy",
+	                                                       "Push buffers wrapping the m2s read pointer instead of copying the frame",
+	                                                       DEFAULT_ZERO_COPY,
+	                                                       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_ZERO_COPY_MAX_LEASES,
+	                               g_param_spec_uint ("zero-copy-max-leases", "Zero Copy Max Leases",
+	                                                  "Maximum m2s frames held by downstream before waiting for one to be returned",
+	                                                  1, 255, DEFAULT_ZERO_COPY_MAX_LEASES,
+	                                                  (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_READ_SELECT,
+	                                 g_param_spec_boolean ("read-select", "Read Select",
+	                                                       "Block in m2s_read_select until a frame arrives instead of polling the FIFO depth",
+	                                                       DEFAULT_READ_SELECT,
+	                                                       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_ADAPTIVE_FIFO,
+	                                 g_param_spec_boolean ("adaptive-fifo", "Adaptive FIFO",
+	                                                       "Track the measured arrival jitter instead of the fixed FIFO thresholds. "
+	                                                       "fifo-middle is the starting depth and fifo-over-threshold the maximum",
+	                                                       DEFAULT_ADAPTIVE_FIFO,
+	                                                       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_ADAPTIVE_WINDOW,
+	                                 g_param_spec_uint ("adaptive-window", "Adaptive Window",
+	                                                    "Frames per jitter measurement window", 1, G_MAXUINT32, DEFAULT_ADAPTIVE_WINDOW,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_ADAPTIVE_TARGET,
+	                                 g_param_spec_uint ("adaptive-target", "Adaptive Target",
+	                                                    "Current target FIFO depth in frames", 0, 255, 0,
+	                                                    (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_ADAPTIVE_DROPPED,
+	                                 g_param_spec_uint64 ("adaptive-dropped", "Adaptive Dropped",
+	                                                      "Frames skipped to shrink the FIFO", 0, G_MAXUINT64, 0,
+	                                                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_ADAPTIVE_REPEATED,
+	                                 g_param_spec_uint64 ("adaptive-repeated", "Adaptive Repeated",
+	                                                      "Frames repeated because the FIFO ran dry", 0, G_MAXUINT64, 0,
+	                                                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_UNDERFLOW_POLICY,
+	                                 g_param_spec_enum ("underflow-policy", "Underflow Policy",
+	                                                    "What to output when no frame is available from m2s",
+	                                                    GST_TYPE_M2S_VIDEO_SRC_UNDERFLOW_POLICY, DEFAULT_UNDERFLOW_POLICY,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_RTP_TIMESTAMP_PTS,
+	                                 g_param_spec_boolean ("rtp-timestamp-pts", "RTP Timestamp PTS",
+	                                                       "Derive the PTS from the RTP timestamp (capture time) instead of the frame counter. "
+	                                                       "Ignored with async-rtp-timestamp",
+	                                                       DEFAULT_RTP_TIMESTAMP_PTS,
+	                                                       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_FIELD_OUTPUT,
+	                                 g_param_spec_boolean ("field-output", "Field Output",
+	                                                       "With an interlaced scan, negotiate interlace-mode=alternate and push each field as its own buffer. "
+	                                                       "Both fields are pushed once the whole frame was received",
+	                                                       DEFAULT_FIELD_OUTPUT,
+	                                                       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_QOS,
+	                                 g_param_spec_boolean ("qos", "QoS",
+	                                                       "Skip frames that downstream QoS reports as too late, before they are copied out of m2s",
+	                                                       DEFAULT_QOS,
+	                                                       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_QOS_DROPPED,
+	                                 g_param_spec_uint64 ("qos-dropped", "QoS Dropped",
+	                                                      "Frames skipped because of QoS", 0, G_MAXUINT64, 0,
+	                                                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_GENLOCK,
+	                                 g_param_spec_boolean ("genlock", "Genlock",
+	                                                       "Output the newest frame captured genlock-offset before the current TAI time "
+	                                                       "instead of following the FIFO depth. Ignored with async-rtp-timestamp",
+	                                                       DEFAULT_GENLOCK,
+	                                                       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_GENLOCK_OFFSET,
+	                                 g_param_spec_uint64 ("genlock-offset", "Genlock Offset",
+	                                                      "Delay in ns between the capture time of a frame and its output in genlock mode",
+	                                                      0, G_MAXUINT64, DEFAULT_GENLOCK_OFFSET,
+	                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_FRAME_SYNC,
+	                                 g_param_spec_enum ("frame-sync", "Frame Sync",
+	                                                    "Output frames on local frame boundaries, dropping or repeating received frames",
+	                                                    GST_TYPE_M2S_VIDEO_SRC_FRAME_SYNC, DEFAULT_FRAME_SYNC,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_FRAME_SYNC_DROPPED,
+	                                 g_param_spec_uint64 ("frame-sync-dropped", "Frame Sync Dropped",
+	                                                      "Frames dropped by the frame synchronizer", 0, G_MAXUINT64, 0,
+	                                                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_FRAME_SYNC_REPEATED,
+	                                 g_param_spec_uint64 ("frame-sync-repeated", "Frame Sync Repeated",
+	                                                      "Frames repeated by the frame synchronizer", 0, G_MAXUINT64, 0,
+	                                                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_CROP_X,
+	                                 g_param_spec_uint ("crop-x", "Crop X",
+	                                                    "Left edge of the output window in the m2s frame", 0, 3839, DEFAULT_CROP_X,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_CROP_Y,
+	                                 g_param_spec_uint ("crop-y", "Crop Y",
+	                                                    "Top edge of the output window in the m2s frame", 0, 2159, DEFAULT_CROP_Y,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_CROP_WIDTH,
+	                                 g_param_spec_uint ("crop-width", "Crop Width",
+	                                                    "Width of the output window, 0 outputs the whole frame", 0, 3840, DEFAULT_CROP_WIDTH,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_CROP_HEIGHT,
+	                                 g_param_spec_uint ("crop-height", "Crop Height",
+	                                                    "Height of the output window, 0 outputs the whole frame", 0, 2160, DEFAULT_CROP_HEIGHT,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_INPUT_RESOLUTION,
+	                                 g_param_spec_enum ("input-resolution", "Input Resolution",
+	                                                    "Resolution of the received stream when cropping",
+	                                                    GST_TYPE_M2S_VIDEO_SRC_INPUT_RESOLUTION, DEFAULT_INPUT_RESOLUTION,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_AUTO_CAPS,
+	                                 g_param_spec_boolean ("auto-caps", "Auto Caps",
+	                                                       "Detect the size and frame rate of the stream before negotiating",
+	                                                       DEFAULT_AUTO_CAPS,
+	                                                       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_PROBE_TIMEOUT_MS,
+	                                 g_param_spec_uint ("probe-timeout-ms", "Probe Timeout",
+	                                                    "How long auto-caps waits for frames per resolution (ms)",
+	                                                    0, G_MAXUINT32, DEFAULT_PROBE_TIMEOUT_MS,
+	                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	g_object_class_install_property (gobject_class, PROP_LAST_SWITCH_TIME,
+	                                 g_param_spec_uint64 ("last-switch-time", "Last Switch Time",
+	                                                      "Time from the last switch-source to the first frame of the new source (ns)",
+	                                                      0, G_MAXUINT64, 0,
+	                                                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	/**
+	 * GstM2svideosrc::switch-source:
+	 * @p_dst_address: new primary destination address, or %NULL to keep it
+	 * @s_dst_address: new secondary destination address, or %NULL to keep it
+	 *
+	 * Move the running stream to other multicast groups without a restart.
+	 * The last frame is repeated until the first complete frame of the new
+	 * source, then an "m2s-switch" element message reports the switch time.
+	 *
+	 * Returns: %FALSE if an address is invalid
+	 */
+	gst_m2svideosrc_signals[SIGNAL_SWITCH_SOURCE] =
+		g_signal_new_class_handler ("switch-source", G_TYPE_FROM_CLASS (klass),
+		                            (GSignalFlags)(G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION),
+		                            G_CALLBACK (gst_m2svideosrc_switch_source), NULL, NULL, NULL,
+		                            G_TYPE_BOOLEAN, 2, G_TYPE_STRING, G_TYPE_STRING);
+
 	gstelement_class->change_state = gst_m2svideosrc_change_state;
+	gstelement_class->provide_clock = gst_m2svideosrc_provide_clock;
 
 	gst_element_class_set_static_metadata (gstelement_class,
 	                                       "FIXME Long name", "Generic",
@@ -617,22 +1359,27 @@ gst_m2svideosrc_class_init (GstM2svideosrcClass * klass)
 	gst_element_class_add_static_pad_template (gstelement_class,
 	                                           &gst_m2svideosrc_template);
 
+	gstbasesrc_class->get_caps = gst_m2svideosrc_get_caps;
 	gstbasesrc_class->set_caps = gst_m2svideosrc_setcaps;
 	gstbasesrc_class->fixate = gst_m2svideosrc_src_fixate;
 	gstbasesrc_class->is_seekable = gst_m2svideosrc_is_seekable;
 	gstbasesrc_class->do_seek = gst_m2svideosrc_do_seek;
 	gstbasesrc_class->query = gst_m2svideosrc_query;
+	gstbasesrc_class->event = gst_m2svideosrc_event;
 	gstbasesrc_class->get_times = gst_m2svideosrc_get_times;
 	gstbasesrc_class->start = gst_m2svideosrc_start;
 	gstbasesrc_class->stop = gst_m2svideosrc_stop;
+	gstbasesrc_class->unlock = gst_m2svideosrc_unlock;
+	gstbasesrc_class->unlock_stop = gst_m2svideosrc_unlock_stop;
 	gstbasesrc_class->decide_allocation = gst_m2svideosrc_decide_allocation;
 
-	gstpushsrc_class->fill = gst_m2svideosrc_fill;
+	gstpushsrc_class->create = gst_m2svideosrc_create;
 }
 
 static void
 gst_m2svideosrc_init (GstM2svideosrc * p_m2svideosrc)
 {
+	GST_OBJECT_FLAG_SET (p_m2svideosrc, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
 	p_m2svideosrc->timestamp_offset = DEFAULT_TIMESTAMP_OFFSET;
 
 	/* we operate in time */
@@ -668,23 +1415,136 @@ gst_m2svideosrc_init (GstM2svideosrc * p_m2svideosrc)
 	gst_m2svideosrc_set_fifo_over_threshold(p_m2svideosrc, DEFAULT_FIFO_OVER_THRESHOLD);
 	gst_m2svideosrc_set_under_count_max(p_m2svideosrc, DEFAULT_UNDER_COUNT_MAX);
 	gst_m2svideosrc_set_gpudirect(p_m2svideosrc, DEFAULT_GPUDIRECT);
+	gst_m2svideosrc_set_zero_copy(p_m2svideosrc, DEFAULT_ZERO_COPY);
+	gst_m2svideosrc_set_zero_copy_max_leases(p_m2svideosrc, DEFAULT_ZERO_COPY_MAX_LEASES);
+	gst_m2svideosrc_set_read_select(p_m2svideosrc, DEFAULT_READ_SELECT);
+	gst_m2svideosrc_set_adaptive_fifo(p_m2svideosrc, DEFAULT_ADAPTIVE_FIFO);
+	gst_m2svideosrc_set_adaptive_window(p_m2svideosrc, DEFAULT_ADAPTIVE_WINDOW);
+	gst_m2svideosrc_set_underflow_policy(p_m2svideosrc, DEFAULT_UNDERFLOW_POLICY);
+	gst_m2svideosrc_set_rtp_timestamp_pts(p_m2svideosrc, DEFAULT_RTP_TIMESTAMP_PTS);
+	gst_m2svideosrc_set_field_output(p_m2svideosrc, DEFAULT_FIELD_OUTPUT);
+	gst_m2svideosrc_set_qos(p_m2svideosrc, DEFAULT_QOS);
+	gst_m2svideosrc_set_genlock(p_m2svideosrc, DEFAULT_GENLOCK);
+	gst_m2svideosrc_set_genlock_offset(p_m2svideosrc, DEFAULT_GENLOCK_OFFSET);
+	gst_m2svideosrc_set_frame_sync(p_m2svideosrc, DEFAULT_FRAME_SYNC);
+	gst_m2svideosrc_set_crop_x(p_m2svideosrc, DEFAULT_CROP_X);
+	gst_m2svideosrc_set_crop_y(p_m2svideosrc, DEFAULT_CROP_Y);
+	gst_m2svideosrc_set_crop_width(p_m2svideosrc, DEFAULT_CROP_WIDTH);
+	gst_m2svideosrc_set_crop_height(p_m2svideosrc, DEFAULT_CROP_HEIGHT);
+	gst_m2svideosrc_set_input_resolution(p_m2svideosrc, DEFAULT_INPUT_RESOLUTION);
+	gst_m2svideosrc_set_auto_caps(p_m2svideosrc, DEFAULT_AUTO_CAPS);
+	gst_m2svideosrc_set_probe_timeout_ms(p_m2svideosrc, DEFAULT_PROBE_TIMEOUT_MS);
+	g_mutex_init(&p_m2svideosrc->lease_lock);
+	g_cond_init(&p_m2svideosrc->lease_cond);
+	g_queue_init(&p_m2svideosrc->leases);
+	g_queue_init(&p_m2svideosrc->dead_streams);
+	/* read by the probe before the first caps */
+	gst_video_info_init(&p_m2svideosrc->info);
+	gst_video_info_init(&p_m2svideosrc->frame_info);
 }
 
-static GstCaps *
-gst_m2svideosrc_src_fixate (GstBaseSrc * bsrc, GstCaps * caps)
+static void
+gst_m2svideosrc_finalize (GObject * object)
 {
-	GstStructure *structure;
+	GstM2svideosrc *p_m2svideosrc = GST_M2SVIDEOSRC (object);
+
+	/* every lease held a reference, so all their streams are dead by now */
+	delete_dead_streams_m2s (p_m2svideosrc);
+	g_mutex_clear (&p_m2svideosrc->lease_lock);
+	g_cond_clear (&p_m2svideosrc->lease_cond);
+
+	G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+// Sizes and rates m2s can receive, narrowed to the detected stream once
+// auto-caps found one. With a crop window only the rate is limited here.
+static GstCaps *get_supported_caps_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	bool crop = (p_m2svideosrc->crop_width > 0) && (p_m2svideosrc->crop_height > 0);
+	GstCaps *p_caps;
+
+	if (p_m2svideosrc->probe_width == 0)
+	{
+		return gst_static_caps_get (crop ? &m2s_rate_caps : &m2s_supported_caps);
+	}
+
+	p_caps = gst_caps_new_simple ("video/x-raw",
+	                              "framerate", GST_TYPE_FRACTION, p_m2svideosrc->probe_fps_n, p_m2svideosrc->probe_fps_d,
+	                              NULL);
+	if (!crop)
+	{
+		gst_caps_set_simple (p_caps, "width", G_TYPE_INT, p_m2svideosrc->probe_width,
+		                     "height", G_TYPE_INT, p_m2svideosrc->probe_height, NULL);
+	}
+	gst_caps_set_features (p_caps, 0, gst_caps_features_new_any ());
+
+	return p_caps;
+}
+
+static GstCaps *
+gst_m2svideosrc_get_caps (GstBaseSrc * bsrc, GstCaps * filter)
+{
+	GstM2svideosrc *src = GST_M2SVIDEOSRC (bsrc);
+	GstCaps *templ;
+	GstCaps *caps;
+	GstCaps *supported;
+	GstCaps *tmp;
+	uint8_t scan;
+
+	/* the template holds the frame caps first and the field caps second */
+	templ = gst_pad_get_pad_template_caps (GST_BASE_SRC_PAD (bsrc));
+	scan = scan_m2s (src);
+	if (src->field_output && (scan != M2S_VIDEO_SCAN_PROGRESSIVE))
+		caps = gst_caps_copy_nth (templ, 1);
+	else
+		caps = gst_caps_copy_nth (templ, 0);
+	gst_caps_unref (templ);
+
+	/* the scan is part of the caps, so that a change of it renegotiates */
+	if (scan == M2S_VIDEO_SCAN_PROGRESSIVE)
+		gst_caps_set_simple (caps, "interlace-mode", G_TYPE_STRING, "progressive", NULL);
+	else if (!src->field_output)
+		gst_caps_set_simple (caps, "interlace-mode", G_TYPE_STRING, "interleaved",
+		                     "field-order", G_TYPE_STRING,
+		                     (scan == M2S_VIDEO_SCAN_INTERLACE_TFF) ? "top-field-first" : "bottom-field-first",
+		                     NULL);
+
+	/* a crop window fixes the output size */
+	if ((src->crop_width > 0) && (src->crop_height > 0))
+		gst_caps_set_simple (caps, "width", G_TYPE_INT, (gint) src->crop_width,
+		                     "height", G_TYPE_INT, (gint) src->crop_height, NULL);
+
+	supported = get_supported_caps_m2s (src);
+	tmp = gst_caps_intersect (caps, supported);
+	gst_caps_unref (supported);
+	gst_caps_unref (caps);
+	caps = tmp;
+
+	if (filter) {
+		tmp = gst_caps_intersect_full (filter, caps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref (caps);
+		caps = tmp;
+	}
+
+	return caps;
+}
+
+static GstCaps *
+gst_m2svideosrc_src_fixate (GstBaseSrc * bsrc, GstCaps * caps)
+{
+	GstStructure *structure;
 
 	caps = gst_caps_make_writable (caps);
 	structure = gst_caps_get_structure (caps, 0);
 
-	gst_structure_fixate_field_nearest_int (structure, "width", 320);
-	gst_structure_fixate_field_nearest_int (structure, "height", 240);
+	/* only used when nothing was detected, see auto-caps */
+	gst_structure_fixate_field_nearest_int (structure, "width", 1920);
+	gst_structure_fixate_field_nearest_int (structure, "height", 1080);
 
 	if (gst_structure_has_field (structure, "framerate"))
-		gst_structure_fixate_field_nearest_fraction (structure, "framerate", 30, 1);
+		gst_structure_fixate_field_nearest_fraction (structure, "framerate", 60000, 1001);
 	else
-		gst_structure_set (structure, "framerate", GST_TYPE_FRACTION, 30, 1, NULL);
+		gst_structure_set (structure, "framerate", GST_TYPE_FRACTION, 60000, 1001, NULL);
 
 	if (gst_structure_has_field (structure, "pixel-aspect-ratio"))
 		gst_structure_fixate_field_nearest_fraction (structure,
@@ -817,6 +1677,63 @@ gst_m2svideosrc_set_property (GObject * object, guint prop_id,
 	case PROP_GPUDIRECT:
 		gst_m2svideosrc_set_gpudirect (p_m2svideosrc, g_value_get_boolean (value));
 		break;
+	case PROP_ZERO_COPY:
+		gst_m2svideosrc_set_zero_copy (p_m2svideosrc, g_value_get_boolean (value));
+		break;
+	case PROP_ZERO_COPY_MAX_LEASES:
+		gst_m2svideosrc_set_zero_copy_max_leases (p_m2svideosrc, g_value_get_uint (value));
+		break;
+	case PROP_READ_SELECT:
+		gst_m2svideosrc_set_read_select (p_m2svideosrc, g_value_get_boolean (value));
+		break;
+	case PROP_ADAPTIVE_FIFO:
+		gst_m2svideosrc_set_adaptive_fifo (p_m2svideosrc, g_value_get_boolean (value));
+		break;
+	case PROP_ADAPTIVE_WINDOW:
+		gst_m2svideosrc_set_adaptive_window (p_m2svideosrc, g_value_get_uint (value));
+		break;
+	case PROP_UNDERFLOW_POLICY:
+		gst_m2svideosrc_set_underflow_policy (p_m2svideosrc, (GstM2svideosrcUnderflowPolicy)g_value_get_enum (value));
+		break;
+	case PROP_RTP_TIMESTAMP_PTS:
+		gst_m2svideosrc_set_rtp_timestamp_pts (p_m2svideosrc, g_value_get_boolean (value));
+		break;
+	case PROP_FIELD_OUTPUT:
+		gst_m2svideosrc_set_field_output (p_m2svideosrc, g_value_get_boolean (value));
+		break;
+	case PROP_QOS:
+		gst_m2svideosrc_set_qos (p_m2svideosrc, g_value_get_boolean (value));
+		break;
+	case PROP_GENLOCK:
+		gst_m2svideosrc_set_genlock (p_m2svideosrc, g_value_get_boolean (value));
+		break;
+	case PROP_GENLOCK_OFFSET:
+		gst_m2svideosrc_set_genlock_offset (p_m2svideosrc, g_value_get_uint64 (value));
+		break;
+	case PROP_FRAME_SYNC:
+		gst_m2svideosrc_set_frame_sync (p_m2svideosrc, (GstM2svideosrcFrameSync)g_value_get_enum (value));
+		break;
+	case PROP_CROP_X:
+		gst_m2svideosrc_set_crop_x (p_m2svideosrc, g_value_get_uint (value));
+		break;
+	case PROP_CROP_Y:
+		gst_m2svideosrc_set_crop_y (p_m2svideosrc, g_value_get_uint (value));
+		break;
+	case PROP_CROP_WIDTH:
+		gst_m2svideosrc_set_crop_width (p_m2svideosrc, g_value_get_uint (value));
+		break;
+	case PROP_CROP_HEIGHT:
+		gst_m2svideosrc_set_crop_height (p_m2svideosrc, g_value_get_uint (value));
+		break;
+	case PROP_INPUT_RESOLUTION:
+		gst_m2svideosrc_set_input_resolution (p_m2svideosrc, (GstM2svideosrcInputResolution)g_value_get_enum (value));
+		break;
+	case PROP_AUTO_CAPS:
+		gst_m2svideosrc_set_auto_caps (p_m2svideosrc, g_value_get_boolean (value));
+		break;
+	case PROP_PROBE_TIMEOUT_MS:
+		gst_m2svideosrc_set_probe_timeout_ms (p_m2svideosrc, g_value_get_uint (value));
+		break;
 
 	default:
 		break;
@@ -921,6 +1838,84 @@ gst_m2svideosrc_get_property (GObject * object, guint prop_id,
 	case PROP_GPUDIRECT:
 		g_value_set_boolean (value, p_m2svideosrc->gpudirect);
 		break;
+	case PROP_ZERO_COPY:
+		g_value_set_boolean (value, p_m2svideosrc->zero_copy);
+		break;
+	case PROP_ZERO_COPY_MAX_LEASES:
+		g_value_set_uint (value, p_m2svideosrc->zero_copy_max_leases);
+		break;
+	case PROP_READ_SELECT:
+		g_value_set_boolean (value, p_m2svideosrc->read_select);
+		break;
+	case PROP_ADAPTIVE_FIFO:
+		g_value_set_boolean (value, p_m2svideosrc->adaptive_fifo);
+		break;
+	case PROP_ADAPTIVE_WINDOW:
+		g_value_set_uint (value, p_m2svideosrc->adaptive_window);
+		break;
+	case PROP_ADAPTIVE_TARGET:
+		g_value_set_uint (value, p_m2svideosrc->adaptive_target);
+		break;
+	case PROP_ADAPTIVE_DROPPED:
+		g_value_set_uint64 (value, p_m2svideosrc->adaptive_dropped);
+		break;
+	case PROP_ADAPTIVE_REPEATED:
+		g_value_set_uint64 (value, p_m2svideosrc->adaptive_repeated);
+		break;
+	case PROP_UNDERFLOW_POLICY:
+		g_value_set_enum (value, p_m2svideosrc->underflow_policy);
+		break;
+	case PROP_RTP_TIMESTAMP_PTS:
+		g_value_set_boolean (value, p_m2svideosrc->rtp_timestamp_pts);
+		break;
+	case PROP_FIELD_OUTPUT:
+		g_value_set_boolean (value, p_m2svideosrc->field_output);
+		break;
+	case PROP_QOS:
+		g_value_set_boolean (value, p_m2svideosrc->qos);
+		break;
+	case PROP_QOS_DROPPED:
+		g_value_set_uint64 (value, p_m2svideosrc->qos_dropped);
+		break;
+	case PROP_GENLOCK:
+		g_value_set_boolean (value, p_m2svideosrc->genlock);
+		break;
+	case PROP_GENLOCK_OFFSET:
+		g_value_set_uint64 (value, p_m2svideosrc->genlock_offset);
+		break;
+	case PROP_FRAME_SYNC:
+		g_value_set_enum (value, p_m2svideosrc->frame_sync);
+		break;
+	case PROP_FRAME_SYNC_DROPPED:
+		g_value_set_uint64 (value, p_m2svideosrc->sync_dropped);
+		break;
+	case PROP_FRAME_SYNC_REPEATED:
+		g_value_set_uint64 (value, p_m2svideosrc->sync_repeated);
+		break;
+	case PROP_CROP_X:
+		g_value_set_uint (value, p_m2svideosrc->crop_x);
+		break;
+	case PROP_CROP_Y:
+		g_value_set_uint (value, p_m2svideosrc->crop_y);
+		break;
+	case PROP_CROP_WIDTH:
+		g_value_set_uint (value, p_m2svideosrc->crop_width);
+		break;
+	case PROP_CROP_HEIGHT:
+		g_value_set_uint (value, p_m2svideosrc->crop_height);
+		break;
+	case PROP_INPUT_RESOLUTION:
+		g_value_set_enum (value, p_m2svideosrc->input_resolution);
+		break;
+	case PROP_AUTO_CAPS:
+		g_value_set_boolean (value, p_m2svideosrc->auto_caps);
+		break;
+	case PROP_PROBE_TIMEOUT_MS:
+		g_value_set_uint (value, p_m2svideosrc->probe_timeout_ms);
+		break;
+	case PROP_LAST_SWITCH_TIME:
+		g_value_set_uint64 (value, p_m2svideosrc->last_switch_time);
+		break;
 
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -928,6 +1923,12 @@ gst_m2svideosrc_get_property (GObject * object, guint prop_id,
 	}
 }
 
+static GstClock *
+gst_m2svideosrc_provide_clock (GstElement * element)
+{
+	return gst_m2s_clock_obtain();
+}
+
 static GstStateChangeReturn
 gst_m2svideosrc_change_state (GstElement * element, GstStateChange transition)
 {
@@ -938,31 +1939,47 @@ gst_m2svideosrc_change_state (GstElement * element, GstStateChange transition)
 	{
 	case GST_STATE_CHANGE_NULL_TO_READY:
 
-		p_m2svideosrc->p_frame_from_m2s = nullptr;
+		p_m2svideosrc->p_cur_lease = nullptr;
+		p_m2svideosrc->p_next_lease = nullptr;
 		p_m2svideosrc->under_count = 0;
+		p_m2svideosrc->rtp_unwrap_valid = false;
+		reset_adaptive_m2s(p_m2svideosrc);
 
 		m2s_open_conf_t open_conf;
 		open_conf.cuda_dev_num = p_m2svideosrc->gpu_num;
 		open_conf.p_ipx_license_file = p_m2svideosrc->ipx_license;
 		m2s_open(&open_conf);
 
-		m2s_cpu_affinity_t cpu_affinity;
-		cpu_affinity.rx.l2_num = p_m2svideosrc->l2_cpu_num;
-		cpu_affinity.rx.l1_num = p_m2svideosrc->l1_cpu_num;
-		m2s_create(&p_m2svideosrc->strm_id, M2S_IO_TYPE_RX, M2S_MEDIA_TYPE_VIDEO, M2S_MEMORY_MODE_CPU, &cpu_affinity, NULL, p_m2svideosrc->hw_hitless);
-
+		create_stream_m2s(p_m2svideosrc);
 		break;
 
 	case GST_STATE_CHANGE_READY_TO_PAUSED:
+		// before the base class starts the streaming thread and negotiates
+		probe_m2s(p_m2svideosrc);
 		break;
 
 	case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+		resume_m2s(p_m2svideosrc);
 		m2s_start(p_m2svideosrc->strm_id);
+		GST_OBJECT_LOCK (p_m2svideosrc);
+		p_m2svideosrc->m2s_started = true;
+		GST_OBJECT_UNLOCK (p_m2svideosrc);
+		if (p_m2svideosrc->read_select)
+		{
+			m2s_enable_select(p_m2svideosrc->strm_id, true);
+		}
 		start_monitoring_timer(p_m2svideosrc);
 		break;
 
 	case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
 		stop_monitoring_timer(p_m2svideosrc);
+		GST_OBJECT_LOCK (p_m2svideosrc);
+		p_m2svideosrc->m2s_started = false;
+		GST_OBJECT_UNLOCK (p_m2svideosrc);
+		if (p_m2svideosrc->read_select)
+		{
+			m2s_enable_select(p_m2svideosrc->strm_id, false);
+		}
 		m2s_stop(p_m2svideosrc->strm_id);
 		break;
 
@@ -970,13 +1987,12 @@ gst_m2svideosrc_change_state (GstElement * element, GstStateChange transition)
 		break;
 
 	case GST_STATE_CHANGE_READY_TO_NULL:
-		if (p_m2svideosrc->p_frame_from_m2s)
+		release_held_leases_m2s(p_m2svideosrc);
+		if (!detach_leases_m2s(p_m2svideosrc))
 		{
-			m2s_free_read_ptr(p_m2svideosrc->strm_id);
-			p_m2svideosrc->p_frame_from_m2s = nullptr;
+			m2s_delete(p_m2svideosrc->strm_id);
 		}
-
-		m2s_delete(p_m2svideosrc->strm_id);
+		delete_dead_streams_m2s(p_m2svideosrc);
 		//m2s_close();
 		break;
 
@@ -1000,6 +2016,11 @@ gst_m2svideosrc_decide_allocation (GstBaseSrc * bsrc, GstQuery * query)
 
 	m2svideosrc = GST_M2SVIDEOSRC (bsrc);
 
+	/* zero-copy crop hands out the whole frame, which needs both metas */
+	m2svideosrc->crop_meta =
+		gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL) &&
+		gst_query_find_allocation_meta (query, GST_VIDEO_CROP_META_API_TYPE, NULL);
+
 	if (gst_query_get_n_allocation_pools (query) > 0) {
 		gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
 
@@ -1041,40 +2062,49 @@ gst_m2svideosrc_decide_allocation (GstBaseSrc * bsrc, GstQuery * query)
 	return GST_BASE_SRC_CLASS (parent_class)->decide_allocation (bsrc, query);
 }
 
-static inline void set_m2s_conf(GstM2svideosrc *p_m2svideosrc)
+static void get_ip_conf_m2s(GstM2svideosrc *p_m2svideosrc, m2s_ip_conf_t *p_ip_conf)
 {
-	m2s_sys_conf_t sys_conf;
-	m2s_media_conf_t media_conf;
-	m2s_ip_conf_t ip_conf;
-	memset(&sys_conf, 0, sizeof(sys_conf));
-	memset(&media_conf, 0, sizeof(media_conf));
-	memset(&ip_conf, 0, sizeof(ip_conf));
+	memset(p_ip_conf, 0, sizeof(*p_ip_conf));
 
 	for (int i = 0; i < 2; i++)
 	{
-		ip_conf.rx_only.if_ip[i] = m2s_conv_ip_address_from_string(p_m2svideosrc->if_ip[i]);
+		p_ip_conf->rx_only.if_ip[i] = m2s_conv_ip_address_from_string(p_m2svideosrc->if_ip[i]);
 		DBG_MSG("if_ip[%u]=%s\n", i, p_m2svideosrc->if_ip[i]);
-		ip_conf.dst_ip[i] = m2s_conv_ip_address_from_string(p_m2svideosrc->dst_ip[i]);
+		p_ip_conf->dst_ip[i] = m2s_conv_ip_address_from_string(p_m2svideosrc->dst_ip[i]);
 		DBG_MSG("dst_ip[%u]=%s\n", i, p_m2svideosrc->dst_ip[i]);
-		ip_conf.src_ip[i] = m2s_conv_ip_address_from_string(p_m2svideosrc->src_ip[i]);
+		p_ip_conf->src_ip[i] = m2s_conv_ip_address_from_string(p_m2svideosrc->src_ip[i]);
 		DBG_MSG("src_ip[%u]=%s\n", i, p_m2svideosrc->src_ip[i]);
-		ip_conf.dst_port[i] = p_m2svideosrc->dst_port[i];
-		DBG_MSG("dst_port[%u]=%u\n", i, ip_conf.dst_port[i]);
-		ip_conf.src_port[i] = p_m2svideosrc->src_port[i];
-		DBG_MSG("src_port[%u]=%u\n", i, ip_conf.src_port[i]);
-		ip_conf.payload_type[i] = p_m2svideosrc->payload_type;
-		DBG_MSG("payload_type[%u]=%u\n", i, ip_conf.payload_type[i]);
-		ip_conf.rtp_enabled[i] = (ip_conf.rx_only.if_ip[i] == 0) ? false : true;
+		p_ip_conf->dst_port[i] = p_m2svideosrc->dst_port[i];
+		DBG_MSG("dst_port[%u]=%u\n", i, p_ip_conf->dst_port[i]);
+		p_ip_conf->src_port[i] = p_m2svideosrc->src_port[i];
+		DBG_MSG("src_port[%u]=%u\n", i, p_ip_conf->src_port[i]);
+		p_ip_conf->payload_type[i] = p_m2svideosrc->payload_type;
+		DBG_MSG("payload_type[%u]=%u\n", i, p_ip_conf->payload_type[i]);
+		p_ip_conf->rtp_enabled[i] = (p_ip_conf->rx_only.if_ip[i] == 0) ? false : true;
 	}
-	ip_conf.rx_only.playout_delay_ms = p_m2svideosrc->playout_delay_ms;
+	p_ip_conf->rx_only.playout_delay_ms = p_m2svideosrc->playout_delay_ms;
+}
+
+// Configure the stream, for the caps or for a probe. Only the state of the
+// stream itself is set here.
+static void set_media_conf_m2s(GstM2svideosrc *p_m2svideosrc, GstVideoInfo *p_info, GstVideoInfo *p_frame_info,
+                               uint8_t scan, m2s_frame_rate_t *p_frame_rate)
+{
+	m2s_sys_conf_t sys_conf;
+	m2s_media_conf_t media_conf;
+	m2s_ip_conf_t ip_conf;
+	memset(&sys_conf, 0, sizeof(sys_conf));
+	memset(&media_conf, 0, sizeof(media_conf));
 
-	if ((GST_VIDEO_INFO_WIDTH(&p_m2svideosrc->info) == 3840) &&
-		(GST_VIDEO_INFO_HEIGHT(&p_m2svideosrc->info) == 2160))
+	get_ip_conf_m2s(p_m2svideosrc, &ip_conf);
+
+	if ((GST_VIDEO_INFO_WIDTH(p_frame_info) == 3840) &&
+		(GST_VIDEO_INFO_HEIGHT(p_frame_info) == 2160))
 	{
 		media_conf.video.app_caps.resolution = M2S_VIDEO_RESOLUTION_3840x2160;
 	}
-	else if ((GST_VIDEO_INFO_WIDTH(&p_m2svideosrc->info) == 1920) &&
-			 (GST_VIDEO_INFO_HEIGHT(&p_m2svideosrc->info) == 1080))
+	else if ((GST_VIDEO_INFO_WIDTH(p_frame_info) == 1920) &&
+			 (GST_VIDEO_INFO_HEIGHT(p_frame_info) == 1080))
 	{
 		media_conf.video.app_caps.resolution = M2S_VIDEO_RESOLUTION_1920x1080;
 	}
@@ -1083,27 +2113,27 @@ static inline void set_m2s_conf(GstM2svideosrc *p_m2svideosrc)
 		DBG_MSG("!!! unsupported video resolution !!!\n");
 	}
 
-	if (GST_VIDEO_INFO_FORMAT(&p_m2svideosrc->info) == GST_VIDEO_FORMAT_I420)
+	if (GST_VIDEO_INFO_FORMAT(p_info) == GST_VIDEO_FORMAT_I420)
 	{
 		DBG_MSG("GST_VIDEO_FORMAT_I420\n");
 		media_conf.video.app_caps.format = M2S_VIDEO_APP_FORMAT_I420;
 	}
-	else if (GST_VIDEO_INFO_FORMAT(&p_m2svideosrc->info) == GST_VIDEO_FORMAT_UYVP)
+	else if (GST_VIDEO_INFO_FORMAT(p_info) == GST_VIDEO_FORMAT_UYVP)
 	{
 		DBG_MSG("GST_VIDEO_FORMAT_UYVP\n");
 		media_conf.video.app_caps.format = M2S_VIDEO_APP_FORMAT_UYVP;
 	}
-	else if (GST_VIDEO_INFO_FORMAT(&p_m2svideosrc->info) == GST_VIDEO_FORMAT_UYVY)
+	else if (GST_VIDEO_INFO_FORMAT(p_info) == GST_VIDEO_FORMAT_UYVY)
 	{
 		DBG_MSG("GST_VIDEO_FORMAT_UYVY\n");
 		media_conf.video.app_caps.format = M2S_VIDEO_APP_FORMAT_UYVY;
 	}
-	else if (GST_VIDEO_INFO_FORMAT(&p_m2svideosrc->info) == GST_VIDEO_FORMAT_v210)
+	else if (GST_VIDEO_INFO_FORMAT(p_info) == GST_VIDEO_FORMAT_v210)
 	{
 		DBG_MSG("GST_VIDEO_FORMAT_v210\n");
 		media_conf.video.app_caps.format = M2S_VIDEO_APP_FORMAT_V210;
 	}
-	else if (GST_VIDEO_INFO_FORMAT(&p_m2svideosrc->info) == GST_VIDEO_FORMAT_BGRx)
+	else if (GST_VIDEO_INFO_FORMAT(p_info) == GST_VIDEO_FORMAT_BGRx)
 	{
 		DBG_MSG("GST_VIDEO_FORMAT_BGRx\n");
 		media_conf.video.app_caps.format = M2S_VIDEO_APP_FORMAT_BGRx;
@@ -1113,26 +2143,26 @@ static inline void set_m2s_conf(GstM2svideosrc *p_m2svideosrc)
 		DBG_MSG("!!! unknown video format !!!\n");
 	}
 
-	if ((GST_VIDEO_INFO_FPS_N(&p_m2svideosrc->info) == 60000) &&
-		(GST_VIDEO_INFO_FPS_D(&p_m2svideosrc->info) == 1001))
+	if ((GST_VIDEO_INFO_FPS_N(p_info) == 60000) &&
+		(GST_VIDEO_INFO_FPS_D(p_info) == 1001))
 	{
 		DBG_MSG("M2S_FRAME_RATE_60000_1001\n");
 		media_conf.video.app_caps.frame_rate = M2S_FRAME_RATE_60000_1001;
 	}
-	else if ((GST_VIDEO_INFO_FPS_N(&p_m2svideosrc->info) == 30000) &&
-			 (GST_VIDEO_INFO_FPS_D(&p_m2svideosrc->info) == 1001))
+	else if ((GST_VIDEO_INFO_FPS_N(p_info) == 30000) &&
+			 (GST_VIDEO_INFO_FPS_D(p_info) == 1001))
 	{
 		DBG_MSG("M2S_FRAME_RATE_30000_1001\n");
 		media_conf.video.app_caps.frame_rate = M2S_FRAME_RATE_30000_1001;
 	}
-	else if ((GST_VIDEO_INFO_FPS_N(&p_m2svideosrc->info) == 50) &&
-			 (GST_VIDEO_INFO_FPS_D(&p_m2svideosrc->info) == 1))
+	else if ((GST_VIDEO_INFO_FPS_N(p_info) == 50) &&
+			 (GST_VIDEO_INFO_FPS_D(p_info) == 1))
 	{
 		DBG_MSG("M2S_FRAME_RATE_50_1\n");
 		media_conf.video.app_caps.frame_rate = M2S_FRAME_RATE_50_1;
 	}
-	else if ((GST_VIDEO_INFO_FPS_N(&p_m2svideosrc->info) == 25) &&
-			 (GST_VIDEO_INFO_FPS_D(&p_m2svideosrc->info) == 1))
+	else if ((GST_VIDEO_INFO_FPS_N(p_info) == 25) &&
+			 (GST_VIDEO_INFO_FPS_D(p_info) == 1))
 	{
 		DBG_MSG("M2S_FRAME_RATE_25_1\n");
 		media_conf.video.app_caps.frame_rate = M2S_FRAME_RATE_25_1;
@@ -1143,8 +2173,9 @@ static inline void set_m2s_conf(GstM2svideosrc *p_m2svideosrc)
 	}
 
 	media_conf.video.rtp_caps.format = p_m2svideosrc->rtp_format;
-	media_conf.video.rtp_caps.scan = (m2s_video_scan_t)p_m2svideosrc->scan;
+	media_conf.video.rtp_caps.scan = (m2s_video_scan_t)scan;
 	media_conf.video.rtp_caps.frame_rate = media_conf.video.app_caps.frame_rate;
+	*p_frame_rate = media_conf.video.rtp_caps.frame_rate;
 	media_conf.video.rtp_caps.resolution = media_conf.video.app_caps.resolution;
 	media_conf.video.rtp_caps.box_mode = p_m2svideosrc->box_mode;
 	//DBG_MSG("box_mode: %d\n", media_conf.video.rtp_caps.box_mode);
@@ -1175,6 +2206,229 @@ static inline void set_m2s_conf(GstM2svideosrc *p_m2svideosrc)
 	m2s_set_ip_conf(p_m2svideosrc->strm_id, &ip_conf);
 }
 
+static inline void set_m2s_conf(GstM2svideosrc *p_m2svideosrc, GstVideoInfo *p_info, GstVideoInfo *p_frame_info)
+{
+	set_media_conf_m2s(p_m2svideosrc, p_info, p_frame_info, scan_m2s(p_m2svideosrc), &p_m2svideosrc->m2s_frame_rate);
+}
+
+// The last frame may still be repeated after its stream is given up
+static void copy_last_buffer_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	GstBuffer *p_copy;
+
+	if (p_m2svideosrc->p_last_buffer != nullptr)
+	{
+		p_copy = gst_buffer_copy_deep(p_m2svideosrc->p_last_buffer);
+		gst_buffer_unref(p_m2svideosrc->p_last_buffer);
+		p_m2svideosrc->p_last_buffer = p_copy;
+	}
+	if (p_m2svideosrc->p_last_field != nullptr)
+	{
+		p_copy = gst_buffer_copy_deep(p_m2svideosrc->p_last_field);
+		gst_buffer_unref(p_m2svideosrc->p_last_field);
+		p_m2svideosrc->p_last_field = p_copy;
+	}
+}
+
+// Stop the running stream, e.g. to configure it. m2s reuses the frame memory
+// once it is started again, so the frames held here are given back, and if
+// downstream does not release its frames in time the stream is renewed.
+static void stop_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	if (p_m2svideosrc->read_select)
+	{
+		m2s_enable_select(p_m2svideosrc->strm_id, false);
+	}
+
+	release_held_leases_m2s(p_m2svideosrc);
+	copy_last_buffer_m2s(p_m2svideosrc);
+	drain_leases_m2s(p_m2svideosrc);
+
+	m2s_stop(p_m2svideosrc->strm_id);
+	renew_stream_m2s(p_m2svideosrc);
+}
+
+// Before m2s_start() after a pause. The live streaming thread waits for
+// PLAYING, so the frames it held from the last PLAYING are given back here.
+static void resume_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	release_held_leases_m2s(p_m2svideosrc);
+	copy_last_buffer_m2s(p_m2svideosrc);
+	if (renew_stream_m2s(p_m2svideosrc))
+	{
+		GST_OBJECT_LOCK (p_m2svideosrc);
+		if (GST_VIDEO_INFO_FORMAT (&p_m2svideosrc->info) != GST_VIDEO_FORMAT_UNKNOWN)
+		{
+			set_m2s_conf(p_m2svideosrc, &p_m2svideosrc->info, &p_m2svideosrc->frame_info);
+		}
+		GST_OBJECT_UNLOCK (p_m2svideosrc);
+	}
+}
+
+static void start_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	m2s_start(p_m2svideosrc->strm_id);
+	if (p_m2svideosrc->read_select)
+	{
+		m2s_enable_select(p_m2svideosrc->strm_id, true);
+	}
+}
+
+// m2s takes a new configuration only while stopped. The stream object is kept,
+// so this works in PLAYING without going through READY. Called with the object
+// lock held.
+static void reconfigure_m2s(GstM2svideosrc *p_m2svideosrc, GstVideoInfo *p_info, GstVideoInfo *p_frame_info)
+{
+	if (!p_m2svideosrc->m2s_started)
+	{
+		set_m2s_conf(p_m2svideosrc, p_info, p_frame_info);
+		return;
+	}
+
+	stop_m2s(p_m2svideosrc);
+	set_m2s_conf(p_m2svideosrc, p_info, p_frame_info);
+	start_m2s(p_m2svideosrc);
+}
+
+// First component stored in the plane
+static guint plane_comp_m2s(const GstVideoFormatInfo *p_finfo, guint plane)
+{
+	guint comp;
+
+	for (comp = 0; comp < GST_VIDEO_FORMAT_INFO_N_COMPONENTS(p_finfo); comp++)
+	{
+		if (GST_VIDEO_FORMAT_INFO_PLANE(p_finfo, comp) == plane)
+		{
+			break;
+		}
+	}
+	return comp;
+}
+
+// Byte offset of pixel x in a line of the given plane. UYVP packs 2 pixels in
+// 5 bytes and v210 6 pixels in 16 bytes, the other formats have a pixel stride.
+static gint pixel_offset_m2s(const GstVideoFormatInfo *p_finfo, guint plane, guint x)
+{
+	guint comp = plane_comp_m2s(p_finfo, plane);
+
+	switch (GST_VIDEO_FORMAT_INFO_FORMAT(p_finfo))
+	{
+	case GST_VIDEO_FORMAT_UYVP:
+		return x / 2 * 5;
+	case GST_VIDEO_FORMAT_v210:
+		return x / 6 * 16;
+	default:
+		break;
+	}
+
+	return GST_VIDEO_FORMAT_INFO_SCALE_WIDTH(p_finfo, comp, x) * GST_VIDEO_FORMAT_INFO_PSTRIDE(p_finfo, comp);
+}
+
+// Pixels that share bytes in a line: the pixel group of the packed formats,
+// else the chroma subsampling
+static guint pixel_group_m2s(const GstVideoFormatInfo *p_finfo)
+{
+	switch (GST_VIDEO_FORMAT_INFO_FORMAT(p_finfo))
+	{
+	case GST_VIDEO_FORMAT_UYVP:
+		return 2;
+	case GST_VIDEO_FORMAT_v210:
+		return 6;
+	default:
+		break;
+	}
+
+	return 1 << GST_VIDEO_FORMAT_INFO_W_SUB(p_finfo, 1);
+}
+
+// The m2s frame is the caps size, or with crop-width/height the input
+// resolution: the one set, or else the detected one. A guess from the window
+// would read the frames of a larger stream with the wrong line length. The
+// window has to start on a whole pixel group and chroma line, and on a frame
+// line pair for field output.
+static bool set_frame_info_m2s(GstM2svideosrc *p_m2svideosrc, GstVideoInfo *p_info)
+{
+	const GstVideoFormatInfo *p_finfo = p_info->finfo;
+	GstVideoInfo *p_frame_info = &p_m2svideosrc->frame_info;
+	guint width = GST_VIDEO_INFO_WIDTH(p_info);
+	guint height = GST_VIDEO_INFO_HEIGHT(p_info);
+	guint x_align;
+	guint y_align;
+	guint end_x;
+	guint plane;
+
+	p_m2svideosrc->crop = (p_m2svideosrc->crop_width > 0) && (p_m2svideosrc->crop_height > 0);
+	if (p_m2svideosrc->crop)
+	{
+		switch (p_m2svideosrc->input_resolution)
+		{
+		case GST_M2SVIDEOSRC_INPUT_RESOLUTION_1920x1080:
+			width = 1920;
+			height = 1080;
+			break;
+		case GST_M2SVIDEOSRC_INPUT_RESOLUTION_3840x2160:
+			width = 3840;
+			height = 2160;
+			break;
+		default:
+			if (p_m2svideosrc->probe_width == 0)
+			{
+				GST_WARNING_OBJECT (p_m2svideosrc, "cropping needs input-resolution or a detected stream");
+				return false;
+			}
+			width = p_m2svideosrc->probe_width;
+			height = p_m2svideosrc->probe_height;
+			break;
+		}
+	}
+
+	/* m2s always delivers whole frames in the default layout */
+	gst_video_info_set_format (p_frame_info, GST_VIDEO_INFO_FORMAT (p_info), width, height);
+
+	for (plane = 0; plane < GST_VIDEO_INFO_N_PLANES(p_frame_info); plane++)
+	{
+		p_m2svideosrc->roi_offset[plane] = 0;
+		p_m2svideosrc->roi_line_size[plane] = GST_VIDEO_INFO_PLANE_STRIDE(p_frame_info, plane);
+	}
+
+	if (!p_m2svideosrc->crop)
+	{
+		return true;
+	}
+
+	x_align = pixel_group_m2s(p_finfo);
+	y_align = 1 << GST_VIDEO_FORMAT_INFO_H_SUB(p_finfo, 1);
+	if (GST_VIDEO_INFO_INTERLACE_MODE(p_info) == GST_VIDEO_INTERLACE_MODE_ALTERNATE)
+	{
+		y_align *= 2;
+	}
+
+	if ((p_m2svideosrc->crop_x + p_m2svideosrc->crop_width > width) ||
+		(p_m2svideosrc->crop_y + p_m2svideosrc->crop_height > height) ||
+		(p_m2svideosrc->crop_x % x_align != 0) || (p_m2svideosrc->crop_y % y_align != 0) ||
+		(p_m2svideosrc->crop_height % y_align != 0))
+	{
+		return false;
+	}
+
+	/* the last pixel group is copied whole */
+	end_x = MIN((p_m2svideosrc->crop_x + p_m2svideosrc->crop_width + x_align - 1) / x_align * x_align, width);
+	for (plane = 0; plane < GST_VIDEO_INFO_N_PLANES(p_frame_info); plane++)
+	{
+		p_m2svideosrc->roi_offset[plane] =
+			GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT(p_finfo, plane_comp_m2s(p_finfo, plane), p_m2svideosrc->crop_y) * GST_VIDEO_INFO_PLANE_STRIDE(p_frame_info, plane) +
+			pixel_offset_m2s(p_finfo, plane, p_m2svideosrc->crop_x);
+		p_m2svideosrc->roi_line_size[plane] =
+			pixel_offset_m2s(p_finfo, plane, end_x) - pixel_offset_m2s(p_finfo, plane, p_m2svideosrc->crop_x);
+	}
+
+	GST_INFO_OBJECT (p_m2svideosrc, "cropping %ux%u+%u+%u out of %ux%u",
+	                 p_m2svideosrc->crop_width, p_m2svideosrc->crop_height,
+	                 p_m2svideosrc->crop_x, p_m2svideosrc->crop_y, width, height);
+
+	return true;
+}
+
 static gboolean
 gst_m2svideosrc_setcaps (GstBaseSrc * bsrc, GstCaps * caps)
 {
@@ -1227,6 +2481,12 @@ gst_m2svideosrc_setcaps (GstBaseSrc * bsrc, GstCaps * caps)
 
 	/* looks ok here */
 	p_m2svideosrc->info = info;
+	gst_buffer_replace (&p_m2svideosrc->p_last_buffer, NULL);
+	gst_buffer_replace (&p_m2svideosrc->p_last_field, NULL);
+	gst_buffer_replace (&p_m2svideosrc->p_pending_field, NULL);
+
+	if (!set_frame_info_m2s (p_m2svideosrc, &info))
+		goto bad_crop;
 
 	GST_DEBUG_OBJECT (p_m2svideosrc, "size %dx%d, %d/%d fps",
 	                  info.width, info.height, info.fps_n, info.fps_d);
@@ -1237,7 +2497,11 @@ gst_m2svideosrc_setcaps (GstBaseSrc * bsrc, GstCaps * caps)
 	p_m2svideosrc->running_time = 0;
 	p_m2svideosrc->n_frames = 0;
 
-	set_m2s_conf(p_m2svideosrc);
+	/* a source switch requested before this is part of the configuration */
+	p_m2svideosrc->switch_pending = false;
+	/* the frames held were read for the old caps */
+	release_held_leases_m2s(p_m2svideosrc);
+	reconfigure_m2s(p_m2svideosrc, &p_m2svideosrc->info, &p_m2svideosrc->frame_info);
 
 	GST_OBJECT_UNLOCK (p_m2svideosrc);
 
@@ -1256,58 +2520,284 @@ gst_m2svideosrc_setcaps (GstBaseSrc * bsrc, GstCaps * caps)
 		GST_DEBUG_OBJECT (bsrc, "unsupported caps: %" GST_PTR_FORMAT, caps);
 		return FALSE;
 	}
+ bad_crop:
+	{
+		GST_OBJECT_UNLOCK (p_m2svideosrc);
+		GST_ELEMENT_ERROR (p_m2svideosrc, RESOURCE, SETTINGS, (NULL),
+		                   ("crop window %ux%u+%u+%u does not fit the %s frame",
+		                    p_m2svideosrc->crop_width, p_m2svideosrc->crop_height,
+		                    p_m2svideosrc->crop_x, p_m2svideosrc->crop_y,
+		                    gst_video_format_to_string (GST_VIDEO_INFO_FORMAT (&info))));
+		return FALSE;
+	}
 }
 
-static gboolean
-gst_m2svideosrc_query (GstBaseSrc * bsrc, GstQuery * query)
+// Frame rate from the RTP timestamp step between two frames. Doubled, so that
+// the 1501.5 ticks of 59.94 Hz (alternating 1501 and 1502) still match.
+static bool rate_from_rtp_step_m2s(int32_t step, gint *p_fps_n, gint *p_fps_d)
 {
-	gboolean res = FALSE;
-	GstM2svideosrc *src;
+	static const struct { int32_t step2; gint fps_n; gint fps_d; } rates[] = {
+		{3003, 60000, 1001},
+		{3600, 50, 1},
+		{6006, 30000, 1001},
+		{7200, 25, 1},
+	};
+	guint i;
 
-	src = GST_M2SVIDEOSRC (bsrc);
+	for (i = 0; i < G_N_ELEMENTS(rates); i++)
+	{
+		if (ABS(2 * step - rates[i].step2) <= 2)
+		{
+			*p_fps_n = rates[i].fps_n;
+			*p_fps_d = rates[i].fps_d;
+			return true;
+		}
+	}
+	return false;
+}
 
-	switch (GST_QUERY_TYPE (query)) {
-	case GST_QUERY_CONVERT:
+// Sleep on the TAI clock until the given time. unlock() wakes it early.
+static GstFlowReturn clock_wait_m2s(GstM2svideosrc *p_m2svideosrc, uint64_t tai)
+{
+	GstClock *p_clock;
+	GstClockID clock_id;
+	GstClockReturn clock_ret;
+
+	p_clock = gst_m2s_clock_obtain();
+	clock_id = gst_clock_new_single_shot_id(p_clock, tai);
+	gst_object_unref(p_clock);
+
+	GST_OBJECT_LOCK (p_m2svideosrc);
+	if (p_m2svideosrc->sync_flushing)
 	{
-		GstFormat src_fmt, dest_fmt;
-		gint64 src_val, dest_val;
+		GST_OBJECT_UNLOCK (p_m2svideosrc);
+		gst_clock_id_unref(clock_id);
+		return GST_FLOW_FLUSHING;
+	}
+	p_m2svideosrc->sync_clock_id = clock_id;
+	GST_OBJECT_UNLOCK (p_m2svideosrc);
 
-		GST_OBJECT_LOCK (src);
-		gst_query_parse_convert (query, &src_fmt, &src_val, &dest_fmt, &dest_val);
-		res =
-			gst_video_info_convert (&src->info, src_fmt, src_val, dest_fmt,
-			                        &dest_val);
-		gst_query_set_convert (query, src_fmt, src_val, dest_fmt, dest_val);
-		GST_OBJECT_UNLOCK (src);
-		break;
+	clock_ret = gst_clock_id_wait(clock_id, NULL);
+
+	GST_OBJECT_LOCK (p_m2svideosrc);
+	p_m2svideosrc->sync_clock_id = NULL;
+	GST_OBJECT_UNLOCK (p_m2svideosrc);
+	gst_clock_id_unref(clock_id);
+
+	if (clock_ret == GST_CLOCK_UNSCHEDULED)
+	{
+		return GST_FLOW_FLUSHING;
 	}
-	case GST_QUERY_LATENCY:
+	return GST_FLOW_OK;
+}
+
+// Receive with one resolution and scan configured until two frames in a row
+// give a known rate, or for probe-timeout-ms. A stream of another size only raises
+// frame_length_err. The frames are taken as leases like any other, and the
+// stream is left stopped. On success the probe_* fields hold the stream.
+static GstFlowReturn probe_resolution_m2s(GstM2svideosrc *p_m2svideosrc, gint width, gint height, uint8_t scan,
+                                          bool *p_found)
+{
+	GstVideoInfo info;
+	m2s_frame_rate_t frame_rate;
+	m2s_status_t status;
+	GstM2svideosrcLease *p_lease;
+	uint32_t rtp_timestamp;
+	uint32_t last_rtp_timestamp = 0;
+	bool have_last = false;
+	GstFlowReturn ret = GST_FLOW_OK;
+	uint64_t now;
+	uint64_t deadline;
+	gint fps_n = 0;
+	gint fps_d = 1;
+
+	*p_found = false;
+
+	gst_video_info_set_format (&info, (GST_VIDEO_INFO_FORMAT (&p_m2svideosrc->info) != GST_VIDEO_FORMAT_UNKNOWN) ?
+	                           GST_VIDEO_INFO_FORMAT (&p_m2svideosrc->info) : GST_VIDEO_FORMAT_UYVY, width, height);
+	GST_VIDEO_INFO_FPS_N (&info) = (p_m2svideosrc->info.fps_n > 0) ? p_m2svideosrc->info.fps_n : 60000;
+	GST_VIDEO_INFO_FPS_D (&info) = (p_m2svideosrc->info.fps_n > 0) ? p_m2svideosrc->info.fps_d : 1001;
+	set_media_conf_m2s(p_m2svideosrc, &info, &info, scan, &frame_rate);
+
+	m2s_get_status(p_m2svideosrc->strm_id, &status, true);
+	m2s_start(p_m2svideosrc->strm_id);
+
+	deadline = m2s_get_current_tai_ns() + (uint64_t)p_m2svideosrc->probe_timeout_ms * GST_MSECOND;
+	while (!*p_found && (ret == GST_FLOW_OK) && ((now = m2s_get_current_tai_ns()) < deadline))
 	{
-		GST_OBJECT_LOCK (src);
-		if (src->info.fps_n > 0) {
-			GstClockTime latency;
+		p_lease = acquire_lease_m2s(p_m2svideosrc);
+		if (p_lease == nullptr)
+		{
+			if ((m2s_get_status(p_m2svideosrc->strm_id, &status, false) == M2S_RET_SUCCESS) &&
+				(status.rx.frame_length_err > 0))
+			{
+				break;
+			}
+			ret = clock_wait_m2s(p_m2svideosrc, MIN(now + PROBE_POLL_INTERVAL_MS * GST_MSECOND, deadline));
+			continue;
+		}
+		rtp_timestamp = p_lease->rtp_timestamp;
+		release_lease_m2s(p_lease);
 
-			latency =
-				gst_util_uint64_scale (GST_SECOND, src->info.fps_d,
-				                       src->info.fps_n);
-			GST_OBJECT_UNLOCK (src);
-			gst_query_set_latency (query,
-			                       gst_base_src_is_live (GST_BASE_SRC_CAST (src)), latency,
-			                       GST_CLOCK_TIME_NONE);
-			GST_DEBUG_OBJECT (src, "Reporting latency of %" GST_TIME_FORMAT,
-			                  GST_TIME_ARGS (latency));
-			res = TRUE;
-		} else {
-			GST_OBJECT_UNLOCK (src);
+		if (have_last)
+		{
+			*p_found = rate_from_rtp_step_m2s((int32_t)(rtp_timestamp - last_rtp_timestamp), &fps_n, &fps_d);
 		}
-		break;
+		last_rtp_timestamp = rtp_timestamp;
+		have_last = true;
 	}
-	case GST_QUERY_DURATION:{
-		if (bsrc->num_buffers != -1) {
-			GstFormat format;
 
-			gst_query_parse_duration (query, &format, NULL);
-			switch (format) {
+	reclaim_leases_m2s(p_m2svideosrc);
+	m2s_stop(p_m2svideosrc->strm_id);
+	p_m2svideosrc->rtp_unwrap_valid = false;
+
+	if (*p_found)
+	{
+		p_m2svideosrc->probe_width = width;
+		p_m2svideosrc->probe_height = height;
+		p_m2svideosrc->probe_scan = scan;
+		p_m2svideosrc->probe_fps_n = fps_n;
+		p_m2svideosrc->probe_fps_d = fps_d;
+	}
+	return ret;
+}
+
+// Detect the stream before the streaming thread negotiates, so that get_caps
+// offers exactly what is received. Without a stream the supported caps are
+// negotiated as before. Each resolution is given its own probe-timeout-ms, and
+// the stream is left configured as it was.
+static void probe_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	bool found = false;
+
+	p_m2svideosrc->probe_width = 0;
+	if (!p_m2svideosrc->auto_caps)
+	{
+		return;
+	}
+
+	// frames still held downstream from the last PAUSED are of another run of
+	// the stream, the probe must neither free read pointers behind them nor
+	// let m2s overwrite them
+	renew_stream_m2s(p_m2svideosrc);
+
+	// no streaming thread yet, an unlock() from the last PAUSED is over
+	GST_OBJECT_LOCK (p_m2svideosrc);
+	p_m2svideosrc->sync_flushing = false;
+	GST_OBJECT_UNLOCK (p_m2svideosrc);
+
+	probe_resolution_m2s (p_m2svideosrc, 1920, 1080, p_m2svideosrc->scan, &found);
+	if (!found)
+	{
+		probe_resolution_m2s (p_m2svideosrc, 3840, 2160, p_m2svideosrc->scan, &found);
+	}
+
+	if (GST_VIDEO_INFO_FORMAT (&p_m2svideosrc->info) != GST_VIDEO_FORMAT_UNKNOWN)
+	{
+		set_m2s_conf(p_m2svideosrc, &p_m2svideosrc->info, &p_m2svideosrc->frame_info);
+	}
+
+	if (found)
+	{
+		GST_INFO_OBJECT (p_m2svideosrc, "detected %dx%d at %d/%d",
+		                 p_m2svideosrc->probe_width, p_m2svideosrc->probe_height,
+		                 p_m2svideosrc->probe_fps_n, p_m2svideosrc->probe_fps_d);
+	}
+	else
+	{
+		GST_WARNING_OBJECT (p_m2svideosrc, "no stream detected within %u ms, negotiating without it",
+		                    p_m2svideosrc->probe_timeout_ms);
+	}
+}
+
+// A frame waits playout-delay-ms in m2s, then sits in the application FIFO
+// at the depth observed by the frame selection, plus the frame being received.
+// The most it waits is the deepest the FIFO was seen. Until the first frame
+// the depths the selection aims for stand in.
+// In genlock mode it is held for genlock-offset and up to one frame more.
+// The frame synchronizer, also once AUTO found an asynchronous stream, keeps
+// one frame.
+static void
+get_latency_m2s (GstM2svideosrc * src, GstClockTime * p_min, GstClockTime * p_max)
+{
+	GstClockTime frame_duration = gst_util_uint64_scale (GST_SECOND, src->info.fps_d, src->info.fps_n);
+	GstClockTime playout_delay = (GstClockTime)MAX (src->playout_delay_ms, 0) * GST_MSECOND;
+	uint32_t depth;
+	uint32_t peak;
+
+	if (is_genlock (src))
+	{
+		*p_min = playout_delay + src->genlock_offset + frame_duration;
+		*p_max = *p_min + frame_duration;
+		return;
+	}
+
+	peak = src->fifo_over_threshold;
+	if ((src->frame_sync == GST_M2SVIDEOSRC_FRAME_SYNC_ON) || src->frame_sync_active)
+		depth = 1;
+	else if (src->read_select)
+		depth = 0;
+	else if (src->fifo_depth_valid) {
+		depth = src->fifo_depth;
+		peak = src->fifo_depth_peak;
+	} else if (src->adaptive_fifo)
+		depth = src->adaptive_target;
+	else
+		depth = src->fifo_middle;
+
+	*p_min = playout_delay + (depth + 1) * frame_duration;
+	*p_max = playout_delay + (MAX (peak, depth) + 1) * frame_duration;
+}
+
+static gboolean
+gst_m2svideosrc_query (GstBaseSrc * bsrc, GstQuery * query)
+{
+	gboolean res = FALSE;
+	GstM2svideosrc *src;
+
+	src = GST_M2SVIDEOSRC (bsrc);
+
+	switch (GST_QUERY_TYPE (query)) {
+	case GST_QUERY_CONVERT:
+	{
+		GstFormat src_fmt, dest_fmt;
+		gint64 src_val, dest_val;
+
+		GST_OBJECT_LOCK (src);
+		gst_query_parse_convert (query, &src_fmt, &src_val, &dest_fmt, &dest_val);
+		res =
+			gst_video_info_convert (&src->info, src_fmt, src_val, dest_fmt,
+			                        &dest_val);
+		gst_query_set_convert (query, src_fmt, src_val, dest_fmt, dest_val);
+		GST_OBJECT_UNLOCK (src);
+		break;
+	}
+	case GST_QUERY_LATENCY:
+	{
+		GST_OBJECT_LOCK (src);
+		if (src->info.fps_n > 0) {
+			GstClockTime min_latency, max_latency;
+
+			get_latency_m2s (src, &min_latency, &max_latency);
+			GST_OBJECT_UNLOCK (src);
+			gst_query_set_latency (query,
+			                       gst_base_src_is_live (GST_BASE_SRC_CAST (src)), min_latency,
+			                       max_latency);
+			GST_DEBUG_OBJECT (src, "Reporting latency of min %" GST_TIME_FORMAT
+			                  " max %" GST_TIME_FORMAT,
+			                  GST_TIME_ARGS (min_latency), GST_TIME_ARGS (max_latency));
+			res = TRUE;
+		} else {
+			GST_OBJECT_UNLOCK (src);
+		}
+		break;
+	}
+	case GST_QUERY_DURATION:{
+		if (bsrc->num_buffers != -1) {
+			GstFormat format;
+
+			gst_query_parse_duration (query, &format, NULL);
+			switch (format) {
 			case GST_FORMAT_TIME:{
 				gint64 dur;
 
@@ -1342,12 +2832,65 @@ gst_m2svideosrc_query (GstBaseSrc * bsrc, GstQuery * query)
 	return res;
 }
 
+static gboolean
+gst_m2svideosrc_event (GstBaseSrc * bsrc, GstEvent * event)
+{
+	GstM2svideosrc *src = GST_M2SVIDEOSRC (bsrc);
+	GstQOSType type;
+	gdouble proportion;
+	GstClockTimeDiff diff;
+	GstClockTime timestamp;
+	GstClockTime frame_duration;
+
+	if (GST_EVENT_TYPE (event) != GST_EVENT_QOS)
+	{
+		return GST_BASE_SRC_CLASS (parent_class)->event (bsrc, event);
+	}
+
+	gst_event_parse_qos (event, &type, &proportion, &diff, &timestamp);
+
+	GST_OBJECT_LOCK (src);
+	src->qos_proportion = proportion;
+	if (G_LIKELY (GST_CLOCK_TIME_IS_VALID (timestamp)))
+	{
+		if (G_UNLIKELY (diff > 0))
+		{
+			/* like the video decoders, assume downstream stays as late again
+			 * and that the next frame takes another frame duration */
+			frame_duration = (src->info.fps_n > 0) ?
+				gst_util_uint64_scale (GST_SECOND, src->info.fps_d, src->info.fps_n) : 0;
+			src->qos_earliest_time = timestamp + 2 * diff + frame_duration;
+		}
+		else
+		{
+			src->qos_earliest_time = timestamp + diff;
+		}
+	}
+	else
+	{
+		src->qos_earliest_time = GST_CLOCK_TIME_NONE;
+	}
+	GST_OBJECT_UNLOCK (src);
+
+	GST_LOG_OBJECT (src, "QoS: proportion %g, diff %" GST_STIME_FORMAT ", earliest %" GST_TIME_FORMAT,
+	                proportion, GST_STIME_ARGS (diff), GST_TIME_ARGS (src->qos_earliest_time));
+
+	return TRUE;
+}
+
 static void
 gst_m2svideosrc_get_times (GstBaseSrc * basesrc, GstBuffer * buffer,
                            GstClockTime * start, GstClockTime * end)
 {
+	GstM2svideosrc *src = GST_M2SVIDEOSRC (basesrc);
+
+	/* in read-select mode the frame arrival already paces us, and the frame
+	 * synchronizer waits for the local frame boundary itself */
+	if (src->read_select || src->frame_sync_active) {
+		*start = -1;
+		*end = -1;
 	/* for live sources, sync on the timestamp of the buffer */
-	if (gst_base_src_is_live (basesrc)) {
+	} else if (gst_base_src_is_live (basesrc)) {
 		GstClockTime timestamp = GST_BUFFER_PTS (buffer);
 
 		if (GST_CLOCK_TIME_IS_VALID (timestamp)) {
@@ -1408,156 +2951,1331 @@ gst_m2svideosrc_is_seekable (GstBaseSrc * psrc)
 
 static inline void get_ptr_m2s(GstM2svideosrc *p_m2svideosrc)
 {
-	m2s_media_t media;
-	m2s_media_size_t size;
-	m2s_get_read_ptr(p_m2svideosrc->strm_id, nullptr, &media, &size);
-	p_m2svideosrc->p_frame_from_m2s = media.video.p_frame;
-	p_m2svideosrc->frame_size_from_m2s = size.video.frame_size;
+	p_m2svideosrc->p_cur_lease = acquire_lease_m2s(p_m2svideosrc);
 }
 
 static inline void free_and_get_ptr_m2s(GstM2svideosrc *p_m2svideosrc)
 {
-	m2s_free_read_ptr(p_m2svideosrc->strm_id);
+	if (p_m2svideosrc->p_cur_lease != nullptr)
+	{
+		release_lease_m2s(p_m2svideosrc->p_cur_lease);
+	}
 	get_ptr_m2s(p_m2svideosrc);
 }
 
-static inline void read_from_m2s(GstM2svideosrc *p_m2svideosrc, GstVideoFrame *p_frame)
+// Closed-loop replacement for the fifo-under/middle/over rule. The spread of
+// app_fifo_stored over a window is taken as the arrival jitter; the target depth
+// follows it, rising at once on the first underflow of a window and otherwise
+// moving at the end of the window. It changes at most once per window, so one
+// burst of underflows does not push it to the top.
+static inline void adaptive_select_m2s(GstM2svideosrc *p_m2svideosrc, uint32_t stored, bool *p_write_m2s, bool *p_inc_under)
 {
-	uint8_t *p_gst_dst = (uint8_t *)GST_VIDEO_FRAME_PLANE_DATA (p_frame, 0);
-	uint32_t gst_size = (uint32_t)GST_VIDEO_FRAME_SIZE(p_frame);
-	m2s_status_t status;
-	bool write_m2s = false;
-	bool inc_under = false;
+	uint32_t jitter;
 
-	if (m2s_get_status(p_m2svideosrc->strm_id, &status, false) == M2S_RET_SUCCESS)
+	if (p_m2svideosrc->p_cur_lease == nullptr)
 	{
-		if (p_m2svideosrc->p_frame_from_m2s == nullptr)
+		if (stored >= p_m2svideosrc->adaptive_target)
 		{
-			if (status.rx.app_fifo_stored >= p_m2svideosrc->fifo_middle)
-			{
-				get_ptr_m2s(p_m2svideosrc);
-				write_m2s = true;
-			}
+			get_ptr_m2s(p_m2svideosrc);
+			*p_write_m2s = true;
 		}
-		else
+		return;
+	}
+
+	p_m2svideosrc->adaptive_depth_avg += (stored - p_m2svideosrc->adaptive_depth_avg) / 16.0;
+	p_m2svideosrc->adaptive_window_min = MIN(p_m2svideosrc->adaptive_window_min, stored);
+	p_m2svideosrc->adaptive_window_max = MAX(p_m2svideosrc->adaptive_window_max, stored);
+
+	if (stored == 0)
+	{
+		p_m2svideosrc->adaptive_repeated++;
+		*p_inc_under = true;
+		if (!p_m2svideosrc->adaptive_raised)
 		{
-			if (status.rx.app_fifo_stored > p_m2svideosrc->fifo_over_threshold)
-			{
-				free_and_get_ptr_m2s(p_m2svideosrc);
-				free_and_get_ptr_m2s(p_m2svideosrc);
-			}
-			else if (status.rx.app_fifo_stored >= p_m2svideosrc->fifo_under_threshold)
+			set_adaptive_target(p_m2svideosrc, p_m2svideosrc->adaptive_target + 1,
+			                    p_m2svideosrc->adaptive_window_max - p_m2svideosrc->adaptive_window_min);
+			p_m2svideosrc->adaptive_raised = true;
+		}
+	}
+	else if ((stored >= 2) && (p_m2svideosrc->adaptive_depth_avg > p_m2svideosrc->adaptive_target + 1))
+	{
+		free_and_get_ptr_m2s(p_m2svideosrc);
+		free_and_get_ptr_m2s(p_m2svideosrc);
+		p_m2svideosrc->adaptive_dropped++;
+		p_m2svideosrc->adaptive_depth_avg -= 1.0;
+	}
+	else
+	{
+		free_and_get_ptr_m2s(p_m2svideosrc);
+	}
+	*p_write_m2s = true;
+
+	if (++p_m2svideosrc->adaptive_window_frames >= p_m2svideosrc->adaptive_window)
+	{
+		jitter = p_m2svideosrc->adaptive_window_max - p_m2svideosrc->adaptive_window_min;
+		// an underflow already raised the target in this window
+		if (!p_m2svideosrc->adaptive_raised)
+		{
+			if (jitter + 1 < p_m2svideosrc->adaptive_target)
 			{
-				free_and_get_ptr_m2s(p_m2svideosrc);
+				set_adaptive_target(p_m2svideosrc, p_m2svideosrc->adaptive_target - 1, jitter);
 			}
-			else
+			else if (jitter + 1 > p_m2svideosrc->adaptive_target)
 			{
-				inc_under = true;
+				set_adaptive_target(p_m2svideosrc, jitter + 1, jitter);
 			}
-			write_m2s = true;
 		}
+		p_m2svideosrc->adaptive_window_frames = 0;
+		p_m2svideosrc->adaptive_window_min = G_MAXUINT32;
+		p_m2svideosrc->adaptive_window_max = 0;
+		p_m2svideosrc->adaptive_raised = false;
+	}
+}
 
-		if (inc_under)
+// Genlock: of the queued frames, take the newest one captured no later than
+// genlock-offset before now, and free everything older in one go. The first frame
+// that is still too new is kept in p_next_lease, since a read pointer cannot be
+// handed back to m2s without freeing it.
+static inline void genlock_select_m2s(GstM2svideosrc *p_m2svideosrc, bool *p_write_m2s, bool *p_inc_under)
+{
+	uint64_t now_tai = m2s_get_current_tai_ns();
+	uint64_t target_tai = (now_tai > p_m2svideosrc->genlock_offset) ? now_tai - p_m2svideosrc->genlock_offset : 0;
+	GstM2svideosrcLease *p_next;
+	bool received = false;
+	guint skipped = 0;
+
+	for (;;)
+	{
+		p_next = p_m2svideosrc->p_next_lease;
+		p_m2svideosrc->p_next_lease = nullptr;
+		if (p_next == nullptr)
 		{
-			p_m2svideosrc->under_count++;
+			p_next = acquire_lease_m2s(p_m2svideosrc);
+			if (p_next == nullptr)
+			{
+				break;
+			}
 		}
-		else
+		received = true;
+
+		if (p_next->capture_tai > target_tai)
 		{
-			p_m2svideosrc->under_count = 0;
+			p_m2svideosrc->p_next_lease = p_next;
+			break;
 		}
 
-		if ((p_m2svideosrc->p_frame_from_m2s != nullptr) &&
-			((gst_size != p_m2svideosrc->frame_size_from_m2s) || (p_m2svideosrc->under_count >= p_m2svideosrc->under_count_max)))
+		if (p_m2svideosrc->p_cur_lease != nullptr)
 		{
-			m2s_free_read_ptr(p_m2svideosrc->strm_id);
-			p_m2svideosrc->p_frame_from_m2s = nullptr;
-			p_m2svideosrc->under_count = 0;
-			write_m2s = false;
+			if (p_m2svideosrc->p_cur_lease->seq != p_m2svideosrc->last_output_seq)
+			{
+				skipped++;
+			}
+			release_lease_m2s(p_m2svideosrc->p_cur_lease);
 		}
+		p_m2svideosrc->p_cur_lease = p_next;
 	}
 
-	if (write_m2s)
+	if (skipped > 0)
 	{
-		memcpy(p_gst_dst, p_m2svideosrc->p_frame_from_m2s, gst_size);
+		GST_LOG_OBJECT (p_m2svideosrc, "genlock: freed %u frames older than %" G_GUINT64_FORMAT,
+		                skipped, target_tai);
 	}
-	else
+
+	// nothing arrived at all, count it like an underflow
+	*p_inc_under = !received;
+	*p_write_m2s = (p_m2svideosrc->p_cur_lease != nullptr);
+}
+
+// A frame of another size than negotiated is freed; auto-caps takes it as a
+// sign that the sender changed format.
+static inline bool frame_size_mismatch_m2s(GstM2svideosrc *p_m2svideosrc, uint32_t gst_size)
+{
+	if (p_m2svideosrc->p_cur_lease->frame_size == gst_size)
 	{
-		memset(p_gst_dst, 0, gst_size);
+		return false;
 	}
+	p_m2svideosrc->size_mismatch = true;
+	return true;
 }
 
-static GstFlowReturn
-gst_m2svideosrc_fill (GstPushSrc * psrc, GstBuffer * buffer)
+// Point the running stream at the addresses set by switch-source. The frames
+// already stored are from the old source, and so may be the one being received,
+// so that many are skipped before the first frame of the new source is taken.
+static void switch_source_m2s(GstM2svideosrc *p_m2svideosrc)
 {
-	GstM2svideosrc *src;
-	GstClockTime next_time;
-	GstVideoFrame frame;
-
-	src = GST_M2SVIDEOSRC (psrc);
-
-	if (G_UNLIKELY (GST_VIDEO_INFO_FORMAT (&src->info) ==
-	                GST_VIDEO_FORMAT_UNKNOWN))
-		goto not_negotiated;
+	m2s_ip_conf_t ip_conf;
+	m2s_status_t status;
 
-	/* 0 framerate and we are at the second frame, eos */
-	if (G_UNLIKELY (src->info.fps_n == 0 && src->n_frames == 1))
-		goto eos;
+	GST_OBJECT_LOCK (p_m2svideosrc);
+	if (!p_m2svideosrc->switch_pending)
+	{
+		GST_OBJECT_UNLOCK (p_m2svideosrc);
+		return;
+	}
+	p_m2svideosrc->switch_pending = false;
+	get_ip_conf_m2s(p_m2svideosrc, &ip_conf);
+	GST_OBJECT_UNLOCK (p_m2svideosrc);
 
-	if (G_UNLIKELY (src->n_frames == -1)) {
-		/* EOS for reverse playback */
-		goto eos;
+	if (p_m2svideosrc->p_next_lease != nullptr)
+	{
+		release_lease_m2s(p_m2svideosrc->p_next_lease);
+		p_m2svideosrc->p_next_lease = nullptr;
 	}
 
-	GST_LOG_OBJECT (src,
-	                "creating buffer from pool for frame %" G_GINT64_FORMAT, src->n_frames);
+	p_m2svideosrc->switch_tai = m2s_get_current_tai_ns();
+	if (m2s_set_ip_conf(p_m2svideosrc->strm_id, &ip_conf) != M2S_RET_SUCCESS)
+	{
+		GST_DEBUG_OBJECT (p_m2svideosrc, "IP configuration not taken while running, restarting the stream");
+		GST_OBJECT_LOCK (p_m2svideosrc);
+		/* as in setcaps, the frames held are of the stream being restarted */
+		release_held_leases_m2s(p_m2svideosrc);
+		reconfigure_m2s(p_m2svideosrc, &p_m2svideosrc->info, &p_m2svideosrc->frame_info);
+		GST_OBJECT_UNLOCK (p_m2svideosrc);
+	}
 
-	if (!gst_video_frame_map (&frame, &src->info, buffer, GST_MAP_WRITE))
-		goto invalid_frame;
+	p_m2svideosrc->switch_skip = 1;
+	if (m2s_get_status(p_m2svideosrc->strm_id, &status, false) == M2S_RET_SUCCESS)
+	{
+		p_m2svideosrc->switch_skip += status.rx.app_fifo_stored;
+	}
+	p_m2svideosrc->switch_held = 0;
+	p_m2svideosrc->switch_holding = true;
+	p_m2svideosrc->rtp_unwrap_valid = false;
+	p_m2svideosrc->under_count = 0;
 
-	GST_BUFFER_PTS (buffer) =
-		src->accum_rtime + src->timestamp_offset + src->running_time;
-	GST_BUFFER_DTS (buffer) = GST_CLOCK_TIME_NONE;
+	GST_INFO_OBJECT (p_m2svideosrc, "switching to %s / %s, skipping %u frames",
+	                 p_m2svideosrc->dst_ip[0], p_m2svideosrc->dst_ip[1], p_m2svideosrc->switch_skip);
+}
 
-	gst_object_sync_values (GST_OBJECT (psrc), GST_BUFFER_PTS (buffer));
+// While switching, the last frame is held until the first frame received
+// wholly from the new source, which ends the switch.
+static inline bool switch_select_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	uint32_t gst_size = (uint32_t)GST_VIDEO_INFO_SIZE(&p_m2svideosrc->frame_info);
+	m2s_status_t status;
+	uint32_t stored = 0;
 
-	read_from_m2s(src, &frame);
+	if (m2s_get_status(p_m2svideosrc->strm_id, &status, false) == M2S_RET_SUCCESS)
+	{
+		stored = status.rx.app_fifo_stored;
+	}
 
-	gst_video_frame_unmap (&frame);
+	for (; stored > 0; stored--)
+	{
+		free_and_get_ptr_m2s(p_m2svideosrc);
+		if (p_m2svideosrc->p_cur_lease == nullptr)
+		{
+			break;
+		}
+		if (p_m2svideosrc->switch_skip > 0)
+		{
+			p_m2svideosrc->switch_skip--;
+			continue;
+		}
+		if (frame_size_mismatch_m2s(p_m2svideosrc, gst_size))
+		{
+			continue;
+		}
 
-	GST_DEBUG_OBJECT (src, "Timestamp: %" GST_TIME_FORMAT " = accumulated %"
-	                  GST_TIME_FORMAT " + offset: %"
-	                  GST_TIME_FORMAT " + running time: %" GST_TIME_FORMAT,
-	                  GST_TIME_ARGS (GST_BUFFER_PTS (buffer)), GST_TIME_ARGS (src->accum_rtime),
-	                  GST_TIME_ARGS (src->timestamp_offset), GST_TIME_ARGS (src->running_time));
+		p_m2svideosrc->switch_holding = false;
+		p_m2svideosrc->last_switch_time = m2s_get_current_tai_ns() - p_m2svideosrc->switch_tai;
+		GST_INFO_OBJECT (p_m2svideosrc, "switched in %" GST_TIME_FORMAT ", %" G_GUINT64_FORMAT " frames held",
+		                 GST_TIME_ARGS (p_m2svideosrc->last_switch_time), p_m2svideosrc->switch_held);
+		gst_element_post_message (GST_ELEMENT (p_m2svideosrc),
+		                          gst_message_new_element (GST_OBJECT (p_m2svideosrc),
+		                                                   gst_structure_new ("m2s-switch",
+		                                                                      "switch-time", G_TYPE_UINT64, (guint64)p_m2svideosrc->last_switch_time,
+		                                                                      "held", G_TYPE_UINT64, (guint64)p_m2svideosrc->switch_held,
+		                                                                      NULL)));
+		return true;
+	}
 
-	GST_BUFFER_OFFSET (buffer) = src->accum_frames + src->n_frames;
-	if (src->reverse) {
-		src->n_frames--;
-	} else {
-		src->n_frames++;
+	// a skipped frame or the one from before the switch is never output
+	if (p_m2svideosrc->p_cur_lease != nullptr)
+	{
+		release_lease_m2s(p_m2svideosrc->p_cur_lease);
+		p_m2svideosrc->p_cur_lease = nullptr;
 	}
-	GST_BUFFER_OFFSET_END (buffer) = GST_BUFFER_OFFSET (buffer) + 1;
-	if (src->info.fps_n) {
-		next_time = gst_util_uint64_scale (src->n_frames,
-		                                   src->info.fps_d * GST_SECOND, src->info.fps_n);
-		if (src->reverse) {
-			/* We already decremented to next frame */
-			GstClockTime prev_pts = gst_util_uint64_scale (src->n_frames + 2,
-			                                               src->info.fps_d * GST_SECOND, src->info.fps_n);
+	p_m2svideosrc->switch_held++;
+	return false;
+}
 
-			GST_BUFFER_DURATION (buffer) = prev_pts - GST_BUFFER_PTS (buffer);
-		} else {
-			GST_BUFFER_DURATION (buffer) = next_time - src->running_time;
-		}
-	} else {
-		next_time = src->timestamp_offset;
-		/* NONE means forever */
-		GST_BUFFER_DURATION (buffer) = GST_CLOCK_TIME_NONE;
+// Action signal handler. The switch itself is done by the streaming thread
+// before its next frame; before that thread runs the addresses are only
+// stored, like the properties.
+static gboolean
+gst_m2svideosrc_switch_source (GstM2svideosrc * src, const gchar * p_dst_address, const gchar * s_dst_address)
+{
+	if (((p_dst_address != NULL) && (m2s_conv_ip_address_from_string(p_dst_address) == 0)) ||
+		((s_dst_address != NULL) && (*s_dst_address != '\0') && (m2s_conv_ip_address_from_string(s_dst_address) == 0)))
+	{
+		GST_WARNING_OBJECT (src, "switch-source: invalid address %s / %s",
+		                    GST_STR_NULL (p_dst_address), GST_STR_NULL (s_dst_address));
+		return FALSE;
 	}
 
-	src->running_time = next_time;
+	GST_OBJECT_LOCK (src);
+	if (p_dst_address != NULL)
+		gst_m2svideosrc_set_p_dst_address (src, p_dst_address);
+	if (s_dst_address != NULL)
+		gst_m2svideosrc_set_s_dst_address (src, s_dst_address);
+	src->switch_pending = src->m2s_started;
+	GST_OBJECT_UNLOCK (src);
 
-	return GST_FLOW_OK;
+	return TRUE;
+}
+
+// Find the new format of a running stream: the current one first, in case the
+// errors were transient, then the other scan and the other resolution. Each
+// is given its own probe-timeout-ms, and unlock() ends the search. On success
+// the caps follow on the next negotiation, which reconfigures m2s.
+static GstFlowReturn redetect_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	gint width = GST_VIDEO_INFO_WIDTH(&p_m2svideosrc->frame_info);
+	gint height = GST_VIDEO_INFO_HEIGHT(&p_m2svideosrc->frame_info);
+	gint other_width = (width == 3840) ? 1920 : 3840;
+	gint other_height = (height == 2160) ? 1080 : 2160;
+	uint8_t scan = scan_m2s(p_m2svideosrc);
+	uint8_t other_scan = (scan == M2S_VIDEO_SCAN_PROGRESSIVE) ? M2S_VIDEO_SCAN_INTERLACE_TFF : M2S_VIDEO_SCAN_PROGRESSIVE;
+	const struct { gint width; gint height; uint8_t scan; } formats[] = {
+		{width, height, scan},
+		{width, height, other_scan},
+		{other_width, other_height, scan},
+		{other_width, other_height, other_scan},
+	};
+	GstFlowReturn ret = GST_FLOW_OK;
+	bool found = false;
+	bool started;
+	guint i;
+
+	GST_INFO_OBJECT (p_m2svideosrc, "frame size errors, looking for a new stream format");
+
+	/* a frame of the old format is no use to repeat */
+	if (p_m2svideosrc->p_last_buffer != nullptr)
+	{
+		gst_buffer_unref(p_m2svideosrc->p_last_buffer);
+		p_m2svideosrc->p_last_buffer = nullptr;
+	}
+	gst_buffer_replace (&p_m2svideosrc->p_last_field, NULL);
+	p_m2svideosrc->under_count = 0;
+	p_m2svideosrc->rtp_unwrap_valid = false;
+	p_m2svideosrc->sync_valid = false;
+
+	stop_m2s(p_m2svideosrc);
+
+	for (i = 0; (i < G_N_ELEMENTS(formats)) && !found && (ret == GST_FLOW_OK); i++)
+	{
+		ret = probe_resolution_m2s(p_m2svideosrc, formats[i].width, formats[i].height, formats[i].scan, &found);
+	}
+
+	if (found)
+	{
+		GST_INFO_OBJECT (p_m2svideosrc, "stream changed to %dx%d%s at %d/%d",
+		                 p_m2svideosrc->probe_width, p_m2svideosrc->probe_height,
+		                 (p_m2svideosrc->probe_scan == M2S_VIDEO_SCAN_PROGRESSIVE) ? "p" : "i",
+		                 p_m2svideosrc->probe_fps_n, p_m2svideosrc->probe_fps_d);
+
+		/* a crop window keeps its caps, only the frame around it changes */
+		GST_OBJECT_LOCK (p_m2svideosrc);
+		if (p_m2svideosrc->crop && !set_frame_info_m2s(p_m2svideosrc, &p_m2svideosrc->info))
+		{
+			GST_WARNING_OBJECT (p_m2svideosrc, "crop window does not fit the new frame");
+		}
+		GST_OBJECT_UNLOCK (p_m2svideosrc);
+
+		gst_pad_mark_reconfigure (GST_BASE_SRC_PAD (p_m2svideosrc));
+	}
+	else if (ret == GST_FLOW_OK)
+	{
+		GST_WARNING_OBJECT (p_m2svideosrc, "no new stream format found");
+	}
+
+	/* unchanged caps are not set again, so configure for the current ones */
+	set_m2s_conf(p_m2svideosrc, &p_m2svideosrc->info, &p_m2svideosrc->frame_info);
+	GST_OBJECT_LOCK (p_m2svideosrc);
+	started = p_m2svideosrc->m2s_started;
+	GST_OBJECT_UNLOCK (p_m2svideosrc);
+	if (started)
+	{
+		start_m2s(p_m2svideosrc);
+	}
+	return ret;
+}
+
+// With auto-caps, frames of another size or a rising frame_length_err for
+// FORMAT_CHANGE_FRAMES frames in a row mean the sender changed format.
+static GstFlowReturn check_format_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	m2s_status_t status;
+	bool error = p_m2svideosrc->size_mismatch;
+
+	p_m2svideosrc->size_mismatch = false;
+	if (m2s_get_status(p_m2svideosrc->strm_id, &status, false) == M2S_RET_SUCCESS)
+	{
+		// the monitoring thread clears the counters
+		if (status.rx.frame_length_err < p_m2svideosrc->last_frame_length_err)
+		{
+			p_m2svideosrc->last_frame_length_err = 0;
+		}
+		error = error || (status.rx.frame_length_err > p_m2svideosrc->last_frame_length_err);
+		p_m2svideosrc->last_frame_length_err = status.rx.frame_length_err;
+	}
+
+	p_m2svideosrc->format_errors = error ? p_m2svideosrc->format_errors + 1 : 0;
+	if (p_m2svideosrc->format_errors >= FORMAT_CHANGE_FRAMES)
+	{
+		p_m2svideosrc->format_errors = 0;
+		return redetect_m2s(p_m2svideosrc);
+	}
+	return GST_FLOW_OK;
+}
+
+static inline bool is_frame_sync(GstM2svideosrc *p_m2svideosrc)
+{
+	m2s_status_t status;
+
+	if (p_m2svideosrc->frame_sync != GST_M2SVIDEOSRC_FRAME_SYNC_AUTO)
+	{
+		return p_m2svideosrc->frame_sync == GST_M2SVIDEOSRC_FRAME_SYNC_ON;
+	}
+
+	return (m2s_get_status(p_m2svideosrc->strm_id, &status, false) == M2S_RET_SUCCESS) && status.rx.async_stream;
+}
+
+// Sleep on the TAI clock until the next local frame boundary. The boundaries are
+// counted from one base so that they do not drift; after falling more than a
+// frame behind the count restarts from now.
+static GstFlowReturn frame_sync_wait_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	GstClockTime frame_duration = gst_util_uint64_scale (GST_SECOND, p_m2svideosrc->info.fps_d, p_m2svideosrc->info.fps_n);
+	uint64_t now_tai = m2s_get_current_tai_ns();
+
+	if (!p_m2svideosrc->sync_valid || (now_tai > p_m2svideosrc->sync_next_tai + frame_duration))
+	{
+		p_m2svideosrc->sync_base_tai = now_tai;
+		p_m2svideosrc->sync_frame = 0;
+		p_m2svideosrc->sync_valid = true;
+	}
+	p_m2svideosrc->sync_next_tai = m2s_calc_next_video_alignment_point(p_m2svideosrc->sync_base_tai,
+	                                                                   p_m2svideosrc->m2s_frame_rate,
+	                                                                   p_m2svideosrc->sync_frame++);
+
+	return clock_wait_m2s(p_m2svideosrc, p_m2svideosrc->sync_next_tai);
+}
+
+// At a frame boundary take the next frame and drop all but one of the frames
+// queued behind it, which is kept to absorb the arrival jitter. Without a new
+// frame the current one is repeated. Either way no frame memory is touched here.
+static inline bool select_frame_sync_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	uint32_t gst_size = (uint32_t)GST_VIDEO_INFO_SIZE(&p_m2svideosrc->frame_info);
+	m2s_status_t status;
+	uint32_t stored = 0;
+
+	if (m2s_get_status(p_m2svideosrc->strm_id, &status, false) == M2S_RET_SUCCESS)
+	{
+		stored = status.rx.app_fifo_stored;
+	}
+
+	if (stored == 0)
+	{
+		if (p_m2svideosrc->p_cur_lease != nullptr)
+		{
+			p_m2svideosrc->sync_repeated++;
+			p_m2svideosrc->under_count++;
+		}
+	}
+	else
+	{
+		free_and_get_ptr_m2s(p_m2svideosrc);
+		while ((--stored > 1) && (p_m2svideosrc->p_cur_lease != nullptr))
+		{
+			free_and_get_ptr_m2s(p_m2svideosrc);
+			p_m2svideosrc->sync_dropped++;
+		}
+		p_m2svideosrc->under_count = 0;
+	}
+
+	if ((p_m2svideosrc->p_cur_lease != nullptr) &&
+		(frame_size_mismatch_m2s(p_m2svideosrc, gst_size) || (p_m2svideosrc->under_count >= p_m2svideosrc->under_count_max)))
+	{
+		release_lease_m2s(p_m2svideosrc->p_cur_lease);
+		p_m2svideosrc->p_cur_lease = nullptr;
+		p_m2svideosrc->under_count = 0;
+	}
+
+	return p_m2svideosrc->p_cur_lease != nullptr;
+}
+
+// Genlock was turned off with a frame queued. It is older than any frame still
+// in m2s, so it becomes the current one before the next selection reads on.
+static inline void take_next_lease_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	if (p_m2svideosrc->p_cur_lease != nullptr)
+	{
+		release_lease_m2s(p_m2svideosrc->p_cur_lease);
+	}
+	p_m2svideosrc->p_cur_lease = p_m2svideosrc->p_next_lease;
+	p_m2svideosrc->p_next_lease = nullptr;
+}
+
+// The depth the frames actually wait in the application FIFO, for the latency
+// query. Once the average moved a whole frame, or a new peak was seen, the
+// pipeline is asked to query again.
+static void observe_fifo_m2s(GstM2svideosrc *p_m2svideosrc, uint32_t stored)
+{
+	uint32_t depth;
+	bool changed;
+
+	if (!p_m2svideosrc->fifo_observed)
+	{
+		p_m2svideosrc->fifo_depth_avg = stored;
+		p_m2svideosrc->fifo_observed = true;
+	}
+	else
+	{
+		p_m2svideosrc->fifo_depth_avg += (stored - p_m2svideosrc->fifo_depth_avg) / 16.0;
+	}
+
+	GST_OBJECT_LOCK (p_m2svideosrc);
+	depth = p_m2svideosrc->fifo_depth;
+	changed = !p_m2svideosrc->fifo_depth_valid || (stored > p_m2svideosrc->fifo_depth_peak) ||
+		(p_m2svideosrc->fifo_depth_avg >= depth + 1.0) || (p_m2svideosrc->fifo_depth_avg + 1.0 <= depth);
+	if (changed)
+	{
+		p_m2svideosrc->fifo_depth = (uint32_t)(p_m2svideosrc->fifo_depth_avg + 0.5);
+		p_m2svideosrc->fifo_depth_peak = MAX(p_m2svideosrc->fifo_depth_peak, stored);
+		p_m2svideosrc->fifo_depth_valid = true;
+	}
+	GST_OBJECT_UNLOCK (p_m2svideosrc);
+
+	if (changed)
+	{
+		GST_DEBUG_OBJECT (p_m2svideosrc, "FIFO depth %u, peak %u", p_m2svideosrc->fifo_depth, p_m2svideosrc->fifo_depth_peak);
+		gst_element_post_message(GST_ELEMENT(p_m2svideosrc), gst_message_new_latency(GST_OBJECT(p_m2svideosrc)));
+	}
+}
+
+static inline bool select_frame_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	uint32_t gst_size = (uint32_t)GST_VIDEO_INFO_SIZE(&p_m2svideosrc->frame_info);
+	m2s_status_t status;
+	bool write_m2s = false;
+	bool inc_under = false;
+
+	if (m2s_get_status(p_m2svideosrc->strm_id, &status, false) == M2S_RET_SUCCESS)
+	{
+		observe_fifo_m2s(p_m2svideosrc, status.rx.app_fifo_stored);
+
+		if (is_genlock(p_m2svideosrc))
+		{
+			genlock_select_m2s(p_m2svideosrc, &write_m2s, &inc_under);
+		}
+		else if (p_m2svideosrc->adaptive_fifo)
+		{
+			adaptive_select_m2s(p_m2svideosrc, status.rx.app_fifo_stored, &write_m2s, &inc_under);
+		}
+		else if (p_m2svideosrc->p_cur_lease == nullptr)
+		{
+			if (status.rx.app_fifo_stored >= p_m2svideosrc->fifo_middle)
+			{
+				get_ptr_m2s(p_m2svideosrc);
+				write_m2s = true;
+			}
+		}
+		else
+		{
+			if (status.rx.app_fifo_stored > p_m2svideosrc->fifo_over_threshold)
+			{
+				free_and_get_ptr_m2s(p_m2svideosrc);
+				free_and_get_ptr_m2s(p_m2svideosrc);
+			}
+			else if (status.rx.app_fifo_stored >= p_m2svideosrc->fifo_under_threshold)
+			{
+				free_and_get_ptr_m2s(p_m2svideosrc);
+			}
+			else
+			{
+				inc_under = true;
+			}
+			write_m2s = true;
+		}
+
+		if (inc_under)
+		{
+			p_m2svideosrc->under_count++;
+		}
+		else
+		{
+			p_m2svideosrc->under_count = 0;
+		}
+
+		if ((p_m2svideosrc->p_cur_lease != nullptr) &&
+			(frame_size_mismatch_m2s(p_m2svideosrc, gst_size) || (p_m2svideosrc->under_count >= p_m2svideosrc->under_count_max)))
+		{
+			release_lease_m2s(p_m2svideosrc->p_cur_lease);
+			p_m2svideosrc->p_cur_lease = nullptr;
+			p_m2svideosrc->under_count = 0;
+			write_m2s = false;
+		}
+	}
+
+	return write_m2s && (p_m2svideosrc->p_cur_lease != nullptr);
+}
+
+// Wait for the next frame and always output it, so there is exactly one frame
+// in flight and no m2s_get_status() call per frame.
+static inline GstFlowReturn select_frame_m2s_blocking(GstM2svideosrc *p_m2svideosrc, bool *p_write_m2s)
+{
+	uint32_t gst_size = (uint32_t)GST_VIDEO_INFO_SIZE(&p_m2svideosrc->frame_info);
+	m2s_media_size_t read_size;
+	m2s_media_size_t max_read_size;
+	bool stopping;
+
+	max_read_size.video.frame_size = gst_size;
+	if (m2s_read_select(p_m2svideosrc->strm_id, &read_size, &max_read_size, nullptr) != M2S_RET_SUCCESS)
+	{
+		GST_OBJECT_LOCK (p_m2svideosrc);
+		stopping = p_m2svideosrc->sync_flushing || !p_m2svideosrc->m2s_started;
+		GST_OBJECT_UNLOCK (p_m2svideosrc);
+		if (stopping)
+		{
+			// select was disabled by unlock or a state change
+			return GST_FLOW_FLUSHING;
+		}
+		*p_write_m2s = select_frame_m2s(p_m2svideosrc);
+		return GST_FLOW_OK;
+	}
+
+	free_and_get_ptr_m2s(p_m2svideosrc);
+
+	if ((p_m2svideosrc->p_cur_lease != nullptr) && frame_size_mismatch_m2s(p_m2svideosrc, gst_size))
+	{
+		release_lease_m2s(p_m2svideosrc->p_cur_lease);
+		p_m2svideosrc->p_cur_lease = nullptr;
+	}
+
+	*p_write_m2s = p_m2svideosrc->p_cur_lease != nullptr;
+	return GST_FLOW_OK;
+}
+
+static inline bool is_field_output(GstM2svideosrc *p_m2svideosrc)
+{
+	return GST_VIDEO_INFO_INTERLACE_MODE(&p_m2svideosrc->info) == GST_VIDEO_INTERLACE_MODE_ALTERNATE;
+}
+
+// The field sent first (0: top, 1: bottom)
+static inline guint first_field_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	return (scan_m2s(p_m2svideosrc) == M2S_VIDEO_SCAN_INTERLACE_BFF) ? 1 : 0;
+}
+
+// Plane layout of one field (0: top, 1: bottom) inside the m2s frame, starting
+// at the crop window if roi is set. In frame output this is the frame layout itself.
+static void get_field_layout_m2s(GstM2svideosrc *p_m2svideosrc, guint field, bool roi,
+                                 gsize offset[GST_VIDEO_MAX_PLANES], gint stride[GST_VIDEO_MAX_PLANES])
+{
+	GstVideoInfo *p_frame_info = &p_m2svideosrc->frame_info;
+	guint plane;
+
+	for (plane = 0; plane < GST_VIDEO_INFO_N_PLANES(p_frame_info); plane++)
+	{
+		offset[plane] = GST_VIDEO_INFO_PLANE_OFFSET(p_frame_info, plane);
+		stride[plane] = GST_VIDEO_INFO_PLANE_STRIDE(p_frame_info, plane);
+		if (roi)
+		{
+			offset[plane] += p_m2svideosrc->roi_offset[plane];
+		}
+		if (is_field_output(p_m2svideosrc))
+		{
+			offset[plane] += field * stride[plane];
+			stride[plane] *= 2;
+		}
+	}
+}
+
+static inline void read_from_m2s(GstM2svideosrc *p_m2svideosrc, GstVideoFrame *p_frame, bool write_m2s, guint field)
+{
+	uint8_t *p_gst_dst = (uint8_t *)GST_VIDEO_FRAME_PLANE_DATA (p_frame, 0);
+	uint32_t gst_size = (uint32_t)GST_VIDEO_FRAME_SIZE(p_frame);
+	gsize offset[GST_VIDEO_MAX_PLANES];
+	gint stride[GST_VIDEO_MAX_PLANES];
+	uint8_t *p_src;
+	uint8_t *p_dst;
+	gint line_size;
+	guint plane;
+	gint y;
+
+	if (!write_m2s)
+	{
+		memset(p_gst_dst, 0, gst_size);
+	}
+	else if (!is_field_output(p_m2svideosrc) && !p_m2svideosrc->crop)
+	{
+		memcpy(p_gst_dst, p_m2svideosrc->p_cur_lease->p_frame, gst_size);
+	}
+	else
+	{
+		// only the lines of the field and the crop window are read
+		get_field_layout_m2s(p_m2svideosrc, field, true, offset, stride);
+		for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES(p_frame); plane++)
+		{
+			p_src = p_m2svideosrc->p_cur_lease->p_frame + offset[plane];
+			p_dst = (uint8_t *)GST_VIDEO_FRAME_PLANE_DATA(p_frame, plane);
+			line_size = MIN(p_m2svideosrc->roi_line_size[plane], GST_VIDEO_FRAME_PLANE_STRIDE(p_frame, plane));
+			for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT(p_frame, plane); y++)
+			{
+				memcpy(p_dst + y * GST_VIDEO_FRAME_PLANE_STRIDE(p_frame, plane), p_src + y * stride[plane], line_size);
+			}
+		}
+	}
+}
+
+// Frames downstream holds, not counting the ones kept by the element itself
+static guint downstream_leases_locked_m2s(GstM2svideosrc *p_m2svideosrc, GstM2svideosrcLease *p_cur)
+{
+	GstM2svideosrcLease *p_lease;
+	GList *p_link;
+	guint held = 0;
+
+	for (p_link = p_m2svideosrc->leases.head; p_link != nullptr; p_link = p_link->next)
+	{
+		p_lease = (GstM2svideosrcLease *)p_link->data;
+		if (!p_lease->released && (p_lease != p_cur) && (p_lease != p_m2svideosrc->p_next_lease) &&
+			((p_m2svideosrc->p_last_buffer == nullptr) || (p_lease->seq != p_m2svideosrc->last_buffer_seq)))
+		{
+			held++;
+		}
+	}
+	return held;
+}
+
+// m2s_free_read_ptr() only frees the oldest read pointer, so copying a frame
+// would not give its FIFO slot back while older ones are still held. Like a
+// buffer pool, wait until downstream returns one when it already holds
+// zero-copy-max-leases frames; unlock() ends the wait. The object lock is not
+// taken under lease_lock, set_caps() nests them the other way round.
+static GstFlowReturn wait_lease_m2s(GstM2svideosrc *p_m2svideosrc, GstM2svideosrcLease *p_cur)
+{
+	bool flushing;
+	bool full;
+
+	do
+	{
+		GST_OBJECT_LOCK (p_m2svideosrc);
+		flushing = p_m2svideosrc->sync_flushing;
+		GST_OBJECT_UNLOCK (p_m2svideosrc);
+		if (flushing)
+		{
+			return GST_FLOW_FLUSHING;
+		}
+
+		g_mutex_lock(&p_m2svideosrc->lease_lock);
+		full = (downstream_leases_locked_m2s(p_m2svideosrc, p_cur) >= p_m2svideosrc->zero_copy_max_leases);
+		if (full)
+		{
+			g_cond_wait_until(&p_m2svideosrc->lease_cond, &p_m2svideosrc->lease_lock,
+			                  g_get_monotonic_time() + LEASE_WAIT_INTERVAL_MS * G_TIME_SPAN_MILLISECOND);
+		}
+		g_mutex_unlock(&p_m2svideosrc->lease_lock);
+	} while (full);
+
+	return GST_FLOW_OK;
+}
+
+// The buffer always describes the whole m2s frame; a crop window is
+// passed on as GstVideoCropMeta.
+static GstBuffer *wrap_lease_m2s(GstM2svideosrc *p_m2svideosrc, GstM2svideosrcLease *p_lease, guint field)
+{
+	GstVideoInfo *p_info = &p_m2svideosrc->frame_info;
+	GstBuffer *p_buffer;
+	GstVideoCropMeta *p_crop_meta;
+	gsize offset[GST_VIDEO_MAX_PLANES];
+	gint stride[GST_VIDEO_MAX_PLANES];
+	guint field_div = is_field_output(p_m2svideosrc) ? 2 : 1;
+
+	g_atomic_int_inc(&p_lease->ref_count);
+	p_buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, p_lease->p_frame, p_lease->frame_size,
+	                                       0, p_lease->frame_size, p_lease, (GDestroyNotify)release_lease_m2s);
+	get_field_layout_m2s(p_m2svideosrc, field, false, offset, stride);
+	gst_buffer_add_video_meta_full(p_buffer, GST_VIDEO_FRAME_FLAG_NONE, GST_VIDEO_INFO_FORMAT(p_info),
+	                               GST_VIDEO_INFO_WIDTH(p_info), GST_VIDEO_INFO_HEIGHT(p_info),
+	                               GST_VIDEO_INFO_N_PLANES(p_info), offset, stride);
+
+	if (p_m2svideosrc->crop)
+	{
+		/* in field output the window is given in field lines */
+		p_crop_meta = gst_buffer_add_video_crop_meta(p_buffer);
+		p_crop_meta->x = p_m2svideosrc->crop_x;
+		p_crop_meta->y = p_m2svideosrc->crop_y / field_div;
+		p_crop_meta->width = p_m2svideosrc->crop_width;
+		p_crop_meta->height = p_m2svideosrc->crop_height / field_div;
+	}
+
+	return p_buffer;
+}
+
+// Black frames are built once per format and size and shared read-only by
+// every instance in the process. All zero bytes is green for the YUV formats.
+typedef std::tuple<GstVideoFormat, GstVideoInterlaceMode, gint, gint> black_frame_key_t;
+static std::mutex g_black_frame_lock;
+static std::map<black_frame_key_t, GstBuffer *> g_black_frames;
+
+static GstBuffer *create_black_frame(GstVideoInfo *p_info)
+{
+	const GstVideoFormatInfo *p_finfo = p_info->finfo;
+	const GstVideoFormatInfo *p_unpack_finfo = gst_video_format_get_info(p_finfo->unpack_format);
+	bool depth16 = (GST_VIDEO_FORMAT_INFO_BITS(p_unpack_finfo) > 8);
+	gint width = GST_VIDEO_INFO_WIDTH(p_info);
+	gint height = GST_VIDEO_INFO_FIELD_HEIGHT(p_info);
+	GstVideoFrame frame;
+	GstBuffer *p_buffer;
+	GstMemory *p_mem;
+	guint16 ayuv[4];
+	guint8 *p_line;
+	gint i;
+	gint y;
+
+	// black in the unpack format (AYUV/ARGB or their 16 bit variants)
+	ayuv[0] = 0xffff;
+	ayuv[1] = GST_VIDEO_FORMAT_INFO_IS_YUV(p_finfo) ? (16 << 8) : 0;
+	ayuv[2] = GST_VIDEO_FORMAT_INFO_IS_YUV(p_finfo) ? (128 << 8) : 0;
+	ayuv[3] = GST_VIDEO_FORMAT_INFO_IS_YUV(p_finfo) ? (128 << 8) : 0;
+
+	p_line = (guint8 *)g_malloc(width * 8);
+	for (i = 0; i < width; i++)
+	{
+		if (depth16)
+		{
+			memcpy(p_line + i * 8, ayuv, sizeof(ayuv));
+		}
+		else
+		{
+			p_line[i * 4 + 0] = ayuv[0] >> 8;
+			p_line[i * 4 + 1] = ayuv[1] >> 8;
+			p_line[i * 4 + 2] = ayuv[2] >> 8;
+			p_line[i * 4 + 3] = ayuv[3] >> 8;
+		}
+	}
+
+	p_buffer = gst_buffer_new_allocate(NULL, GST_VIDEO_INFO_SIZE(p_info), NULL);
+	if (!gst_video_frame_map(&frame, p_info, p_buffer, GST_MAP_WRITE))
+	{
+		g_free(p_line);
+		gst_buffer_unref(p_buffer);
+		return nullptr;
+	}
+	for (y = 0; y < height; y += p_finfo->pack_lines)
+	{
+		p_finfo->pack_func(p_finfo, GST_VIDEO_PACK_FLAG_NONE, p_line, 0, frame.data, frame.info.stride,
+		                   GST_VIDEO_INFO_CHROMA_SITE(p_info), y, width);
+	}
+	gst_video_frame_unmap(&frame);
+	g_free(p_line);
+
+	p_mem = gst_buffer_peek_memory(p_buffer, 0);
+	GST_MINI_OBJECT_FLAG_SET(p_mem, GST_MEMORY_FLAG_READONLY);
+	gst_buffer_add_video_meta_full(p_buffer, GST_VIDEO_FRAME_FLAG_NONE, GST_VIDEO_INFO_FORMAT(p_info),
+	                               width, GST_VIDEO_INFO_HEIGHT(p_info), GST_VIDEO_INFO_N_PLANES(p_info),
+	                               p_info->offset, p_info->stride);
+
+	return p_buffer;
+}
+
+// New buffer sharing the cached black frame memory.
+static GstBuffer *get_black_frame(GstVideoInfo *p_info)
+{
+	black_frame_key_t key(GST_VIDEO_INFO_FORMAT(p_info), GST_VIDEO_INFO_INTERLACE_MODE(p_info),
+	                      GST_VIDEO_INFO_WIDTH(p_info), GST_VIDEO_INFO_HEIGHT(p_info));
+	GstBuffer *p_black;
+
+	std::lock_guard<std::mutex> lock(g_black_frame_lock);
+
+	auto it = g_black_frames.find(key);
+	if (it == g_black_frames.end())
+	{
+		p_black = create_black_frame(p_info);
+		if (p_black == nullptr)
+		{
+			return nullptr;
+		}
+		it = g_black_frames.insert(std::make_pair(key, p_black)).first;
+	}
+
+	return gst_buffer_copy(it->second);
+}
+
+// New buffer sharing the memory of the last output frame or of a cached black
+// frame; during a source switch always the last frame. In field output the
+// last frame is repeated as a pair, each field from its own field.
+// nullptr only if the black frame could not be built.
+static GstBuffer *underflow_buffer_m2s(GstM2svideosrc *p_m2svideosrc, guint field)
+{
+	GstBuffer *p_last = p_m2svideosrc->p_last_buffer;
+
+	if (is_field_output(p_m2svideosrc) && (field != first_field_m2s(p_m2svideosrc)))
+	{
+		p_last = p_m2svideosrc->p_last_field;
+	}
+
+	if (p_m2svideosrc->switch_holding && (p_last != nullptr))
+	{
+		return gst_buffer_copy(p_last);
+	}
+
+	if ((p_m2svideosrc->underflow_policy == GST_M2SVIDEOSRC_UNDERFLOW_POLICY_BLACK) ||
+		(p_last == nullptr))
+	{
+		return get_black_frame(&p_m2svideosrc->info);
+	}
+
+	return gst_buffer_copy(p_last);
+}
+
+static void
+gst_m2svideosrc_set_times (GstM2svideosrc * src, GstBuffer * buffer)
+{
+	GstClockTime next_time;
+
+	GST_BUFFER_PTS (buffer) =
+		src->accum_rtime + src->timestamp_offset + src->running_time;
+	GST_BUFFER_DTS (buffer) = GST_CLOCK_TIME_NONE;
+
+	gst_object_sync_values (GST_OBJECT (src), GST_BUFFER_PTS (buffer));
+
+	GST_DEBUG_OBJECT (src, "Timestamp: %" GST_TIME_FORMAT " = accumulated %"
+	                  GST_TIME_FORMAT " + offset: %"
+	                  GST_TIME_FORMAT " + running time: %" GST_TIME_FORMAT,
+	                  GST_TIME_ARGS (GST_BUFFER_PTS (buffer)), GST_TIME_ARGS (src->accum_rtime),
+	                  GST_TIME_ARGS (src->timestamp_offset), GST_TIME_ARGS (src->running_time));
+
+	GST_BUFFER_OFFSET (buffer) = src->accum_frames + src->n_frames;
+	if (src->reverse) {
+		src->n_frames--;
+	} else {
+		src->n_frames++;
+	}
+	GST_BUFFER_OFFSET_END (buffer) = GST_BUFFER_OFFSET (buffer) + 1;
+	if (src->info.fps_n) {
+		next_time = gst_util_uint64_scale (src->n_frames,
+		                                   src->info.fps_d * GST_SECOND, src->info.fps_n);
+		if (src->reverse) {
+			/* We already decremented to next frame */
+			GstClockTime prev_pts = gst_util_uint64_scale (src->n_frames + 2,
+			                                               src->info.fps_d * GST_SECOND, src->info.fps_n);
+
+			GST_BUFFER_DURATION (buffer) = prev_pts - GST_BUFFER_PTS (buffer);
+		} else {
+			GST_BUFFER_DURATION (buffer) = next_time - src->running_time;
+		}
+	} else {
+		next_time = src->timestamp_offset;
+		/* NONE means forever */
+		GST_BUFFER_DURATION (buffer) = GST_CLOCK_TIME_NONE;
+	}
+
+	src->running_time = next_time;
+}
+
+static GstFlowReturn
+make_buffer_m2s (GstM2svideosrc * src, bool write_m2s, guint field, GstBuffer ** p_buffer)
+{
+	GstBuffer *buffer = NULL;
+	GstVideoFrame frame;
+	GstFlowReturn ret;
+
+	if (write_m2s && src->zero_copy && (!src->crop || src->crop_meta))
+	{
+		ret = wait_lease_m2s(src, src->p_cur_lease);
+		if (G_UNLIKELY (ret != GST_FLOW_OK))
+			return ret;
+		buffer = wrap_lease_m2s(src, src->p_cur_lease, field);
+	}
+	else if (write_m2s && (src->p_last_buffer != nullptr) && !is_field_output(src) &&
+			 (src->p_cur_lease->seq == src->last_buffer_seq))
+	{
+		// the same frame again, share the memory of the previous buffer
+		buffer = gst_buffer_copy(src->p_last_buffer);
+	}
+	else if (!write_m2s)
+	{
+		buffer = underflow_buffer_m2s(src, field);
+	}
+
+	if (buffer == NULL)
+	{
+		GST_LOG_OBJECT (src,
+		                "creating buffer from pool for frame %" G_GINT64_FORMAT, src->n_frames);
+
+		ret = GST_BASE_SRC_CLASS (parent_class)->alloc (GST_BASE_SRC (src), -1, src->info.size, &buffer);
+		if (G_UNLIKELY (ret != GST_FLOW_OK))
+			return ret;
+
+		if (gst_video_frame_map (&frame, &src->info, buffer, GST_MAP_WRITE))
+		{
+			read_from_m2s(src, &frame, write_m2s, field);
+			gst_video_frame_unmap (&frame);
+		}
+		else
+		{
+			GST_DEBUG_OBJECT (src, "invalid frame");
+		}
+	}
+
+	*p_buffer = buffer;
+	return GST_FLOW_OK;
+}
+
+// Split the frame timing of the first field between both fields
+static void
+set_field_times (GstBuffer * first, GstBuffer * second, guint first_field)
+{
+	GstClockTime duration = GST_BUFFER_DURATION (first);
+
+	/* a repeated field still carries the flags of the frame it came from */
+	GST_BUFFER_FLAG_UNSET (first, GST_VIDEO_BUFFER_FLAG_TOP_FIELD | GST_VIDEO_BUFFER_FLAG_BOTTOM_FIELD);
+	GST_BUFFER_FLAGS (second) = GST_BUFFER_FLAGS (first);
+	GST_BUFFER_OFFSET (second) = GST_BUFFER_OFFSET (first);
+	GST_BUFFER_OFFSET_END (second) = GST_BUFFER_OFFSET_END (first);
+	GST_BUFFER_DTS (second) = GST_CLOCK_TIME_NONE;
+
+	if (GST_CLOCK_TIME_IS_VALID (duration)) {
+		GST_BUFFER_DURATION (first) = duration / 2;
+		GST_BUFFER_PTS (second) = GST_BUFFER_PTS (first) + duration / 2;
+		GST_BUFFER_DURATION (second) = duration - duration / 2;
+	} else {
+		GST_BUFFER_PTS (second) = GST_BUFFER_PTS (first);
+		GST_BUFFER_DURATION (second) = GST_CLOCK_TIME_NONE;
+	}
+
+	GST_BUFFER_FLAG_SET (first, GST_VIDEO_BUFFER_FLAG_INTERLACED |
+	                     (first_field ? GST_VIDEO_BUFFER_FLAG_BOTTOM_FIELD : GST_VIDEO_BUFFER_FLAG_TOP_FIELD));
+	GST_BUFFER_FLAG_SET (second, GST_VIDEO_BUFFER_FLAG_INTERLACED |
+	                     (first_field ? GST_VIDEO_BUFFER_FLAG_TOP_FIELD : GST_VIDEO_BUFFER_FLAG_BOTTOM_FIELD));
+}
+
+// Running time of the pipeline clock at a TAI time; NONE without a clock yet
+static GstClockTime tai_running_time_m2s(GstM2svideosrc *p_m2svideosrc, uint64_t tai)
+{
+	GstElement *p_element = GST_ELEMENT (p_m2svideosrc);
+	GstClock *p_clock;
+	GstClockTime now;
+	GstClockTimeDiff pts;
+	uint64_t now_tai;
+
+	p_clock = gst_element_get_clock(p_element);
+	if (p_clock == NULL)
+	{
+		return GST_CLOCK_TIME_NONE;
+	}
+	now = gst_clock_get_time(p_clock);
+	now_tai = m2s_get_current_tai_ns();
+	gst_object_unref(p_clock);
+
+	pts = GST_CLOCK_DIFF (gst_element_get_base_time(p_element), now) - (GstClockTimeDiff)(now_tai - tai);
+
+	return (pts < 0) ? 0 : (GstClockTime)pts;
+}
+
+// Tag the buffer with the capture time and, if enabled, move its PTS to the
+// running time at which the frame was captured.
+static void set_capture_time_m2s(GstM2svideosrc *p_m2svideosrc, GstBuffer *p_buffer, GstM2svideosrcLease *p_lease)
+{
+	GstClockTime pts;
+	GstCaps *p_caps;
+
+	if (p_m2svideosrc->async_rtp_timestamp)
+	{
+		// RTP timestamps are not locked to PTP
+		return;
+	}
+
+	p_caps = gst_static_caps_get(&tai_caps);
+	// a repeated frame can share the buffer, and its meta, of the last one
+	if (gst_buffer_get_reference_timestamp_meta(p_buffer, p_caps) == NULL)
+	{
+		gst_buffer_add_reference_timestamp_meta(p_buffer, p_caps, p_lease->capture_tai, GST_BUFFER_DURATION (p_buffer));
+	}
+	gst_caps_unref(p_caps);
+
+	if (!p_m2svideosrc->rtp_timestamp_pts)
+	{
+		return;
+	}
+
+	pts = tai_running_time_m2s(p_m2svideosrc, p_lease->capture_tai);
+	if (!GST_CLOCK_TIME_IS_VALID (pts))
+	{
+		return;
+	}
+
+	// a repeated frame has the same capture time, keep the PTS increasing
+	if (GST_CLOCK_TIME_IS_VALID (p_m2svideosrc->last_capture_pts) &&
+		(pts <= p_m2svideosrc->last_capture_pts))
+	{
+		pts = p_m2svideosrc->last_capture_pts + GST_BUFFER_DURATION (p_buffer);
+	}
+
+	GST_BUFFER_PTS (p_buffer) = pts;
+	p_m2svideosrc->last_capture_pts = pts;
+}
+
+// A black, repeated or gap buffer has no capture time of its own. With
+// rtp-timestamp-pts it follows the last captured frame, so that its PTS is
+// on the same timeline and does not jump back to the frame count.
+static void set_underflow_time_m2s(GstM2svideosrc *p_m2svideosrc, GstBuffer *p_buffer)
+{
+	GstClockTime pts;
+
+	if (!p_m2svideosrc->rtp_timestamp_pts || p_m2svideosrc->async_rtp_timestamp ||
+		!GST_CLOCK_TIME_IS_VALID (p_m2svideosrc->last_capture_pts))
+	{
+		return;
+	}
+
+	pts = p_m2svideosrc->last_capture_pts + GST_BUFFER_DURATION (p_buffer);
+	GST_BUFFER_PTS (p_buffer) = pts;
+	p_m2svideosrc->last_capture_pts = pts;
+}
+
+// Per-frame reception state for downstream, so a damaged frame can be told
+// apart without polling m2s_get_status().
+static void set_rx_meta_m2s(GstM2svideosrc *p_m2svideosrc, GstBuffer *p_buffer, GstM2svideosrcLease *p_lease)
+{
+	// a repeated frame can share the buffer, and its meta, of the last one
+	if (gst_buffer_get_m2s_rx_meta(p_buffer) != NULL)
+	{
+		return;
+	}
+
+	gst_buffer_add_m2s_rx_meta(p_buffer, p_lease->rtp_timestamp,
+	                           p_m2svideosrc->async_rtp_timestamp ? 0 : p_lease->capture_tai,
+	                           p_lease->read_status.packet_rcv, p_lease->read_status.packet_lost);
+}
+
+// Decide whether the frame just selected is already too late for downstream.
+// A skipped frame is released at once, so that no hold or repeat can output it
+// later. Its PTS slot is kept for the next frame output, so a skip leaves no
+// hole in the timeline. A lease that was already output (a repeat) is never skipped.
+static bool qos_drop_m2s(GstM2svideosrc *p_m2svideosrc)
+{
+	GstM2svideosrcLease *p_lease = p_m2svideosrc->p_cur_lease;
+	GstClockTime earliest;
+	GstClockTime pts;
+	GstClockTime duration;
+	gdouble proportion;
+
+	if (!p_m2svideosrc->qos || (p_lease->seq == p_m2svideosrc->last_output_seq) ||
+		(p_m2svideosrc->info.fps_n == 0))
+	{
+		return false;
+	}
+
+	GST_OBJECT_LOCK (p_m2svideosrc);
+	earliest = p_m2svideosrc->qos_earliest_time;
+	proportion = p_m2svideosrc->qos_proportion;
+	GST_OBJECT_UNLOCK (p_m2svideosrc);
+
+	if (!GST_CLOCK_TIME_IS_VALID (earliest))
+	{
+		return false;
+	}
+
+	duration = gst_util_uint64_scale (GST_SECOND, p_m2svideosrc->info.fps_d, p_m2svideosrc->info.fps_n);
+	pts = GST_CLOCK_TIME_NONE;
+	if (p_m2svideosrc->rtp_timestamp_pts && !p_m2svideosrc->async_rtp_timestamp)
+	{
+		pts = tai_running_time_m2s(p_m2svideosrc, p_lease->capture_tai);
+	}
+	if (!GST_CLOCK_TIME_IS_VALID (pts))
+	{
+		pts = p_m2svideosrc->accum_rtime + p_m2svideosrc->timestamp_offset + p_m2svideosrc->running_time;
+	}
+
+	if (pts + duration > earliest)
+	{
+		return false;
+	}
+
+	p_m2svideosrc->last_output_seq = p_lease->seq;
+	p_m2svideosrc->qos_dropped++;
+
+	GST_DEBUG_OBJECT (p_m2svideosrc, "QoS: skipping frame at %" GST_TIME_FORMAT ", earliest %" GST_TIME_FORMAT,
+	                  GST_TIME_ARGS (pts), GST_TIME_ARGS (earliest));
+
+	{
+		GstMessage *p_msg;
+
+		p_msg = gst_message_new_qos (GST_OBJECT (p_m2svideosrc), TRUE,
+		                             GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE, pts, duration);
+		gst_message_set_qos_values (p_msg, GST_CLOCK_DIFF (pts, earliest), proportion, 1000000);
+		gst_message_set_qos_stats (p_msg, GST_FORMAT_BUFFERS,
+		                           p_m2svideosrc->qos_processed, p_m2svideosrc->qos_dropped);
+		gst_element_post_message (GST_ELEMENT (p_m2svideosrc), p_msg);
+	}
+
+	release_lease_m2s(p_lease);
+	p_m2svideosrc->p_cur_lease = nullptr;
+	return true;
+}
+
+// After a QoS skip the next stored frame is taken at once. The selection rules
+// would first fill the FIFO up to fifo-middle or the adaptive target again and
+// output black or repeated frames meanwhile, where the skip was meant to catch up.
+static GstFlowReturn qos_next_frame_m2s(GstM2svideosrc *p_m2svideosrc, bool *p_write_m2s)
+{
+	uint32_t gst_size = (uint32_t)GST_VIDEO_INFO_SIZE(&p_m2svideosrc->frame_info);
+
+	if (is_genlock(p_m2svideosrc))
+	{
+		// the frame due now, not merely the next one
+		*p_write_m2s = select_frame_m2s(p_m2svideosrc);
+		return GST_FLOW_OK;
+	}
+	if (p_m2svideosrc->read_select && !p_m2svideosrc->frame_sync_active)
+	{
+		return select_frame_m2s_blocking(p_m2svideosrc, p_write_m2s);
+	}
+
+	// the frame synchronizer already waited for the output slot
+	get_ptr_m2s(p_m2svideosrc);
+	if ((p_m2svideosrc->p_cur_lease != nullptr) && frame_size_mismatch_m2s(p_m2svideosrc, gst_size))
+	{
+		release_lease_m2s(p_m2svideosrc->p_cur_lease);
+		p_m2svideosrc->p_cur_lease = nullptr;
+	}
+	*p_write_m2s = p_m2svideosrc->p_cur_lease != nullptr;
+	return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_m2svideosrc_create (GstPushSrc * psrc, GstBuffer ** p_buffer)
+{
+	GstM2svideosrc *src;
+	GstBuffer *buffer = NULL;
+	GstFlowReturn ret;
+	bool write_m2s;
+	bool frame_sync;
+	guint first_field;
+	GstClockTime sync_pts;
+
+	src = GST_M2SVIDEOSRC (psrc);
+
+	if (G_UNLIKELY (GST_VIDEO_INFO_FORMAT (&src->info) ==
+	                GST_VIDEO_FORMAT_UNKNOWN))
+		goto not_negotiated;
+
+	if (src->p_pending_field != NULL) {
+		*p_buffer = src->p_pending_field;
+		src->p_pending_field = NULL;
+		return GST_FLOW_OK;
+	}
+
+	/* 0 framerate and we are at the second frame, eos */
+	if (G_UNLIKELY (src->info.fps_n == 0 && src->n_frames == 1))
+		goto eos;
+
+	if (G_UNLIKELY (src->n_frames == -1)) {
+		/* EOS for reverse playback */
+		goto eos;
+	}
+
+	/* hand back the frames downstream released since the last call */
+	reclaim_leases_m2s (src);
+
+	if (src->auto_caps && (src->info.fps_n != 0)) {
+		ret = check_format_m2s (src);
+		if (G_UNLIKELY (ret != GST_FLOW_OK))
+			return ret;
+	}
+
+	switch_source_m2s (src);
+
+	frame_sync = (src->info.fps_n != 0) && is_frame_sync (src);
+	if (G_UNLIKELY (frame_sync != src->frame_sync_active)) {
+		GST_OBJECT_LOCK (src);
+		src->frame_sync_active = frame_sync;
+		GST_OBJECT_UNLOCK (src);
+		GST_INFO_OBJECT (src, "frame synchronizer %s", frame_sync ? "on" : "off");
+		gst_element_post_message (GST_ELEMENT (src), gst_message_new_latency (GST_OBJECT (src)));
+	}
+
+	if (G_UNLIKELY ((src->p_next_lease != nullptr) && !is_genlock (src)))
+		take_next_lease_m2s (src);
+
+	if (frame_sync) {
+		ret = frame_sync_wait_m2s (src);
+		if (G_UNLIKELY (ret != GST_FLOW_OK))
+			return ret;
+	}
+	if (src->switch_holding)
+		write_m2s = switch_select_m2s(src);
+	else if (frame_sync)
+		write_m2s = select_frame_sync_m2s(src);
+	else if (src->read_select && !is_genlock (src)) {
+		ret = select_frame_m2s_blocking (src, &write_m2s);
+		if (G_UNLIKELY (ret != GST_FLOW_OK))
+			return ret;
+	} else
+		write_m2s = select_frame_m2s(src);
+
+	while (write_m2s && qos_drop_m2s (src)) {
+		ret = qos_next_frame_m2s (src, &write_m2s);
+		if (G_UNLIKELY (ret != GST_FLOW_OK))
+			return ret;
+	}
+
+	first_field = first_field_m2s (src);
+
+	ret = make_buffer_m2s (src, write_m2s, first_field, &buffer);
+	if (G_UNLIKELY (ret != GST_FLOW_OK))
+		return ret;
+
+	gst_m2svideosrc_set_times (src, buffer);
+
+	if (write_m2s)
+	{
+		set_capture_time_m2s(src, buffer, src->p_cur_lease);
+		set_rx_meta_m2s(src, buffer, src->p_cur_lease);
+		gst_buffer_replace (&src->p_last_buffer, buffer);
+		src->last_buffer_seq = src->p_cur_lease->seq;
+		src->last_output_seq = src->p_cur_lease->seq;
+		src->qos_processed++;
+	}
+	else
+	{
+		set_underflow_time_m2s(src, buffer);
+		if ((src->underflow_policy == GST_M2SVIDEOSRC_UNDERFLOW_POLICY_GAP) && !src->switch_holding)
+			GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_GAP);
+	}
+
+	if (frame_sync)
+	{
+		/* the frame goes out on the local boundary, not at its capture time */
+		sync_pts = tai_running_time_m2s(src, src->sync_next_tai);
+		if (GST_CLOCK_TIME_IS_VALID (sync_pts))
+			GST_BUFFER_PTS (buffer) = sync_pts;
+	}
+
+	if (is_field_output (src))
+	{
+		/* the second field goes out on the next create() call */
+		ret = make_buffer_m2s (src, write_m2s, 1 - first_field, &src->p_pending_field);
+		if (G_UNLIKELY (ret != GST_FLOW_OK))
+		{
+			gst_buffer_unref (buffer);
+			return ret;
+		}
+		set_field_times (buffer, src->p_pending_field, first_field);
+		if (write_m2s)
+		{
+			set_rx_meta_m2s (src, src->p_pending_field, src->p_cur_lease);
+			gst_buffer_replace (&src->p_last_field, src->p_pending_field);
+		}
+	}
+
+	*p_buffer = buffer;
+	return GST_FLOW_OK;
 
  not_negotiated:
 	{
@@ -1568,11 +4286,6 @@ gst_m2svideosrc_fill (GstPushSrc * psrc, GstBuffer * buffer)
 		GST_DEBUG_OBJECT (src, "eos: 0 framerate, frame %d", (gint) src->n_frames);
 		return GST_FLOW_EOS;
 	}
- invalid_frame:
-	{
-		GST_DEBUG_OBJECT (src, "invalid frame");
-		return GST_FLOW_OK;
-	}
 }
 
 static gboolean
@@ -1585,6 +4298,25 @@ gst_m2svideosrc_start (GstBaseSrc * basesrc)
 	src->n_frames = 0;
 	src->accum_frames = 0;
 	src->accum_rtime = 0;
+	src->last_capture_pts = GST_CLOCK_TIME_NONE;
+	src->fifo_observed = false;
+	src->fifo_depth_valid = false;
+	src->fifo_depth = 0;
+	src->fifo_depth_peak = 0;
+	src->qos_proportion = 1.0;
+	src->qos_earliest_time = GST_CLOCK_TIME_NONE;
+	src->qos_processed = 0;
+	src->qos_dropped = 0;
+	src->sync_valid = false;
+	src->frame_sync_active = false;
+	src->sync_dropped = 0;
+	src->sync_repeated = 0;
+	src->size_mismatch = false;
+	src->last_frame_length_err = 0;
+	src->format_errors = 0;
+	src->switch_pending = false;
+	src->switch_holding = false;
+	src->last_switch_time = 0;
 
 	gst_video_info_init (&src->info);
 	GST_OBJECT_UNLOCK (src);
@@ -1598,6 +4330,11 @@ gst_m2svideosrc_stop (GstBaseSrc * basesrc)
 	GstM2svideosrc *src = GST_M2SVIDEOSRC (basesrc);
 	guint i;
 
+	gst_buffer_replace (&src->p_last_buffer, NULL);
+	gst_buffer_replace (&src->p_last_field, NULL);
+	gst_buffer_replace (&src->p_pending_field, NULL);
+	release_held_leases_m2s (src);
+
 	if (src->subsample)
 		gst_video_chroma_resample_free (src->subsample);
 	src->subsample = NULL;
@@ -1611,6 +4348,44 @@ gst_m2svideosrc_stop (GstBaseSrc * basesrc)
 	return TRUE;
 }
 
+static gboolean
+gst_m2svideosrc_unlock (GstBaseSrc * basesrc)
+{
+	GstM2svideosrc *src = GST_M2SVIDEOSRC (basesrc);
+
+	/* wake up a streaming thread blocked in m2s_read_select() */
+	if (src->read_select)
+		m2s_enable_select(src->strm_id, false);
+
+	/* or waiting for the next frame boundary */
+	GST_OBJECT_LOCK (src);
+	src->sync_flushing = true;
+	if (src->sync_clock_id)
+		gst_clock_id_unschedule (src->sync_clock_id);
+	GST_OBJECT_UNLOCK (src);
+
+	/* or for downstream to return a frame */
+	g_mutex_lock (&src->lease_lock);
+	g_cond_broadcast (&src->lease_cond);
+	g_mutex_unlock (&src->lease_lock);
+
+	return TRUE;
+}
+
+static gboolean
+gst_m2svideosrc_unlock_stop (GstBaseSrc * basesrc)
+{
+	GstM2svideosrc *src = GST_M2SVIDEOSRC (basesrc);
+
+	GST_OBJECT_LOCK (src);
+	if (src->read_select && src->m2s_started)
+		m2s_enable_select(src->strm_id, true);
+	src->sync_flushing = false;
+	GST_OBJECT_UNLOCK (src);
+
+	return TRUE;
+}
+
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
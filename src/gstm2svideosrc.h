@@ -29,6 +29,26 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (GstM2svideosrc, gst_m2svideosrc, GST, M2SVIDEOSRC,
                       GstPushSrc)
 
+typedef struct _GstM2svideosrcLease GstM2svideosrcLease;
+
+typedef enum {
+	GST_M2SVIDEOSRC_UNDERFLOW_POLICY_BLACK,
+	GST_M2SVIDEOSRC_UNDERFLOW_POLICY_REPEAT_LAST,
+	GST_M2SVIDEOSRC_UNDERFLOW_POLICY_GAP,
+} GstM2svideosrcUnderflowPolicy;
+
+typedef enum {
+	GST_M2SVIDEOSRC_FRAME_SYNC_OFF,
+	GST_M2SVIDEOSRC_FRAME_SYNC_ON,
+	GST_M2SVIDEOSRC_FRAME_SYNC_AUTO,
+} GstM2svideosrcFrameSync;
+
+typedef enum {
+	GST_M2SVIDEOSRC_INPUT_RESOLUTION_AUTO,
+	GST_M2SVIDEOSRC_INPUT_RESOLUTION_1920x1080,
+	GST_M2SVIDEOSRC_INPUT_RESOLUTION_3840x2160,
+} GstM2svideosrcInputResolution;
+
 /**
  * GstM2svideosrc:
  *
@@ -41,6 +61,7 @@ struct _GstM2svideosrc {
 
 	/* video state */
 	GstVideoInfo info; /* protected by the object or stream lock */
+	GstVideoInfo frame_info;              /* layout of the frames read from m2s */
 	GstVideoChromaResample *subsample;
 
 	/* private */
@@ -72,14 +93,115 @@ struct _GstM2svideosrc {
 	bool box_mode;
 	uint8_t box_size;
 	bool async_rtp_timestamp;
-	uint8_t *p_frame_from_m2s;
-	uint32_t frame_size_from_m2s;
+	GstM2svideosrcLease *p_cur_lease;     /* frame currently held from m2s */
+	GstM2svideosrcLease *p_next_lease;    /* genlock: queued frame not due yet */
 	uint8_t fifo_under_threshold;
 	uint8_t fifo_middle;
 	uint8_t fifo_over_threshold;
 	uint8_t under_count;
 	uint8_t under_count_max;
 	bool gpudirect;
+	bool zero_copy;
+	uint8_t zero_copy_max_leases;
+	bool read_select;
+	bool m2s_started;                     /* protected by the object lock */
+
+	/* adaptive FIFO controller */
+	bool adaptive_fifo;
+	uint32_t adaptive_window;
+	uint32_t adaptive_target;
+	double adaptive_depth_avg;
+	uint32_t adaptive_window_frames;
+	uint32_t adaptive_window_min;
+	uint32_t adaptive_window_max;
+	bool adaptive_raised;                 /* the target was raised in this window */
+	guint64 adaptive_dropped;
+	guint64 adaptive_repeated;
+
+	/* observed application FIFO depth, for the latency query */
+	bool fifo_observed;
+	double fifo_depth_avg;
+	bool fifo_depth_valid;                /* protected by the object lock */
+	uint32_t fifo_depth;                  /* protected by the object lock */
+	uint32_t fifo_depth_peak;             /* protected by the object lock */
+
+	GstM2svideosrcUnderflowPolicy underflow_policy;
+	GstBuffer *p_last_buffer;             /* last frame received from m2s */
+	guint64 last_buffer_seq;              /* lease held by p_last_buffer */
+
+	/* RTP timestamp unwrapping */
+	bool rtp_timestamp_pts;
+	bool rtp_unwrap_valid;
+	uint32_t last_rtp_timestamp;
+	uint64_t last_capture_tai;
+	GstClockTime last_capture_pts;
+
+	bool field_output;
+	GstBuffer *p_pending_field;           /* second field of the last frame */
+	GstBuffer *p_last_field;              /* second field of p_last_buffer */
+
+	/* QoS frame skipping */
+	bool qos;
+	gdouble qos_proportion;
+	GstClockTime qos_earliest_time;
+	guint64 qos_processed;
+	guint64 qos_dropped;
+	guint64 lease_seq;                    /* sequence number of the last acquired lease */
+	guint64 last_output_seq;              /* lease last output or skipped */
+
+	/* genlock frame selection */
+	bool genlock;
+	guint64 genlock_offset;
+
+	/* frame synchronizer */
+	GstM2svideosrcFrameSync frame_sync;
+	bool frame_sync_active;               /* protected by the object lock, set by the streaming thread */
+	m2s_frame_rate_t m2s_frame_rate;
+	bool sync_valid;
+	bool sync_flushing;
+	uint64_t sync_base_tai;
+	int64_t sync_frame;
+	uint64_t sync_next_tai;               /* local frame boundary of the current output */
+	GstClockID sync_clock_id;             /* protected by the object lock */
+	guint64 sync_dropped;
+	guint64 sync_repeated;
+
+	/* region of interest */
+	guint crop_x;
+	guint crop_y;
+	guint crop_width;
+	guint crop_height;
+	GstM2svideosrcInputResolution input_resolution;
+	bool crop;                            /* the caps are a window of the m2s frame */
+	bool crop_meta;                       /* downstream takes GstVideoCropMeta */
+	gsize roi_offset[GST_VIDEO_MAX_PLANES];    /* start of the window in each plane */
+	gint roi_line_size[GST_VIDEO_MAX_PLANES];  /* bytes of the window in one line */
+
+	/* caps detection */
+	bool auto_caps;
+	uint32_t probe_timeout_ms;
+	gint probe_width;                     /* 0 until a stream was detected */
+	gint probe_height;
+	uint8_t probe_scan;
+	gint probe_fps_n;
+	gint probe_fps_d;
+	bool size_mismatch;                   /* a frame of another size was freed */
+	uint32_t last_frame_length_err;
+	guint format_errors;                  /* frames in a row with a size error */
+
+	/* source switching */
+	bool switch_pending;                  /* protected by the object lock */
+	bool switch_holding;                  /* the last frame is held until the new source */
+	uint32_t switch_skip;                 /* frames left from before the switch */
+	uint64_t switch_tai;
+	guint64 switch_held;
+	guint64 last_switch_time;
+
+	/* outstanding m2s read pointers, oldest first */
+	GMutex lease_lock;
+	GCond lease_cond;                     /* a lease was released */
+	GQueue leases;
+	GQueue dead_streams;                  /* given up streams whose frames are all released */
 
 	/* running time and frames for current caps */
 	GstClockTime running_time;            /* total running time */